@@ -107,6 +107,17 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief Blacklist a scheduled query that exceeded its budget.
+   *
+   * The query is skipped by the schedule as if it had caused the worker to
+   * fail, while the worker continues running the remaining queries. The
+   * query's 'blacklist' option may still opt out of blacklisting.
+   *
+   * @param name The unique name of the scheduled item
+   */
+  void blacklistQuery(const std::string& name);
+
   /**
    * @brief Calculate the hash of the osquery config
    *
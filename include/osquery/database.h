@@ -11,6 +11,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,30 @@ using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
 class Status;
+
+/**
+ * @brief The bounds of a key/value range scan within a domain.
+ *
+ * Keys are visited in ascending (byte-wise) order. Empty bounds are unused.
+ */
+struct DatabaseScanRange {
+  /// Only visit keys starting with this prefix.
+  std::string prefix;
+
+  /// Inclusive lower bound.
+  std::string low;
+
+  /// Exclusive upper bound.
+  std::string high;
+
+  /// The maximum number of key/value pairs to visit, 0 for no limit.
+  size_t max{0};
+};
+
+/// Called with each key/value pair in a range, return false to stop.
+using DatabaseScanVisitor =
+    std::function<bool(const std::string& key, const std::string& value)>;
+
 /**
  * @brief A list of supported backing storage categories: called domains.
  *
@@ -136,11 +161,55 @@ class DatabasePlugin : public Plugin {
                              const std::string& low,
                              const std::string& high) = 0;
 
+  /**
+   * @brief Remove several keys from the same domain at once.
+   *
+   * The default implementation calls remove for each key, plugins should
+   * override this with a batched write when the backing store has one.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param keys The keys to remove, keys that do not exist are ignored.
+   * @return Failure if the data could not be removed.
+   */
+  virtual Status removeBatch(const std::string& domain,
+                             const std::vector<std::string>& keys);
+
   virtual Status scan(const std::string& domain,
                       std::vector<std::string>& results,
                       const std::string& prefix,
                       size_t max) const;
 
+  /**
+   * @brief Lookup several keys from the same domain at once.
+   *
+   * The default implementation calls get for each key, plugins should
+   * override this with a batched read when the backing store has one.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param keys The keys to lookup.
+   * @param values Output values, one for each key, empty if the key does
+   * not exist.
+   * @return Failure if the data could not be accessed.
+   */
+  virtual Status multiGet(const std::string& domain,
+                          const std::vector<std::string>& keys,
+                          std::vector<std::string>& values) const;
+
+  /**
+   * @brief Visit the keys and values within a range in key order.
+   *
+   * The default implementation scans keys then calls get for each key,
+   * plugins should override this with an ordered iterator.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param range The prefix, bounds, and limit of keys to visit.
+   * @param visitor Called for each key/value pair.
+   * @return Failure if the data could not be accessed.
+   */
+  virtual Status scanValues(const std::string& domain,
+                            const DatabaseScanRange& range,
+                            const DatabaseScanVisitor& visitor) const;
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -259,6 +328,10 @@ Status setDatabaseBatch(const std::string& domain,
 /// Remove a domain/key identified value from backing-store.
 Status deleteDatabaseValue(const std::string& domain, const std::string& key);
 
+/// Remove a list of domain/key identified values from backing-store.
+Status deleteDatabaseValues(const std::string& domain,
+                            const std::vector<std::string>& keys);
+
 /// Remove a range of keys in domain.
 Status deleteDatabaseRange(const std::string& domain,
                            const std::string& low,
@@ -275,6 +348,34 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         size_t max = 0);
 
+/**
+ * @brief Lookup several values from the same domain with a single request.
+ *
+ * Values are returned in the order of the keys, a missing key has an empty
+ * value.
+ */
+Status getDatabaseValues(const std::string& domain,
+                         const std::vector<std::string>& keys,
+                         std::vector<std::string>& values);
+
+/// Get the ordered key/value pairs within a range for a given domain.
+Status scanDatabaseValues(const std::string& domain,
+                          const DatabaseScanRange& range,
+                          DatabaseStringValueList& results);
+
+/**
+ * @brief Encode key/value pairs for the database plugin call API.
+ *
+ * Extensions send batches to the core database plugin through the registry
+ * as a JSON object of string values, readable by any extension SDK.
+ */
+Status serializeDatabaseBatch(const DatabaseStringValueList& data,
+                              std::string& json);
+
+/// Inverse of serializeDatabaseBatch, convert a JSON object to pairs.
+Status deserializeDatabaseBatch(const std::string& json,
+                                DatabaseStringValueList& data);
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
@@ -27,6 +27,8 @@
 namespace osquery {
 
 struct Subscription;
+class EventSubscriberPlugin;
+class EventSubscriberDispatcher;
 template <class SC, class EC>
 class EventPublisher;
 template <class PUB>
@@ -38,6 +40,14 @@ using EventContextID = uint64_t;
 using EventTime = uint64_t;
 using EventRecord = std::pair<std::string, EventTime>;
 
+/// Inclusive bounds of the events selected by a query, zero is unbounded.
+struct EventBounds {
+  EventTime start{0};
+  EventTime stop{0};
+  size_t eid_start{0};
+  size_t eid_stop{0};
+};
+
 /**
  * @brief An EventPublisher will define a SubscriptionContext for
  * EventSubscriber%s to use.
@@ -170,6 +180,9 @@ struct Subscription : private boost::noncopyable {
   /// An EventSubscription member EventCallback method.
   EventCallback callback;
 
+  /// The subscriber named by subscriber_name, resolved when subscribing.
+  std::weak_ptr<EventSubscriberPlugin> subscriber;
+
   explicit Subscription(std::string name) : subscriber_name(std::move(name)){};
 
   static SubscriptionRef create(const std::string& name) {
@@ -352,10 +365,31 @@ class EventPublisherPlugin : public Plugin,
    */
   void fire(const EventContextRef& ec, EventTime time = 0);
 
+  /**
+   * @brief Fire an EventContext to a single, already-known Subscription.
+   *
+   * Publishers that can route an event to the Subscription owning it (for
+   * example by an OS watch handle) may skip the enumeration in `fire`.
+   * The Subscription's `shouldFire` check is still applied.
+   */
+  void fireSubscription(const SubscriptionRef& sub,
+                        const EventContextRef& ec,
+                        EventTime time = 0);
+
   /// The internal fire method used by the typed EventPublisher.
   virtual void fireCallback(const SubscriptionRef& sub,
                             const EventContextRef& ec) const = 0;
 
+  /**
+   * @brief Deliver an event that should fire to a Subscription%'s callback.
+   *
+   * If the subscriber uses a dispatch queue the event is queued and the
+   * callback runs on the subscriber's dispatch thread, otherwise the callback
+   * is called on the publisher thread.
+   */
+  static void dispatchCallback(const SubscriptionRef& sub,
+                               const EventContextRef& ec);
+
   /// A lock for subscription manipulation.
   mutable Mutex subscription_lock_;
 
@@ -366,6 +400,14 @@ class EventPublisherPlugin : public Plugin,
   /// This is not used to store event date in the backing store.
   std::atomic<EventContextID> next_ec_id_{0};
 
+ private:
+  /// Assign the next EventContext ID and the event time if needed.
+  void stampEventContext(const EventContextRef& ec, EventTime time);
+
+  /// Fire to a Subscription if its EventSubscriber is running.
+  void fireSubscriber(const SubscriptionRef& subscription,
+                      const EventContextRef& ec);
+
  private:
   /// Set ending to True to cause event type run loops to finish.
   std::atomic<bool> ending_{false};
@@ -443,6 +485,17 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    */
   virtual void get(RowYield& yield, EventTime start, EventTime stop) final;
 
+ private:
+  /**
+   * @brief Yield the events within the time and event ID bounds.
+   *
+   * Only the columns used by the query context are decoded, all columns are
+   * decoded without a context.
+   */
+  void get(RowYield& yield,
+           const EventBounds& bounds,
+           const QueryContext* context);
+
  private:
   /// Overload add for tests and allow them to override the event time.
   virtual Status addBatch(std::vector<Row>& row_list,
@@ -600,6 +653,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Compare the number of queries run against the queries configured.
   bool executedAllQueries() const;
 
+  /// The number of events dropped because the dispatch queue was full.
+  size_t numDropped() const;
+
  public:
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
@@ -690,6 +746,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Lock used when recording queries executing against this subscriber.
   mutable Mutex event_query_record_;
 
+  /**
+   * @brief Optional queue and thread delivering events to this subscriber.
+   *
+   * Accessed with the std::atomic_* shared_ptr functions, publishers read it
+   * while the subscriber is deregistered, which resets it.
+   */
+  std::shared_ptr<EventSubscriberDispatcher> dispatcher_{nullptr};
+
  private:
   friend class EventFactory;
   friend class EventPublisherPlugin;
@@ -993,7 +1057,7 @@ class EventPublisher : public EventPublisherPlugin {
     auto pub_sc = getSubscriptionContext(sub->context);
     auto pub_ec = getEventContext(ec);
     if (shouldFire(pub_sc, pub_ec) && sub->callback != nullptr) {
-      sub->callback(pub_ec, pub_sc);
+      dispatchCallback(sub, ec);
     }
   }
 
@@ -67,6 +67,44 @@ void record(const std::string& path,
             PreAggregationType pre_aggregation = PreAggregationType::None,
             TimePoint time_point = Clock::now());
 
+/**
+ * @brief A pre-registered numeric monitoring path for hot code paths.
+ *
+ * The path is registered once, when the metric is constructed. Recording
+ * aggregates the value into a slot owned by the calling thread, without
+ * allocating or contending with other threads. The thread slots are merged
+ * into the pre-aggregation buffer when it is flushed, and when a thread exits.
+ *
+ * The time of the merged points is the flush time. Metrics with the None
+ * pre-aggregation type, or when pre-aggregation is disabled, are recorded with
+ * @see record.
+ *
+ * Common way to use it:
+ * @code{.cpp}
+ * static monitoring::Metric kEvents("osquery.events.inotify.fired");
+ * kEvents.record(1);
+ * @endcode
+ */
+class Metric {
+ public:
+  explicit Metric(std::string path,
+                  PreAggregationType pre_aggregation = PreAggregationType::Sum);
+
+  /// Record a new value, the current time is not read.
+  void record(ValueType value) const;
+
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+  PreAggregationType pre_aggregation_;
+
+  /// The registered slot index.
+  std::size_t id_;
+};
+
 /**
  * Force flush the pre-aggregation buffer.
  * Please use it, only when it's totally necessary.
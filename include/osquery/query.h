@@ -267,6 +267,31 @@ struct QueryPerformance {
   unsigned long long int output_size{0};
 };
 
+/**
+ * @brief Resource limits for a single execution of a query.
+ *
+ * A limit of 0 is not enforced. A query exceeding any limit is interrupted
+ * and fails, the process executing it continues.
+ */
+struct QueryBudget {
+  /// Wall time in seconds.
+  size_t wall_time{0};
+
+  /// Rows in the query results.
+  size_t rows{0};
+
+  /// Bytes, column names and values, in the query results.
+  size_t bytes{0};
+
+  /// Bytes allocated by table generators, SQLite, and the results.
+  size_t memory{0};
+
+  /// True if any limit is enforced.
+  bool limited() const {
+    return wall_time > 0 || rows > 0 || bytes > 0 || memory > 0;
+  }
+};
+
 /**
  * @brief Represents the relevant parameters of a scheduled query.
  *
@@ -296,6 +321,9 @@ struct ScheduledQuery : private only_movable {
   /// Set of query options.
   std::map<std::string, bool> options;
 
+  /// Limits configured for the query, 0 limits use the default budget.
+  QueryBudget budget;
+
   ScheduledQuery() = default;
   ScheduledQuery(ScheduledQuery&&) = default;
   ScheduledQuery& operator=(ScheduledQuery&&) = default;
@@ -512,6 +540,26 @@ class Query {
                        DiffResults& dr,
                        bool calculate_diff = true) const;
 
+  /**
+   * @brief Apply a differential to the stored results.
+   *
+   * When the differential of a scheduled query's results is known, for
+   * example from the changes of its table, the stored results are updated
+   * without comparing a complete set of results.
+   *
+   * The stored results must be from the same query and epoch, and contain
+   * every removed row, otherwise nothing is changed and a failure returned.
+   *
+   * @param dr the rows added and removed since the stored results.
+   * @param epoch the epoch associated with the differential.
+   * @param counter [output] the output that holds the query execution counter.
+   *
+   * @return the success or failure of the operation.
+   */
+  Status addDifferential(const DiffResults& dr,
+                         uint64_t epoch,
+                         uint64_t& counter) const;
+
   /**
    * @brief The most recent result set for a scheduled query.
    *
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <mutex>
@@ -77,6 +78,16 @@ class RegistryInterface : private boost::noncopyable {
   /// Get the 'active' plugin, return success with the active plugin name.
   std::string getActive() const;
 
+  /**
+   * @brief A counter that changes when items are added or removed, or the
+   * 'active' plugin is set.
+   *
+   * Callers may cache a resolved plugin and refresh it when this changes.
+   */
+  size_t getEpoch() const {
+    return epoch_;
+  }
+
   /// Allow others to introspect into the registered name (for reporting).
   virtual std::string getName() const;
 
@@ -232,6 +243,9 @@ class RegistryInterface : private boost::noncopyable {
   /// Protect concurrent accesses to object's data
   mutable Mutex mutex_;
 
+  /// Incremented after each change to the items or the 'active' plugin.
+  std::atomic<size_t> epoch_{0};
+
  private:
   friend class RegistryFactory;
 
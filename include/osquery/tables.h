@@ -10,8 +10,11 @@
 
 #pragma once
 
+#include <limits>
 #include <map>
+#include <memory>
 #include <set>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -26,6 +29,7 @@
 #include <boost/core/ignore_unused.hpp>
 #include <boost/coroutine2/coroutine.hpp>
 #include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include <osquery/core.h>
 #include <osquery/plugin.h>
@@ -303,6 +307,26 @@ using ColumnAliasSet = std::map<std::string, std::set<std::string>>;
 /// Forward declaration of QueryContext for ConstraintList relationships.
 struct QueryContext;
 
+/// A LIKE or GLOB expression compiled for matching, see ConstraintList.
+class ConstraintPattern;
+
+/**
+ * @brief A constraint expression cast to the literal types once.
+ *
+ * Constraints are added before the generator runs, matching rows against the
+ * parsed literals avoids casting each expression for every row.
+ */
+struct ConstraintLiteral {
+  /// The expression as a signed integer, if it can be cast.
+  boost::optional<long long> integer;
+
+  /// The expression as an unsigned integer, if it can be cast.
+  boost::optional<unsigned long long> unsigned_integer;
+
+  /// The compiled LIKE or GLOB expression, if it can be evaluated.
+  std::shared_ptr<const ConstraintPattern> pattern;
+};
+
 /**
  * @brief A ConstraintList is a set of constraints for a column. This list
  * should be mapped to a left-hand-side column name.
@@ -332,19 +356,32 @@ struct ConstraintList : private boost::noncopyable {
    */
   bool matches(const std::string& expr) const;
 
+  /// See ConstraintList::matches, without copying a TEXT expression.
+  bool matches(boost::string_view expr) const;
+
+  /// See ConstraintList::matches, comparing integer affinities as integers.
+  bool matches(long long expr) const;
+
   /**
    * @brief Check if an expression matches the query constraints.
    *
    * `matches` also supports the set of SQL affinite types.
-   * The expression expr will be evaluated as a string and compared using
-   * the affinity of the constraint.
+   * Integer expressions are compared to integer affinities without a text
+   * conversion, other expressions are evaluated as a string and compared
+   * using the affinity of the constraint.
+   *
+   * LIKE and GLOB constraints are evaluated on the TEXT representation of the
+   * expression, other unsupported operators are left for SQLite to apply.
    *
    * @param expr a SQL type expression of the column literal type to check.
    * @return If the expression matched all constraints.
    */
   template <typename T>
   bool matches(const T& expr) const {
-    return matches(SQL_TEXT(expr));
+    using IsInteger = std::integral_constant<bool,
+                                             (std::is_integral<T>::value &&
+                                              sizeof(T) >= sizeof(int))>;
+    return matchesLiteral(expr, IsInteger());
   }
 
   /**
@@ -388,12 +425,6 @@ struct ConstraintList : private boost::noncopyable {
     return (!exists() || matches(expr));
   }
 
-  /**
-   * @brief Helper templated function for ConstraintList::matches.
-   */
-  template <typename T>
-  bool literal_matches(const T& base_expr) const;
-
   /**
    * @brief Get all expressions for a given ConstraintOperator.
    *
@@ -419,9 +450,16 @@ struct ConstraintList : private boost::noncopyable {
    *
    * @param constraint a new operator/expression to constrain.
    */
-  void add(const struct Constraint& constraint) {
-    constraints_.push_back(constraint);
-  }
+  void add(const struct Constraint& constraint);
+
+  /**
+   * @brief Add a new Constraint with an expression SQLite provided as an
+   * integer value.
+   *
+   * @param constraint a new operator/expression to constrain.
+   * @param value the integer value of the expression.
+   */
+  void add(const struct Constraint& constraint, long long value);
 
   /**
    * @brief Serialize a ConstraintList into a property tree.
@@ -439,10 +477,36 @@ struct ConstraintList : private boost::noncopyable {
   /// See ConstraintList::unserialize.
   void deserialize(const rapidjson::Value& obj);
 
+ private:
+  /// Compare integral expressions without a text conversion if possible.
+  template <typename T>
+  bool matchesLiteral(const T& expr, std::true_type) const {
+    if (std::is_unsigned<T>::value &&
+        static_cast<unsigned long long>(expr) >
+            static_cast<unsigned long long>(
+                std::numeric_limits<long long>::max())) {
+      return matches(SQL_TEXT(expr));
+    }
+    return matches(static_cast<long long>(expr));
+  }
+
+  /// Compare all other expressions as text.
+  template <typename T>
+  bool matchesLiteral(const T& expr, std::false_type) const {
+    return matches(SQL_TEXT(expr));
+  }
+
+  /// Evaluate the constraints against an expression of a literal type.
+  template <typename T>
+  bool typedMatches(const T& expr) const;
+
  private:
   /// List of constraint operator/expressions.
   std::vector<struct Constraint> constraints_;
 
+  /// The parsed literals for each constraint in constraints_.
+  std::vector<ConstraintLiteral> literals_;
+
  private:
   friend struct QueryContext;
 
@@ -714,6 +778,23 @@ struct QueryContext : private only_movable {
 using QueryContext = struct QueryContext;
 using Constraint = struct Constraint;
 
+/**
+ * @brief The rows of a table that changed since a cursor.
+ *
+ * A cursor is an opaque string the table uses to find its state when the
+ * previous changes were requested, such as a modification time.
+ */
+struct TableChanges {
+  /// Rows that were added since the cursor.
+  QueryData added;
+
+  /// Rows that were removed since the cursor.
+  QueryData removed;
+
+  /// The cursor to request the next changes with.
+  std::string cursor;
+};
+
 /**
  * @brief The TablePlugin defines the name, types, and column information.
  *
@@ -753,6 +834,16 @@ class TablePlugin : public Plugin {
     return TableAttributes::NONE;
   }
 
+  /**
+   * @brief Seconds that cached results remain fresh.
+   *
+   * Cacheable tables may declare a cache TTL in their spec. A TTL of 0 keeps
+   * results fresh for the interval of the scheduled query that cached them.
+   */
+  virtual size_t cacheTTL() const {
+    return 0;
+  }
+
   /**
    * @brief Generate a complete table representation.
    *
@@ -819,6 +910,9 @@ class TablePlugin : public Plugin {
    * always more memory efficient. It can be more compute efficient for tables
    * with over 1000 rows.
    *
+   * The yielded Row is moved to the caller, it should not be read after the
+   * yield returns. Coroutine stacks are pooled and reused between scans.
+   *
    * @param yield a callable that takes a single Row as input.
    * @param context a query context filled in by SQLite's virtual table API.
    */
@@ -832,6 +926,37 @@ class TablePlugin : public Plugin {
     return false;
   }
 
+  /// Override and return true if the table implements changes.
+  virtual bool providesChanges() const {
+    return false;
+  }
+
+  /**
+   * @brief Generate the rows that changed since a cursor.
+   *
+   * Tables that can cheaply tell what changed, without generating all of
+   * their rows, may implement changes and set changes="genFunction" in their
+   * spec's implementation. The scheduler uses them for differential queries
+   * that select and filter columns of only this table.
+   *
+   * An empty cursor requests all rows as added. The cursor must be read
+   * before generating rows, so no change is missed. A failure means the
+   * changes are not known, the caller falls back to a full generate.
+   *
+   * @param context a query context filled in by SQLite's virtual table API.
+   * @param cursor the cursor returned with the previous changes, or empty.
+   * @param changes [output] the changed rows and the next cursor.
+   */
+  virtual Status changes(QueryContext& context,
+                         const std::string& cursor,
+                         TableChanges& changes) {
+    boost::ignore_unused(context);
+    boost::ignore_unused(cursor);
+    boost::ignore_unused(changes);
+
+    return Status(1, "Table does not provide changes");
+  }
+
  protected:
   /// An SQL table containing the table definition/syntax.
   std::string columnDefinition(bool is_extension = false) const;
@@ -849,14 +974,11 @@ class TablePlugin : public Plugin {
    * table "processes" at the interval 60. The first executed will cache results
    * and the second will use the cached results.
    *
-   * Table results are not cached if a QueryContext contains constraints or
-   * provides HOB (hand-off blocks) to additional tables within a query.
-   * Currently, the query scheduler cannot communicate to table implementations.
-   * An interval is set globally by the scheduler and passed to the table
-   * implementation as a future-proof API. There is no "shortcut" for caching
-   * when used in external tables. A cache lookup within an extension means
-   * a database call API and re-serialization to the virtual table APIs. In
-   * practice this does not perform well and is explicitly disabled.
+   * Results are kept in memory by the TableCache, keyed by the table and the
+   * constraints on INDEX, REQUIRED, ADDITIONAL, and OPTIMIZED columns. Results
+   * remain fresh for the table's cacheTTL, if declared, otherwise for the
+   * interval that cached them. An interval is set globally by the scheduler and
+   * passed to the table implementation as a future-proof API.
    *
    * @param interval The interval this query expects the tables results.
    * @param ctx The query context.
@@ -865,35 +987,26 @@ class TablePlugin : public Plugin {
   bool isCached(size_t interval, const QueryContext& ctx) const;
 
   /**
-   * @brief Perform a database lookup of cached results and deserialize.
+   * @brief Retrieve the cached results found by isCached.
    *
    * If a query determined the table's cached results are fresh, it may ask the
-   * table to retrieve results from the database and deserialized them into
-   * table row data.
+   * table to retrieve the results from the cache, on the same thread.
    *
-   * @return The deserialized row data of cached results.
+   * @return The row data of cached results.
    */
   QueryData getCache() const;
 
   /**
    * @brief Similar to getCache, stores the results from generate.
    *
-   * Set will serialize and save the results as JSON to be retrieved later.
-   * It will inspect the query context, if any required/indexed/optimized or
-   * additional columns are used then the cache will not be saved.
+   * The results are kept for the constraints and used columns of the query
+   * context, see isCached.
    */
   void setCache(size_t step,
                 size_t interval,
                 const QueryContext& ctx,
                 const QueryData& results);
 
- private:
-  /// The last time in seconds the table data results were saved to cache.
-  size_t last_cached_{0};
-
-  /// The last interval in seconds when the table data was cached.
-  size_t last_interval_{0};
-
  public:
   /**
    * @brief The scheduled interval for the executing query.
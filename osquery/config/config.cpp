@@ -107,6 +107,9 @@ DECLARE_string(pack_delimiter);
 const std::string kExecutingQuery{"executing_query"};
 const std::string kFailedQueries{"failed_queries"};
 
+/// Seconds a failed query remains blacklisted.
+const size_t kBlacklistDuration{86400};
+
 /// The time osquery was started.
 std::atomic<size_t> kStartTime;
 
@@ -318,7 +321,7 @@ Schedule::Schedule() {
     LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
     // Add this query name to the blacklist and save the blacklist.
-    blacklist_[failed_query_] = getUnixTime() + 86400;
+    blacklist_[failed_query_] = getUnixTime() + kBlacklistDuration;
     saveScheduleBlacklist(blacklist_);
   }
 }
@@ -969,6 +972,12 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::blacklistQuery(const std::string& name) {
+  RecursiveLock lock(config_schedule_mutex_);
+  schedule_->blacklist_[name] = getUnixTime() + kBlacklistDuration;
+  saveScheduleBlacklist(schedule_->blacklist_);
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) const {
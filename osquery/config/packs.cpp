@@ -232,6 +232,18 @@ void Pack::initialize(const std::string& name,
       query.options["blacklist"] = JSON::valueToBool(q.value["blacklist"]);
     }
 
+    if (q.value.HasMember("budget") && q.value["budget"].IsObject()) {
+      const auto& budget = q.value["budget"];
+      auto limit = [&budget](const char* name) -> size_t {
+        auto it = budget.FindMember(name);
+        return (it != budget.MemberEnd()) ? JSON::valueToSize(it->value) : 0;
+      };
+      query.budget.wall_time = limit("wall_time");
+      query.budget.rows = limit("rows");
+      query.budget.bytes = limit("bytes");
+      query.budget.memory = limit("memory");
+    }
+
     schedule_.emplace(std::make_pair(q.name.GetString(), std::move(query)));
   }
 }
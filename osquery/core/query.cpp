@@ -167,6 +167,50 @@ Status Query::addNewResults(QueryData current_qd,
   return Status(0, "OK");
 }
 
+Status Query::addDifferential(const DiffResults& dr,
+                              const uint64_t epoch,
+                              uint64_t& counter) const {
+  if (!isQueryNameInDatabase() || getPreviousEpoch() != epoch ||
+      isNewQuery()) {
+    return Status(1, "No stored results for scheduled query: " + name_);
+  }
+
+  std::string json;
+  if (!dr.added.empty() || !dr.removed.empty()) {
+    QueryDataSet stored_qd;
+    auto status = getPreviousQueryResults(stored_qd);
+    if (!status.ok()) {
+      return status;
+    }
+
+    for (const auto& row : dr.removed) {
+      auto it = stored_qd.find(row);
+      if (it == stored_qd.end()) {
+        return Status(1, "Removed row is not stored for: " + name_);
+      }
+      stored_qd.erase(it);
+    }
+    stored_qd.insert(dr.added.begin(), dr.added.end());
+
+    status =
+        serializeQueryDataJSON(QueryData(stored_qd.begin(), stored_qd.end()),
+                               json);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  counter = getQueryCounter(false);
+  auto status =
+      setDatabaseValue(kQueries, name_ + "counter", std::to_string(counter));
+  if (!status.ok() || json.empty()) {
+    return status;
+  }
+
+  // The epoch is unchanged, only the results are replaced.
+  return setDatabaseValue(kQueries, name_, json);
+}
+
 Status serializeRow(const Row& r,
                     const ColumnNames& cols,
                     JSON& doc,
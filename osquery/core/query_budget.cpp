@@ -0,0 +1,123 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+
+#include <osquery/flags.h>
+
+#include "osquery/core/query_budget.h"
+
+namespace osquery {
+
+FLAG(uint64,
+     query_budget_wall_time,
+     0,
+     "Default seconds a scheduled query may run (0 for no limit)");
+
+FLAG(uint64,
+     query_budget_rows,
+     0,
+     "Default rows a scheduled query may return (0 for no limit)");
+
+FLAG(uint64,
+     query_budget_bytes,
+     0,
+     "Default bytes of results a scheduled query may return (0 for no limit)");
+
+FLAG(uint64,
+     query_budget_memory,
+     0,
+     "Default bytes a scheduled query may allocate (0 for no limit)");
+
+namespace {
+thread_local QueryBudgetTracker* kCurrentTracker{nullptr};
+} // namespace
+
+QueryBudgetTracker::QueryBudgetTracker(const QueryBudget& budget)
+    : budget_(budget),
+      start_(std::chrono::steady_clock::now()),
+      previous_(kCurrentTracker) {
+  kCurrentTracker = this;
+}
+
+QueryBudgetTracker::~QueryBudgetTracker() {
+  kCurrentTracker = previous_;
+}
+
+QueryBudgetTracker* QueryBudgetTracker::current() {
+  return kCurrentTracker;
+}
+
+void QueryBudgetTracker::addResults(size_t rows, size_t bytes) {
+  rows_ += rows;
+  bytes_ += bytes;
+}
+
+void QueryBudgetTracker::addMemory(size_t bytes) {
+  memory_ += bytes;
+}
+
+void QueryBudgetTracker::releaseMemory(size_t bytes) {
+  memory_ -= std::min(bytes, memory_);
+}
+
+void QueryBudgetTracker::setSQLiteMemory(size_t bytes) {
+  sqlite_memory_ = bytes;
+}
+
+bool QueryBudgetTracker::exceeded() {
+  if (!reason_.empty()) {
+    return true;
+  }
+
+  if (budget_.rows > 0 && rows_ > budget_.rows) {
+    reason_ = "rows " + std::to_string(rows_) + " exceeded " +
+              std::to_string(budget_.rows);
+  } else if (budget_.bytes > 0 && bytes_ > budget_.bytes) {
+    reason_ = "bytes " + std::to_string(bytes_) + " exceeded " +
+              std::to_string(budget_.bytes);
+  } else if (budget_.memory > 0 &&
+             memory_ + sqlite_memory_ + bytes_ > budget_.memory) {
+    reason_ = "memory " + std::to_string(memory_ + sqlite_memory_ + bytes_) +
+              " exceeded " + std::to_string(budget_.memory);
+  } else if (budget_.wall_time > 0) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::steady_clock::now() - start_)
+                       .count();
+    if (static_cast<size_t>(elapsed) >= budget_.wall_time) {
+      reason_ = "wall time " + std::to_string(elapsed) + "s exceeded " +
+                std::to_string(budget_.wall_time) + "s";
+    }
+  }
+  return !reason_.empty();
+}
+
+bool queryBudgetExceeded() {
+  auto tracker = QueryBudgetTracker::current();
+  return tracker != nullptr && tracker->exceeded();
+}
+
+QueryBudget getQueryBudget(const QueryBudget& configured) {
+  QueryBudget budget = configured;
+  if (budget.wall_time == 0) {
+    budget.wall_time = FLAGS_query_budget_wall_time;
+  }
+  if (budget.rows == 0) {
+    budget.rows = FLAGS_query_budget_rows;
+  }
+  if (budget.bytes == 0) {
+    budget.bytes = FLAGS_query_budget_bytes;
+  }
+  if (budget.memory == 0) {
+    budget.memory = FLAGS_query_budget_memory;
+  }
+  return budget;
+}
+} // namespace osquery
@@ -0,0 +1,85 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/query.h>
+
+namespace osquery {
+
+/**
+ * @brief Enforce a QueryBudget for the query executing on the calling thread.
+ *
+ * The tracker is installed for its lifetime on the thread that constructed
+ * it. SQLite consults the tracker as it steps through the query and
+ * interrupts the execution once a limit is exceeded. Table generators that
+ * may run for a long time should check queryBudgetExceeded and return the
+ * rows generated so far.
+ */
+class QueryBudgetTracker : private boost::noncopyable {
+ public:
+  explicit QueryBudgetTracker(const QueryBudget& budget);
+  ~QueryBudgetTracker();
+
+  /// The tracker installed on the calling thread, or nullptr.
+  static QueryBudgetTracker* current();
+
+  /// Account rows added to the query results.
+  void addResults(size_t rows, size_t bytes);
+
+  /// Account memory allocated by table generators.
+  void addMemory(size_t bytes);
+
+  /// Release memory accounted with addMemory once it is freed.
+  void releaseMemory(size_t bytes);
+
+  /// Set the memory allocated by the query's connection since it started.
+  void setSQLiteMemory(size_t bytes);
+
+  /// Check the limits, once exceeded the query remains exceeded.
+  bool exceeded();
+
+  /// A description of the exceeded limit, empty if none are exceeded.
+  const std::string& reason() const {
+    return reason_;
+  }
+
+ private:
+  QueryBudget budget_;
+
+  std::chrono::steady_clock::time_point start_;
+
+  size_t rows_{0};
+  size_t bytes_{0};
+  size_t memory_{0};
+  size_t sqlite_memory_{0};
+
+  std::string reason_;
+
+  /// The tracker this replaced on the thread.
+  QueryBudgetTracker* previous_{nullptr};
+};
+
+/**
+ * @brief Check if the query executing on the calling thread should stop.
+ *
+ * Table generators may call this between expensive steps, it returns false
+ * when no budget is enforced.
+ */
+bool queryBudgetExceeded();
+
+/// Build the budget of a scheduled query, using flag defaults for 0 limits.
+QueryBudget getQueryBudget(const QueryBudget& configured);
+} // namespace osquery
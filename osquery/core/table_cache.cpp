@@ -0,0 +1,213 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+
+#include <osquery/flags.h>
+#include <osquery/numeric_monitoring.h>
+
+#include "osquery/core/table_cache.h"
+
+namespace osquery {
+
+FLAG(uint64,
+     table_cache_size,
+     16 * 1024 * 1024,
+     "Bytes of table results cached for scheduled queries");
+
+/// Approximate bytes for each cached row column beyond the string content.
+const size_t kTableCacheColumnOverhead = 64;
+
+/// Constraints on columns with these options may change the results.
+const ColumnOptions kTableCacheKeyOptions =
+    ColumnOptions::INDEX | ColumnOptions::REQUIRED | ColumnOptions::ADDITIONAL |
+    ColumnOptions::OPTIMIZED;
+
+static size_t estimateBytes(const QueryData& results) {
+  size_t bytes = 0;
+  for (const auto& row : results) {
+    for (const auto& column : row) {
+      bytes += column.first.size() + column.second.size() +
+               kTableCacheColumnOverhead;
+    }
+  }
+  return bytes;
+}
+
+static bool includesColumns(const boost::optional<UsedColumns>& cached,
+                            const boost::optional<UsedColumns>& used) {
+  if (!cached) {
+    // All columns were generated.
+    return true;
+  }
+
+  if (!used) {
+    return false;
+  }
+
+  for (const auto& column : *used) {
+    if (cached->count(column) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string TableCache::getKey(const TablePlugin& table,
+                               const QueryContext& context) {
+  auto key = table.getName();
+  for (const auto& column : table.columns()) {
+    if (!(std::get<2>(column) & kTableCacheKeyOptions)) {
+      continue;
+    }
+
+    const auto& name = std::get<0>(column);
+    auto constraints = context.constraints.find(name);
+    if (constraints == context.constraints.end() ||
+        !constraints->second.exists()) {
+      continue;
+    }
+
+    // Sort the constraints so equivalent queries share results.
+    std::vector<std::string> terms;
+    for (const auto& constraint : constraints->second.getAll()) {
+      terms.push_back(std::to_string(constraint.op) + ' ' + constraint.expr);
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    for (const auto& term : terms) {
+      key += '\0' + name + ' ' + term;
+    }
+  }
+  return key;
+}
+
+void TableCache::record(const std::string& table, bool hit) {
+  auto& metrics = metrics_[table];
+  if (hit) {
+    metrics.hits++;
+  } else {
+    metrics.misses++;
+  }
+
+  monitoring::record("osquery.table_cache." + table + (hit ? ".hit" : ".miss"),
+                     1,
+                     monitoring::PreAggregationType::Sum);
+}
+
+std::shared_ptr<const QueryData> TableCache::find(const TablePlugin& table,
+                                                  const QueryContext& context,
+                                                  size_t step) {
+  auto key = getKey(table, context);
+
+  WriteLock lock(mutex_);
+  auto entries = index_.find(key);
+  if (entries != index_.end()) {
+    // Copy the iterators, stale entries are removed while iterating.
+    auto candidates = entries->second;
+    for (auto entry : candidates) {
+      if (step >= entry->expires) {
+        erase(entry);
+        continue;
+      }
+
+      if (includesColumns(entry->columns, context.colsUsed)) {
+        // Move the entry to the most recently used position.
+        entries_.splice(entries_.begin(), entries_, entry);
+        record(table.getName(), true);
+        return entry->results;
+      }
+    }
+  }
+
+  record(table.getName(), false);
+  return nullptr;
+}
+
+void TableCache::insert(const TablePlugin& table,
+                        const QueryContext& context,
+                        size_t step,
+                        size_t lifetime,
+                        const QueryData& results) {
+  auto limit = static_cast<size_t>(FLAGS_table_cache_size);
+  Entry entry;
+  entry.key = getKey(table, context);
+  entry.columns = context.colsUsed;
+  entry.expires = step + lifetime;
+  entry.bytes = estimateBytes(results) + entry.key.size();
+  if (entry.bytes > limit) {
+    return;
+  }
+  entry.results = std::make_shared<const QueryData>(results);
+
+  WriteLock lock(mutex_);
+  auto entries = index_.find(entry.key);
+  if (entries != index_.end()) {
+    // Replace results generated for the same, or fewer, columns.
+    auto candidates = entries->second;
+    for (auto previous : candidates) {
+      if (includesColumns(entry.columns, previous->columns)) {
+        erase(previous);
+      }
+    }
+  }
+
+  evict(limit - entry.bytes);
+  bytes_ += entry.bytes;
+  entries_.push_front(std::move(entry));
+  index_[entries_.front().key].push_back(entries_.begin());
+}
+
+void TableCache::erase(EntryList::iterator entry) {
+  auto entries = index_.find(entry->key);
+  if (entries != index_.end()) {
+    auto& list = entries->second;
+    list.erase(std::remove(list.begin(), list.end(), entry), list.end());
+    if (list.empty()) {
+      index_.erase(entries);
+    }
+  }
+
+  bytes_ -= entry->bytes;
+  entries_.erase(entry);
+}
+
+void TableCache::evict(size_t limit) {
+  while (bytes_ > limit && !entries_.empty()) {
+    auto oldest = std::prev(entries_.end());
+    auto table = oldest->key.substr(0, oldest->key.find('\0'));
+    metrics_[table].evictions++;
+    erase(oldest);
+  }
+}
+
+TableCache::Metrics TableCache::metrics(const std::string& table) const {
+  ReadLock lock(mutex_);
+  auto metrics = metrics_.find(table);
+  if (metrics == metrics_.end()) {
+    return Metrics();
+  }
+  return metrics->second;
+}
+
+size_t TableCache::bytes() const {
+  ReadLock lock(mutex_);
+  return bytes_;
+}
+
+void TableCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  metrics_.clear();
+  bytes_ = 0;
+}
+} // namespace osquery
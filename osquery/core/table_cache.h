@@ -0,0 +1,137 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include <osquery/mutex.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief An in-memory cache of table results for scheduled queries.
+ *
+ * Results are keyed by the table name and the normalized constraints on the
+ * table's INDEX, REQUIRED, ADDITIONAL, and OPTIMIZED columns. Constraints on
+ * other columns are applied by SQLite and do not change the results.
+ *
+ * Results remain fresh for the table's spec-declared cache TTL, or else the
+ * interval of the scheduled query that generated them. The cache is limited
+ * to `table_cache_size` bytes, the least recently used results are evicted
+ * first.
+ */
+class TableCache : private boost::noncopyable {
+ public:
+  /// Cache lookups for a table.
+  struct Metrics {
+    size_t hits{0};
+    size_t misses{0};
+    size_t evictions{0};
+  };
+
+ public:
+  static TableCache& get() {
+    static TableCache instance;
+    return instance;
+  }
+
+  /**
+   * @brief Find fresh results for a table scan.
+   *
+   * @param table the table plugin.
+   * @param context the constraints and used columns of the scan.
+   * @param step the current schedule step.
+   * @return the results, or nullptr if none are fresh.
+   */
+  std::shared_ptr<const QueryData> find(const TablePlugin& table,
+                                        const QueryContext& context,
+                                        size_t step);
+
+  /**
+   * @brief Keep the results of a table scan.
+   *
+   * @param table the table plugin.
+   * @param context the constraints and used columns of the scan.
+   * @param step the current schedule step.
+   * @param lifetime the number of steps the results are fresh.
+   * @param results the generated rows.
+   */
+  void insert(const TablePlugin& table,
+              const QueryContext& context,
+              size_t step,
+              size_t lifetime,
+              const QueryData& results);
+
+  /// Get the lookup metrics for a table.
+  Metrics metrics(const std::string& table) const;
+
+  /// The estimated bytes of cached results.
+  size_t bytes() const;
+
+  /// Remove all results and metrics.
+  void clear();
+
+ private:
+  TableCache() = default;
+
+  struct Entry {
+    /// The table name and normalized constraints.
+    std::string key;
+
+    /// The used columns, unset if all columns were generated.
+    boost::optional<UsedColumns> columns;
+
+    /// The results are fresh before this step.
+    size_t expires{0};
+
+    std::shared_ptr<const QueryData> results;
+    size_t bytes{0};
+  };
+
+  using EntryList = std::list<Entry>;
+
+  /// Build the key for a scan of a table.
+  static std::string getKey(const TablePlugin& table,
+                            const QueryContext& context);
+
+  /// Remove an entry, the caller holds the lock.
+  void erase(EntryList::iterator entry);
+
+  /// Record a lookup in the metrics, the caller holds the lock.
+  void record(const std::string& table, bool hit);
+
+  /// Evict the least recently used entries until within the limit.
+  void evict(size_t limit);
+
+ private:
+  /// Entries ordered from the most to the least recently used.
+  EntryList entries_;
+
+  /// Entries for each key, one for each set of used columns.
+  std::map<std::string, std::vector<EntryList::iterator>> index_;
+
+  /// Lookup metrics for each table.
+  std::map<std::string, Metrics> metrics_;
+
+  /// Estimated bytes of all cached results.
+  size_t bytes_{0};
+
+  mutable Mutex mutex_;
+};
+} // namespace osquery
@@ -8,8 +8,11 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <cctype>
+
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/core/table_cache.h"
 
 #include <osquery/database.h>
 #include <osquery/flags.h>
@@ -27,6 +30,14 @@ QueryContext queryContextFromRequest(const PluginRequest& request) {
 
   return context;
 };
+
+/// Results found by the last isCached on this thread, returned by getCache.
+struct CacheLookup {
+  const TablePlugin* table{nullptr};
+  std::shared_ptr<const QueryData> results;
+};
+
+thread_local CacheLookup kCacheLookup;
 } // namespace
 
 FLAG(bool, disable_caching, false, "Disable scheduled query caching");
@@ -183,57 +194,38 @@ PluginResponse TablePlugin::routeInfo() const {
   return response;
 }
 
-static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
-  if (!ctx.useCache()) {
-    // The query execution did not request use of the warm cache.
-    return false;
-  }
-
-  auto uncachable = ColumnOptions::INDEX | ColumnOptions::REQUIRED |
-                    ColumnOptions::ADDITIONAL | ColumnOptions::OPTIMIZED;
-  for (const auto& column : cols) {
-    auto opts = std::get<2>(column) & uncachable;
-    if (opts && ctx.constraints.at(std::get<0>(column)).exists()) {
-      return false;
-    }
-  }
-  return true;
-}
-
 bool TablePlugin::isCached(size_t step, const QueryContext& ctx) const {
-  if (FLAGS_disable_caching) {
+  // The query execution must request use of the warm cache.
+  if (FLAGS_disable_caching || !ctx.useCache()) {
     return false;
   }
 
-  // Perform the step comparison first, because it's easy.
-  return (step < last_cached_ + last_interval_ && cacheAllowed(columns(), ctx));
+  kCacheLookup.table = this;
+  kCacheLookup.results = TableCache::get().find(*this, ctx, step);
+  return (kCacheLookup.results != nullptr);
 }
 
 QueryData TablePlugin::getCache() const {
   VLOG(1) << "Retrieving results from cache for table: " << getName();
-  // Lookup results from database and deserialize.
-  std::string content;
-  getDatabaseValue(kQueries, "cache." + getName(), content);
-  QueryData results;
-  deserializeQueryDataJSON(content, results);
-  return results;
+  if (kCacheLookup.table != this || kCacheLookup.results == nullptr) {
+    return QueryData();
+  }
+
+  auto results = std::move(kCacheLookup.results);
+  kCacheLookup.table = nullptr;
+  return *results;
 }
 
 void TablePlugin::setCache(size_t step,
                            size_t interval,
                            const QueryContext& ctx,
                            const QueryData& results) {
-  if (FLAGS_disable_caching || !cacheAllowed(columns(), ctx)) {
+  if (FLAGS_disable_caching || !ctx.useCache()) {
     return;
   }
 
-  // Serialize QueryData and save to database.
-  std::string content;
-  if (serializeQueryDataJSON(results, content)) {
-    last_cached_ = step;
-    last_interval_ = interval;
-    setDatabaseValue(kQueries, "cache." + getName(), content);
-  }
+  auto lifetime = (cacheTTL() > 0) ? cacheTTL() : interval;
+  TableCache::get().insert(*this, ctx, step, lifetime, results);
 }
 
 std::string columnDefinition(const TableColumns& columns, bool is_extension) {
@@ -363,59 +355,419 @@ bool ConstraintList::exists(const ConstraintOperatorFlag ops) const {
   }
 }
 
+namespace {
+
+/// Check if an operator is compared against the literal value.
+bool isComparison(unsigned char op) {
+  return op == EQUALS || op == GREATER_THAN || op == LESS_THAN ||
+         op == GREATER_THAN_OR_EQUALS || op == LESS_THAN_OR_EQUALS;
+}
+
+template <typename T>
+bool compareLiteral(unsigned char op, const T& expr, const T& value) {
+  switch (op) {
+  case EQUALS:
+    return expr == value;
+  case GREATER_THAN:
+    return expr > value;
+  case LESS_THAN:
+    return expr < value;
+  case GREATER_THAN_OR_EQUALS:
+    return expr >= value;
+  case LESS_THAN_OR_EQUALS:
+    return expr <= value;
+  default:
+    return true;
+  }
+}
+
+/// Check if stoll and stoull would read a number, without throwing.
+bool mayBeInteger(const std::string& expr) {
+  size_t i = 0;
+  while (i < expr.size() && std::isspace(static_cast<unsigned char>(expr[i]))) {
+    i++;
+  }
+  if (i < expr.size() && (expr[i] == '+' || expr[i] == '-')) {
+    i++;
+  }
+  return i < expr.size() && std::isdigit(static_cast<unsigned char>(expr[i]));
+}
+
+bool literalValue(const Constraint& constraint,
+                  const ConstraintLiteral& /* literal */,
+                  ColumnType /* affinity */,
+                  boost::string_view& value) {
+  value = constraint.expr;
+  return true;
+}
+
+bool literalValue(const Constraint& /* constraint */,
+                  const ConstraintLiteral& literal,
+                  ColumnType affinity,
+                  long long& value) {
+  if (!literal.integer) {
+    return false;
+  }
+
+  value = *literal.integer;
+  if (affinity == INTEGER_TYPE) {
+    // The INTEGER literal is an int, larger values cannot be cast.
+    return value >= std::numeric_limits<INTEGER_LITERAL>::min() &&
+           value <= std::numeric_limits<INTEGER_LITERAL>::max();
+  }
+  return true;
+}
+
+bool literalValue(const Constraint& /* constraint */,
+                  const ConstraintLiteral& literal,
+                  ColumnType /* affinity */,
+                  unsigned long long& value) {
+  if (!literal.unsigned_integer) {
+    return false;
+  }
+  value = *literal.unsigned_integer;
+  return true;
+}
+
+boost::string_view patternText(boost::string_view expr,
+                               std::string& /* text */) {
+  return expr;
+}
+
+template <typename T>
+boost::string_view patternText(T expr, std::string& text) {
+  if (text.empty()) {
+    text = std::to_string(expr);
+  }
+  return text;
+}
+
+/// The length of the UTF-8 character at pos, as SQLite reads characters.
+size_t characterLength(boost::string_view text, size_t pos) {
+  size_t length = 1;
+  if (static_cast<unsigned char>(text[pos]) >= 0xC0) {
+    while (pos + length < text.size() &&
+           (static_cast<unsigned char>(text[pos + length]) & 0xC0) == 0x80) {
+      length++;
+    }
+  }
+  return length;
+}
+
+char toLowerASCII(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+} // namespace
+
+/**
+ * @brief A LIKE or GLOB expression compiled into a sequence of tokens.
+ *
+ * The matching follows SQLite: LIKE is case-insensitive for ASCII and has no
+ * escape character, GLOB is case-sensitive and supports character classes.
+ * Only ASCII patterns are compiled, SQLite evaluates the others.
+ */
+class ConstraintPattern {
+ public:
+  /// Compile a pattern, returns nullptr if it cannot be compiled.
+  static std::shared_ptr<const ConstraintPattern> compile(
+      unsigned char op, const std::string& expr);
+
+  /// Check if the text matches the entire pattern.
+  bool matches(boost::string_view text) const;
+
+ private:
+  enum class Kind {
+    TEXT,
+    ANY_CHARACTER,
+    ANY_SEQUENCE,
+    CHARACTER_CLASS,
+  };
+
+  struct Token {
+    Kind kind;
+
+    /// The literal text, lowercase if the pattern is case-insensitive.
+    std::string text;
+
+    /// The inclusive ranges of a character class.
+    std::vector<std::pair<char, char>> ranges;
+
+    /// The character class matches characters not in the ranges.
+    bool invert{false};
+  };
+
+  /// Match a token at pos, setting the length of text it matched.
+  bool matchToken(const Token& token,
+                  boost::string_view text,
+                  size_t pos,
+                  size_t& length) const;
+
+ private:
+  std::vector<Token> tokens_;
+
+  bool case_insensitive_{false};
+};
+
+std::shared_ptr<const ConstraintPattern> ConstraintPattern::compile(
+    unsigned char op, const std::string& expr) {
+  auto pattern = std::make_shared<ConstraintPattern>();
+  pattern->case_insensitive_ = (op == LIKE);
+  auto any_sequence = (op == LIKE) ? '%' : '*';
+  auto any_character = (op == LIKE) ? '_' : '?';
+
+  auto& tokens = pattern->tokens_;
+  for (size_t i = 0; i < expr.size(); ++i) {
+    auto c = expr[i];
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      return nullptr;
+    }
+
+    if (c == any_sequence) {
+      if (tokens.empty() || tokens.back().kind != Kind::ANY_SEQUENCE) {
+        tokens.push_back({Kind::ANY_SEQUENCE, "", {}, false});
+      }
+    } else if (c == any_character) {
+      tokens.push_back({Kind::ANY_CHARACTER, "", {}, false});
+    } else if (op == GLOB && c == '[') {
+      Token token{Kind::CHARACTER_CLASS, "", {}, false};
+      i++;
+      if (i < expr.size() && expr[i] == '^') {
+        token.invert = true;
+        i++;
+      }
+      if (i < expr.size() && expr[i] == ']') {
+        token.ranges.push_back({']', ']'});
+        i++;
+      }
+
+      char prior = 0;
+      for (; i < expr.size() && expr[i] != ']'; ++i) {
+        if (static_cast<unsigned char>(expr[i]) >= 0x80) {
+          return nullptr;
+        }
+
+        if (expr[i] == '-' && prior > 0 && i + 1 < expr.size() &&
+            expr[i + 1] != ']') {
+          if (static_cast<unsigned char>(expr[i + 1]) >= 0x80) {
+            return nullptr;
+          }
+          token.ranges.push_back({prior, expr[i + 1]});
+          prior = 0;
+          i++;
+        } else {
+          token.ranges.push_back({expr[i], expr[i]});
+          prior = expr[i];
+        }
+      }
+
+      if (i == expr.size()) {
+        // An unterminated character class never matches.
+        return nullptr;
+      }
+      tokens.push_back(std::move(token));
+    } else {
+      if (tokens.empty() || tokens.back().kind != Kind::TEXT) {
+        tokens.push_back({Kind::TEXT, "", {}, false});
+      }
+      tokens.back().text +=
+          (pattern->case_insensitive_) ? toLowerASCII(c) : c;
+    }
+  }
+  return pattern;
+}
+
+bool ConstraintPattern::matchToken(const Token& token,
+                                   boost::string_view text,
+                                   size_t pos,
+                                   size_t& length) const {
+  if (token.kind == Kind::TEXT) {
+    if (text.size() - pos < token.text.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < token.text.size(); ++i) {
+      auto c = text[pos + i];
+      if (case_insensitive_) {
+        c = toLowerASCII(c);
+      }
+      if (c != token.text[i]) {
+        return false;
+      }
+    }
+    length = token.text.size();
+    return true;
+  }
+
+  if (pos == text.size()) {
+    return false;
+  }
+
+  length = characterLength(text, pos);
+  if (token.kind == Kind::ANY_CHARACTER) {
+    return true;
+  }
+
+  bool seen = false;
+  if (static_cast<unsigned char>(text[pos]) < 0x80) {
+    for (const auto& range : token.ranges) {
+      if (text[pos] >= range.first && text[pos] <= range.second) {
+        seen = true;
+        break;
+      }
+    }
+  }
+  return seen != token.invert;
+}
+
+bool ConstraintPattern::matches(boost::string_view text) const {
+  size_t token = 0;
+  size_t pos = 0;
+
+  // The token following the last ANY_SEQUENCE, and where it was tried.
+  bool backtrack = false;
+  size_t sequence_token = 0;
+  size_t sequence_pos = 0;
+
+  while (true) {
+    if (token < tokens_.size()) {
+      if (tokens_[token].kind == Kind::ANY_SEQUENCE) {
+        if (++token == tokens_.size()) {
+          // A trailing ANY_SEQUENCE matches the rest of the text.
+          return true;
+        }
+        backtrack = true;
+        sequence_token = token;
+        sequence_pos = pos;
+        continue;
+      }
+
+      size_t length = 0;
+      if (matchToken(tokens_[token], text, pos, length)) {
+        pos += length;
+        token++;
+        continue;
+      }
+    } else if (pos == text.size()) {
+      return true;
+    }
+
+    // Let the last ANY_SEQUENCE consume another character and retry.
+    if (!backtrack || sequence_pos == text.size()) {
+      return false;
+    }
+    sequence_pos += characterLength(text, sequence_pos);
+    token = sequence_token;
+    pos = sequence_pos;
+  }
+}
+
 bool ConstraintList::matches(const std::string& expr) const {
   // Support each SQL affinity type casting.
   if (affinity == TEXT_TYPE) {
-    return literal_matches<TEXT_LITERAL>(expr);
+    return typedMatches(boost::string_view(expr));
   } else if (affinity == INTEGER_TYPE) {
     auto lexpr = tryTo<INTEGER_LITERAL>(expr);
     if (lexpr) {
-      return literal_matches<INTEGER_LITERAL>(lexpr.take());
+      return typedMatches(static_cast<long long>(lexpr.take()));
     }
   } else if (affinity == BIGINT_TYPE) {
     auto lexpr = tryTo<BIGINT_LITERAL>(expr);
     if (lexpr) {
-      return literal_matches<BIGINT_LITERAL>(lexpr.take());
+      return typedMatches(static_cast<long long>(lexpr.take()));
     }
   } else if (affinity == UNSIGNED_BIGINT_TYPE) {
     auto lexpr = tryTo<UNSIGNED_BIGINT_LITERAL>(expr);
     if (lexpr) {
-      return literal_matches<UNSIGNED_BIGINT_LITERAL>(lexpr.take());
+      return typedMatches(static_cast<unsigned long long>(lexpr.take()));
+    }
+  }
+
+  return false;
+}
+
+bool ConstraintList::matches(boost::string_view expr) const {
+  if (affinity == TEXT_TYPE) {
+    return typedMatches(expr);
+  }
+  return matches(expr.to_string());
+}
+
+bool ConstraintList::matches(long long expr) const {
+  if (affinity == TEXT_TYPE) {
+    return matches(std::to_string(expr));
+  } else if (affinity == INTEGER_TYPE) {
+    if (expr < std::numeric_limits<INTEGER_LITERAL>::min() ||
+        expr > std::numeric_limits<INTEGER_LITERAL>::max()) {
+      return false;
     }
+    return typedMatches(expr);
+  } else if (affinity == BIGINT_TYPE) {
+    return typedMatches(expr);
+  } else if (affinity == UNSIGNED_BIGINT_TYPE) {
+    // Negative values wrap, as they do when cast from text.
+    return typedMatches(static_cast<unsigned long long>(expr));
   }
 
   return false;
 }
 
 template <typename T>
-bool ConstraintList::literal_matches(const T& base_expr) const {
-  bool aggregate = true;
+bool ConstraintList::typedMatches(const T& expr) const {
+  // The TEXT representation of the expression, if a pattern needs it.
+  std::string text;
   for (size_t i = 0; i < constraints_.size(); ++i) {
-    auto constraint_expr = tryTo<T>(constraints_[i].expr);
-    if (!constraint_expr) {
-      // Cannot cast input constraint to column type.
-      return false;
+    const auto& constraint = constraints_[i];
+    const auto& literal = literals_[i];
+    if (isComparison(constraint.op)) {
+      T value;
+      if (!literalValue(constraint, literal, affinity, value)) {
+        // Cannot cast input constraint to column type.
+        return false;
+      }
+      if (!compareLiteral(constraint.op, expr, value)) {
+        return false;
+      }
+    } else if (literal.pattern != nullptr) {
+      if (!literal.pattern->matches(patternText(expr, text))) {
+        return false;
+      }
     }
-    if (constraints_[i].op == EQUALS) {
-      aggregate = aggregate && (base_expr == constraint_expr.take());
-    } else if (constraints_[i].op == GREATER_THAN) {
-      aggregate = aggregate && (base_expr > constraint_expr.take());
-    } else if (constraints_[i].op == LESS_THAN) {
-      aggregate = aggregate && (base_expr < constraint_expr.take());
-    } else if (constraints_[i].op == GREATER_THAN_OR_EQUALS) {
-      aggregate = aggregate && (base_expr >= constraint_expr.take());
-    } else if (constraints_[i].op == LESS_THAN_OR_EQUALS) {
-      aggregate = aggregate && (base_expr <= constraint_expr.take());
-    } else {
-      // Unsupported constraint. Should match every thing.
-      return true;
+    // Other constraints are unsupported and left to SQLite.
+  }
+  return true;
+}
+
+void ConstraintList::add(const struct Constraint& constraint) {
+  ConstraintLiteral literal;
+  if (constraint.op == LIKE || constraint.op == GLOB) {
+    literal.pattern =
+        ConstraintPattern::compile(constraint.op, constraint.expr);
+  } else if (mayBeInteger(constraint.expr)) {
+    auto integer = tryTo<long long>(constraint.expr);
+    if (integer) {
+      literal.integer = integer.take();
     }
-    if (!aggregate) {
-      // Speed up comparison.
-      return false;
+    auto unsigned_integer = tryTo<unsigned long long>(constraint.expr);
+    if (unsigned_integer) {
+      literal.unsigned_integer = unsigned_integer.take();
     }
   }
-  return true;
+
+  constraints_.push_back(constraint);
+  literals_.push_back(std::move(literal));
+}
+
+void ConstraintList::add(const struct Constraint& constraint,
+                         long long value) {
+  if (!isComparison(constraint.op)) {
+    add(constraint);
+    return;
+  }
+
+  ConstraintLiteral literal;
+  literal.integer = value;
+  literal.unsigned_integer = static_cast<unsigned long long>(value);
+  constraints_.push_back(constraint);
+  literals_.push_back(std::move(literal));
 }
 
 std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
@@ -430,12 +782,23 @@ std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
 }
 
 template <typename T>
-std::set<T> ConstraintList::getAll(ConstraintOperator /* op */) const {
+std::set<T> ConstraintList::getAll(ConstraintOperator op) const {
+  // Cast the literal using the affinity of the requested type.
+  auto type = std::is_unsigned<T>::value
+                  ? UNSIGNED_BIGINT_TYPE
+                  : (sizeof(T) < sizeof(long long) ? INTEGER_TYPE
+                                                   : BIGINT_TYPE);
   std::set<T> cs;
-  for (const auto& item : constraints_) {
-    auto exp = tryTo<T>(item.expr);
-    if (exp) {
-      cs.insert(exp.take());
+  for (size_t i = 0; i < constraints_.size(); ++i) {
+    if (constraints_[i].op != op) {
+      continue;
+    }
+
+    typename std::conditional<std::is_unsigned<T>::value,
+                              unsigned long long,
+                              long long>::type value;
+    if (literalValue(constraints_[i], literals_[i], type, value)) {
+      cs.insert(static_cast<T>(value));
     }
   }
   return cs;
@@ -481,7 +844,7 @@ void ConstraintList::deserialize(const rapidjson::Value& obj) {
     auto op = static_cast<unsigned char>(JSON::valueToSize(list["op"]));
     Constraint constraint(op);
     constraint.expr = list["expr"].GetString();
-    constraints_.push_back(constraint);
+    add(constraint);
   }
 
   auto affinity_name = (obj.HasMember("affinity") && obj["affinity"].IsString())
@@ -132,6 +132,58 @@ TEST_F(QueryTests, test_query_name_updated) {
   EXPECT_EQ(counter, 0UL);
 }
 
+TEST_F(QueryTests, test_add_differential) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("differential_query", query);
+
+  // A differential requires stored results.
+  DiffResults dr;
+  dr.added = {{{"username", "joe"}, {"age", "25"}}};
+  uint64_t counter = 128;
+  EXPECT_FALSE(cf.addDifferential(dr, 0, counter).ok());
+
+  auto results = getTestDBExpectedResults();
+  cf.addNewResults(results, 0, counter);
+  EXPECT_EQ(counter, 0UL);
+
+  // Results of another epoch are not changed.
+  EXPECT_FALSE(cf.addDifferential(dr, 1, counter).ok());
+
+  dr.removed = {{{"username", "mike"}, {"age", "23"}}};
+  auto status = cf.addDifferential(dr, 0, counter);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(counter, 1UL);
+
+  QueryDataSet stored;
+  cf.getPreviousQueryResults(stored);
+  QueryDataSet expected = {
+      {{"username", "joe"}, {"age", "25"}},
+      {{"username", "matt"}, {"age", "24"}},
+  };
+  EXPECT_EQ(expected, stored);
+
+  // Each removed row must be stored, otherwise nothing is changed.
+  status = cf.addDifferential(dr, 0, counter);
+  EXPECT_FALSE(status.ok());
+  stored.clear();
+  cf.getPreviousQueryResults(stored);
+  EXPECT_EQ(expected, stored);
+
+  // Without changes only the counter advances.
+  status = cf.addDifferential(DiffResults(), 0, counter);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(counter, 2UL);
+
+  // The stored results match a full set of results.
+  DiffResults full;
+  cf.addNewResults(QueryData(expected.begin(), expected.end()),
+                   0,
+                   counter,
+                   full);
+  EXPECT_TRUE(full.added.empty());
+  EXPECT_TRUE(full.removed.empty());
+}
+
 TEST_F(QueryTests, test_get_stored_query_names) {
   auto query = getOsqueryScheduledQuery();
   auto cf = Query("foobar", query);
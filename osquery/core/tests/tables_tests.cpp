@@ -10,10 +10,15 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/flags.h>
 #include <osquery/tables.h>
 
+#include "osquery/core/table_cache.h"
+
 namespace osquery {
 
+DECLARE_uint64(table_cache_size);
+
 class TablesTests : public testing::Test {};
 
 TEST_F(TablesTests, test_constraint) {
@@ -138,6 +143,82 @@ TEST_F(TablesTests, test_constraint_map_cast) {
   EXPECT_FALSE(cm["num"].existsAndMatches("hello"));
 }
 
+TEST_F(TablesTests, test_constraint_typed_matching) {
+  struct ConstraintList cl;
+  cl.affinity = BIGINT_TYPE;
+  cl.add(Constraint(GREATER_THAN, "4294967296"));
+  cl.add(Constraint(LESS_THAN_OR_EQUALS, "8589934592"), 8589934592LL);
+
+  // Integers, text, and views of text are compared as integers.
+  EXPECT_TRUE(cl.matches(8589934592LL));
+  EXPECT_TRUE(cl.matches(std::string("8589934592")));
+  EXPECT_TRUE(cl.matches(boost::string_view("8589934592")));
+  EXPECT_FALSE(cl.matches(4294967296LL));
+  EXPECT_FALSE(cl.matches(8589934593ULL));
+
+  // INTEGER affinity cannot represent larger values.
+  struct ConstraintList cl2;
+  cl2.affinity = INTEGER_TYPE;
+  cl2.add(Constraint(GREATER_THAN, "0"));
+  EXPECT_TRUE(cl2.matches(1));
+  EXPECT_FALSE(cl2.matches(4294967296LL));
+
+  struct ConstraintList cl3;
+  cl3.affinity = UNSIGNED_BIGINT_TYPE;
+  cl3.add(Constraint(GREATER_THAN, "9223372036854775807"));
+  EXPECT_TRUE(cl3.matches(18446744073709551615ULL));
+  EXPECT_FALSE(cl3.matches(1U));
+
+  // Only the operator requested is returned as a literal.
+  struct ConstraintList cl4;
+  cl4.add(Constraint(EQUALS, "1"));
+  cl4.add(Constraint(EQUALS, "2"), 2);
+  cl4.add(Constraint(GREATER_THAN, "3"));
+  cl4.add(Constraint(EQUALS, "none"));
+  EXPECT_EQ(cl4.getAll<int>(EQUALS), std::set<int>({1, 2}));
+  EXPECT_EQ(cl4.getAll<long long>(GREATER_THAN), std::set<long long>({3}));
+}
+
+TEST_F(TablesTests, test_constraint_pattern_matching) {
+  struct ConstraintList cl;
+  cl.add(Constraint(LIKE, "/usr/%/Lib_.%"));
+  EXPECT_TRUE(cl.matches("/usr/local/lib/libz.so"));
+  EXPECT_TRUE(cl.matches("/USR/local/LIBZ.so"));
+  EXPECT_FALSE(cl.matches("/usr/lib"));
+  EXPECT_FALSE(cl.matches("/opt/usr/lib/libz.so"));
+
+  // A single character may be multiple bytes.
+  EXPECT_TRUE(cl.matches("/usr/local/lib\xC3\xA9.so"));
+
+  struct ConstraintList cl2;
+  cl2.add(Constraint(GLOB, "*.[ch]??"));
+  EXPECT_TRUE(cl2.matches("file.cpp"));
+  EXPECT_TRUE(cl2.matches("file.hpp"));
+  EXPECT_FALSE(cl2.matches("file.CPP"));
+  EXPECT_FALSE(cl2.matches("file.cp"));
+
+  struct ConstraintList cl3;
+  cl3.add(Constraint(GLOB, "[^]a-c-]*"));
+  EXPECT_TRUE(cl3.matches("d"));
+  EXPECT_FALSE(cl3.matches("b"));
+  EXPECT_FALSE(cl3.matches("]"));
+  EXPECT_FALSE(cl3.matches("-"));
+
+  // Patterns apply to the TEXT representation of integers.
+  struct ConstraintList cl4;
+  cl4.affinity = INTEGER_TYPE;
+  cl4.add(Constraint(LIKE, "1%"));
+  EXPECT_TRUE(cl4.matches(10));
+  EXPECT_TRUE(cl4.matches("100"));
+  EXPECT_FALSE(cl4.matches(20));
+
+  // Patterns that are not compiled are left to SQLite.
+  struct ConstraintList cl5;
+  cl5.add(Constraint(GLOB, "[abc"));
+  cl5.add(Constraint(REGEXP, "^a"));
+  EXPECT_TRUE(cl5.matches("z"));
+}
+
 class TestTablePlugin : public TablePlugin {
  public:
   void testSetCache(size_t step, size_t interval) {
@@ -179,4 +260,103 @@ TEST_F(TablesTests, test_caching) {
   EXPECT_TRUE(test.testIsCached(6));
   EXPECT_FALSE(test.testIsCached(7));
 }
+
+class IndexedTablePlugin : public TablePlugin {
+ public:
+  IndexedTablePlugin() {
+    setName("indexed");
+  }
+
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("v", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  void setContext(QueryContext& ctx, const std::string& i) {
+    ctx.useCache(true);
+    if (!i.empty()) {
+      ctx.constraints["i"].add(Constraint(EQUALS, i));
+    }
+  }
+
+  void testSetCache(QueryContext& ctx, const std::string& v) {
+    setCache(1, 5, ctx, {{{"v", v}}});
+  }
+
+  std::string testGetCache(QueryContext& ctx) {
+    if (!isCached(2, ctx)) {
+      return "";
+    }
+
+    auto results = getCache();
+    return results.empty() ? "" : results[0]["v"];
+  }
+};
+
+TEST_F(TablesTests, test_table_cache) {
+  TableCache::get().clear();
+  IndexedTablePlugin test;
+
+  // Results are cached for each index constraint.
+  QueryContext all;
+  test.setContext(all, "");
+  QueryContext one;
+  test.setContext(one, "1");
+  QueryContext two;
+  test.setContext(two, "2");
+  test.testSetCache(all, "all");
+  test.testSetCache(one, "one");
+  EXPECT_EQ(test.testGetCache(all), "all");
+  EXPECT_EQ(test.testGetCache(one), "one");
+  EXPECT_EQ(test.testGetCache(two), "");
+
+  // Duplicate constraints are equivalent.
+  one.constraints["i"].add(Constraint(EQUALS, "1"));
+  EXPECT_EQ(test.testGetCache(one), "one");
+
+  // Results for fewer columns cannot be used by a scan of more columns.
+  two.colsUsed = UsedColumns({"i"});
+  test.testSetCache(two, "two");
+  EXPECT_EQ(test.testGetCache(two), "two");
+  two.colsUsed = UsedColumns({"i", "v"});
+  EXPECT_EQ(test.testGetCache(two), "");
+
+  auto metrics = TableCache::get().metrics("indexed");
+  EXPECT_EQ(metrics.hits, 4U);
+  EXPECT_EQ(metrics.misses, 2U);
+  EXPECT_EQ(metrics.evictions, 0U);
+  TableCache::get().clear();
+}
+
+TEST_F(TablesTests, test_table_cache_eviction) {
+  TableCache::get().clear();
+  auto cache_size = FLAGS_table_cache_size;
+  FLAGS_table_cache_size = 200;
+
+  // Each entry is estimated near 80 bytes, so two entries fit.
+  IndexedTablePlugin test;
+  QueryContext one;
+  test.setContext(one, "1");
+  QueryContext two;
+  test.setContext(two, "2");
+  QueryContext three;
+  test.setContext(three, "3");
+  test.testSetCache(one, "one");
+  test.testSetCache(two, "two");
+  EXPECT_LE(TableCache::get().bytes(), 200U);
+
+  // Use the first entry, the second is then the least recently used.
+  EXPECT_EQ(test.testGetCache(one), "one");
+  test.testSetCache(three, "three");
+  EXPECT_EQ(test.testGetCache(one), "one");
+  EXPECT_EQ(test.testGetCache(two), "");
+  EXPECT_EQ(test.testGetCache(three), "three");
+  EXPECT_EQ(TableCache::get().metrics("indexed").evictions, 1U);
+  EXPECT_LE(TableCache::get().bytes(), 200U);
+
+  FLAGS_table_cache_size = cache_size;
+  TableCache::get().clear();
+}
 }
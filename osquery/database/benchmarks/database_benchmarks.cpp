@@ -13,6 +13,7 @@
 #include <osquery/database.h>
 #include <osquery/filesystem.h>
 #include <osquery/query.h>
+#include <osquery/registry_factory.h>
 
 #include "osquery/core/json.h"
 #include "osquery/tests/test_util.h"
@@ -133,6 +134,21 @@ static void DATABASE_get(benchmark::State& state) {
 
 BENCHMARK(DATABASE_get);
 
+static void DATABASE_registry_lookup(benchmark::State& state) {
+  // The per-access plugin lookup that the cached database handle replaces.
+  auto& rf = RegistryFactory::get();
+  while (state.KeepRunning()) {
+    auto active = rf.getActive("database");
+    if (rf.exists("database", active, true)) {
+      auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+          rf.plugin("database", active));
+      benchmark::DoNotOptimize(plugin);
+    }
+  }
+}
+
+BENCHMARK(DATABASE_registry_lookup);
+
 static void DATABASE_store(benchmark::State& state) {
   while (state.KeepRunning()) {
     setDatabaseValue(kPersistentSettings, "benchmark", "1");
@@ -178,4 +194,103 @@ static void DATABASE_store_append(benchmark::State& state) {
 }
 
 BENCHMARK(DATABASE_store_append);
+
+static std::vector<std::string> putBenchmarkKeys(size_t count) {
+  DatabaseStringValueList data;
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; ++i) {
+    // Pad the index so the keys sort like event and log indexes.
+    auto index = std::to_string(i);
+    keys.push_back("benchmark." + std::string(10 - index.size(), '0') + index);
+    data.push_back(std::make_pair(keys.back(), "value" + index));
+  }
+  setDatabaseBatch(kLogs, data);
+  return keys;
+}
+
+static void deleteBenchmarkKeys(const std::vector<std::string>& keys) {
+  // All benchmarks will share a single database handle.
+  deleteDatabaseRange(kLogs, keys.front(), keys.back());
+}
+
+static void DATABASE_get_each(benchmark::State& state) {
+  auto keys = putBenchmarkKeys(state.range(0));
+  while (state.KeepRunning()) {
+    std::vector<std::string> values;
+    for (const auto& key : keys) {
+      std::string value;
+      getDatabaseValue(kLogs, key, value);
+      values.push_back(std::move(value));
+    }
+  }
+  deleteBenchmarkKeys(keys);
+}
+
+BENCHMARK(DATABASE_get_each)->Arg(10)->Arg(1000);
+
+static void DATABASE_multi_get(benchmark::State& state) {
+  auto keys = putBenchmarkKeys(state.range(0));
+  while (state.KeepRunning()) {
+    std::vector<std::string> values;
+    getDatabaseValues(kLogs, keys, values);
+  }
+  deleteBenchmarkKeys(keys);
+}
+
+BENCHMARK(DATABASE_multi_get)->Arg(10)->Arg(1000);
+
+static void DATABASE_scan_get(benchmark::State& state) {
+  auto keys = putBenchmarkKeys(state.range(0));
+  while (state.KeepRunning()) {
+    std::vector<std::string> scanned;
+    scanDatabaseKeys(kLogs, scanned, "benchmark.");
+    for (const auto& key : scanned) {
+      std::string value;
+      getDatabaseValue(kLogs, key, value);
+    }
+  }
+  deleteBenchmarkKeys(keys);
+}
+
+BENCHMARK(DATABASE_scan_get)->Arg(10)->Arg(1000);
+
+static void DATABASE_scan_values(benchmark::State& state) {
+  auto keys = putBenchmarkKeys(state.range(0));
+  DatabaseScanRange range;
+  range.prefix = "benchmark.";
+  while (state.KeepRunning()) {
+    DatabaseStringValueList results;
+    scanDatabaseValues(kLogs, range, results);
+  }
+  deleteBenchmarkKeys(keys);
+}
+
+BENCHMARK(DATABASE_scan_values)->Arg(10)->Arg(1000);
+
+static DatabaseStringValueList getExampleBatch(size_t count) {
+  std::string content;
+  serializeQueryDataJSON(getExampleQueryData(4, 1), content);
+
+  DatabaseStringValueList data;
+  for (size_t i = 0; i < count; ++i) {
+    data.push_back(std::make_pair("benchmark." + std::to_string(i), content));
+  }
+  return data;
+}
+
+static void DATABASE_put_batch_json(benchmark::State& state) {
+  // The extension path for batches.
+  auto data = getExampleBatch(state.range(0));
+  while (state.KeepRunning()) {
+    std::string serialized_data;
+    serializeDatabaseBatch(data, serialized_data);
+    PluginRequest request = {{"action", "putBatch"},
+                             {"domain", kLogs},
+                             {"json", std::move(serialized_data)}};
+    Registry::call("database", request);
+  }
+  deleteDatabaseRange(kLogs, data.front().first, data.back().first);
+}
+
+BENCHMARK(DATABASE_put_batch_json)->Arg(10)->Arg(1000);
 }
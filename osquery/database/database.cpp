@@ -8,6 +8,8 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
@@ -38,6 +40,12 @@ FLAG_ALIAS(std::string, db_path, database_path);
 
 FLAG(bool, disable_database, false, "Disable the persistent RocksDB storage");
 
+/// Extensions send multiGet and scanValues requests if the core sets this.
+HIDDEN_FLAG(bool,
+            database_batch_requests,
+            true,
+            "Accept batched database requests from extensions");
+
 const std::string kInternalDatabase = "rocksdb";
 const std::string kPersistentSettings = "configurations";
 const std::string kQueries = "queries";
@@ -66,6 +74,38 @@ std::atomic<bool> DatabasePlugin::kDBChecking(false);
  */
 Mutex kDatabaseReset;
 
+/**
+ * @brief The active database plugin, resolved once per registry epoch.
+ *
+ * Database APIs are called thousands of times a second by the event and
+ * logger paths. The plugin is looked up in the registry only when the
+ * registry changes or the database is reset, other calls read two atomics.
+ * The plugin is used while holding kDatabaseReset and owned by the registry,
+ * so a replaced plugin outlives its readers.
+ */
+struct DatabasePluginCache {
+  /// The registry epoch plus one, or 0 if the cache must be refreshed.
+  std::atomic<size_t> epoch{0};
+
+  std::atomic<DatabasePlugin*> plugin{nullptr};
+
+  /// Keeps the cached plugin alive until the cache is refreshed.
+  std::shared_ptr<DatabasePlugin> owner;
+
+  /// Serializes refreshes.
+  Mutex mutex;
+};
+
+static DatabasePluginCache kDatabasePluginCache;
+
+/// Drop the cached plugin, the caller must hold a write lock on kDatabaseReset.
+static void clearDatabasePluginCache() {
+  WriteLock lock(kDatabasePluginCache.mutex);
+  kDatabasePluginCache.epoch = 0;
+  kDatabasePluginCache.plugin = nullptr;
+  kDatabasePluginCache.owner = nullptr;
+}
+
 Status DatabasePlugin::initPlugin() {
   // Initialize the database plugin using the flag.
   auto plugin = (FLAGS_disable_database) ? "ephemeral" : kInternalDatabase;
@@ -80,6 +120,9 @@ Status DatabasePlugin::initPlugin() {
 }
 
 void DatabasePlugin::shutdown() {
+  WriteLock lock(kDatabaseReset);
+  clearDatabasePluginCache();
+
   auto datbase_registry = RegistryFactory::get().registry("database");
   for (auto& plugin : RegistryFactory::get().names("database")) {
     datbase_registry->remove(plugin);
@@ -117,6 +160,58 @@ Status DatabasePlugin::scan(const std::string& domain,
   return Status(0, "Not used");
 }
 
+Status DatabasePlugin::removeBatch(const std::string& domain,
+                                   const std::vector<std::string>& keys) {
+  for (const auto& key : keys) {
+    auto status = remove(domain, key);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::multiGet(const std::string& domain,
+                                const std::vector<std::string>& keys,
+                                std::vector<std::string>& values) const {
+  values.assign(keys.size(), "");
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::string value;
+    if (get(domain, keys[i], value).ok()) {
+      values[i] = std::move(value);
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status DatabasePlugin::scanValues(const std::string& domain,
+                                  const DatabaseScanRange& range,
+                                  const DatabaseScanVisitor& visitor) const {
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, range.prefix, 0);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::sort(keys.begin(), keys.end());
+  size_t count = 0;
+  for (const auto& key : keys) {
+    if ((!range.low.empty() && key < range.low) ||
+        (!range.high.empty() && key >= range.high)) {
+      continue;
+    }
+
+    std::string value;
+    if (!get(domain, key, value).ok()) {
+      continue;
+    }
+    if (!visitor(key, value) || (range.max > 0 && ++count >= range.max)) {
+      break;
+    }
+  }
+  return Status(0, "OK");
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
@@ -129,6 +224,7 @@ Status DatabasePlugin::call(const PluginRequest& request,
 
   if (request.at("action") == "reset") {
     WriteLock lock(kDatabaseReset);
+    clearDatabasePluginCache();
     DatabasePlugin::kDBInitialized = false;
     // Prevent RocksDB reentrancy by logger plugins during plugin setup.
     VLOG(1) << "Resetting the database plugin: " << getName();
@@ -161,33 +257,77 @@ Status DatabasePlugin::call(const PluginRequest& request,
           "Database plugin putBatch action requires a json-encoded value list");
     }
 
-    auto json_object = JSON::newObject();
-
-    auto status = json_object.fromString(request.at("json"));
+    DatabaseStringValueList data;
+    auto status = deserializeDatabaseBatch(request.at("json"), data);
     if (!status.ok()) {
       VLOG(1) << status.getMessage();
       return status;
     }
 
-    const auto& json_object_list = json_object.doc().GetObject();
+    return this->putBatch(domain, data);
+  } else if (request.at("action") == "multiGet") {
+    if (!FLAGS_database_batch_requests) {
+      return Status(1, "Database plugin batch requests are disabled");
+    }
 
-    DatabaseStringValueList data;
-    data.reserve(json_object_list.MemberCount());
+    if (request.count("json") == 0) {
+      return Status(
+          1, "Database plugin multiGet action requires a json-encoded list");
+    }
 
-    for (auto& item : json_object_list) {
-      if (!item.value.IsString()) {
-        return Status(1,
-                      "Database plugin putBatch action with an invalid json "
-                      "received. Only string values are supported");
-      }
+    auto json_keys = JSON::newArray();
+    auto status = json_keys.fromString(request.at("json"));
+    if (!status.ok() || !json_keys.doc().IsArray()) {
+      return Status(1, "Database plugin multiGet action with an invalid json");
+    }
 
-      data.push_back(
-          std::make_pair(item.name.GetString(), item.value.GetString()));
+    std::vector<std::string> keys;
+    for (const auto& item : json_keys.doc().GetArray()) {
+      if (!item.IsString()) {
+        return Status(1, "Database plugin multiGet keys must be strings");
+      }
+      keys.emplace_back(item.GetString(), item.GetStringLength());
     }
 
-    return this->putBatch(domain, data);
+    std::vector<std::string> values;
+    status = this->multiGet(domain, keys, values);
+
+    // The values are returned in a single row as a JSON array.
+    auto json_values = JSON::newArray();
+    for (const auto& value : values) {
+      json_values.pushCopy(value);
+    }
+    std::string serialized_values;
+    json_values.toString(serialized_values);
+    response.push_back({{"json", std::move(serialized_values)}});
+    return status;
   } else if (request.at("action") == "remove") {
     return this->remove(domain, key);
+  } else if (request.at("action") == "removeBatch") {
+    if (!FLAGS_database_batch_requests) {
+      return Status(1, "Database plugin batch requests are disabled");
+    }
+
+    if (request.count("json") == 0) {
+      return Status(
+          1, "Database plugin removeBatch action requires a json-encoded list");
+    }
+
+    auto json_keys = JSON::newArray();
+    auto status = json_keys.fromString(request.at("json"));
+    if (!status.ok() || !json_keys.doc().IsArray()) {
+      return Status(1,
+                    "Database plugin removeBatch action with an invalid json");
+    }
+
+    std::vector<std::string> keys;
+    for (const auto& item : json_keys.doc().GetArray()) {
+      if (!item.IsString()) {
+        return Status(1, "Database plugin removeBatch keys must be strings");
+      }
+      keys.emplace_back(item.GetString(), item.GetStringLength());
+    }
+    return this->removeBatch(domain, keys);
   } else if (request.at("action") == "remove_range") {
     auto key_high = (request.count("high") > 0) ? request.at("key_high") : "";
     if (!key_high.empty() && !key.empty()) {
@@ -200,41 +340,124 @@ Status DatabasePlugin::call(const PluginRequest& request,
     // Optionally allow the caller to request a max number of keys.
     size_t max = 0;
     if (request.count("max") > 0) {
-      max = std::stoul(request.at("max"));
+      auto requested_max = tryTo<unsigned long>(request.at("max"));
+      if (!requested_max) {
+        return Status(1, "Database plugin scan action with an invalid max");
+      }
+      max = requested_max.take();
     }
-    auto status = this->scan(domain, keys, request.at("prefix"), max);
+    auto prefix = (request.count("prefix") > 0) ? request.at("prefix") : "";
+    auto status = this->scan(domain, keys, prefix, max);
     for (const auto& k : keys) {
       response.push_back({{"k", k}});
     }
     return status;
+  } else if (request.at("action") == "scanValues") {
+    if (!FLAGS_database_batch_requests) {
+      return Status(1, "Database plugin batch requests are disabled");
+    }
+
+    DatabaseScanRange range;
+    range.prefix = (request.count("prefix") > 0) ? request.at("prefix") : "";
+    range.low = key;
+    range.high = (request.count("key_high") > 0) ? request.at("key_high") : "";
+    if (request.count("max") > 0) {
+      auto requested_max = tryTo<unsigned long>(request.at("max"));
+      if (!requested_max) {
+        return Status(
+            1, "Database plugin scanValues action with an invalid max");
+      }
+      range.max = requested_max.take();
+    }
+    DatabaseStringValueList data;
+    auto status = this->scanValues(
+        domain,
+        range,
+        ([&data](const std::string& k, const std::string& v) {
+          data.emplace_back(k, v);
+          return true;
+        }));
+
+    // The pairs are returned in a single row as a JSON object.
+    std::string serialized_data;
+    serializeDatabaseBatch(data, serialized_data);
+    response.push_back({{"json", std::move(serialized_data)}});
+    return status;
   }
 
   return Status(1, "Unknown database plugin action");
 }
 
-static inline std::shared_ptr<DatabasePlugin> getDatabasePlugin() {
+Status serializeDatabaseBatch(const DatabaseStringValueList& data,
+                              std::string& json) {
+  auto json_object = JSON::newObject();
+  auto& doc = json_object.doc();
+  for (const auto& p : data) {
+    // Add references without a member lookup, later duplicates replace
+    // earlier values when the batch is put.
+    doc.AddMember(rj::StringRef(p.first.data(), p.first.size()),
+                  rj::StringRef(p.second.data(), p.second.size()),
+                  doc.GetAllocator());
+  }
+  return json_object.toString(json);
+}
+
+Status deserializeDatabaseBatch(const std::string& json,
+                                DatabaseStringValueList& data) {
+  auto json_object = JSON::newObject();
+  auto status = json_object.fromString(json);
+  if (!status.ok()) {
+    return status;
+  }
+  if (!json_object.doc().IsObject()) {
+    return Status(1, "Database batch is not a json object");
+  }
+
+  const auto& json_object_list = json_object.doc().GetObject();
+  data.reserve(data.size() + json_object_list.MemberCount());
+  for (const auto& item : json_object_list) {
+    if (!item.value.IsString()) {
+      return Status(1,
+                    "Database batch with an invalid json received. Only "
+                    "string values are supported");
+    }
+
+    data.emplace_back(
+        std::string(item.name.GetString(), item.name.GetStringLength()),
+        std::string(item.value.GetString(), item.value.GetStringLength()));
+  }
+  return Status(0, "OK");
+}
+
+static DatabasePlugin* getDatabasePlugin() {
+  static const auto registry = RegistryFactory::get().registry("database");
+
+  auto& cache = kDatabasePluginCache;
+  auto epoch = registry->getEpoch() + 1;
+  if (cache.epoch.load(std::memory_order_acquire) == epoch) {
+    return cache.plugin.load(std::memory_order_relaxed);
+  }
+
+  WriteLock lock(cache.mutex);
   auto& rf = RegistryFactory::get();
-  if (!rf.exists("database", rf.getActive("database"), true)) {
-    return nullptr;
+  auto active = rf.getActive("database");
+  std::shared_ptr<DatabasePlugin> plugin;
+  if (rf.exists("database", active, true)) {
+    plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+        rf.plugin("database", active));
   }
 
-  auto plugin = rf.plugin("database", rf.getActive("database"));
-  return std::dynamic_pointer_cast<DatabasePlugin>(plugin);
+  cache.owner = plugin;
+  cache.plugin.store(plugin.get(), std::memory_order_relaxed);
+  cache.epoch.store(epoch, std::memory_order_release);
+  return plugin.get();
 }
 
 namespace {
 Status sendPutBatchDatabaseRequest(const std::string& domain,
                                    const DatabaseStringValueList& data) {
-  auto json_object = JSON::newObject();
-  for (const auto& p : data) {
-    const auto& key = p.first;
-    const auto& value = p.second;
-
-    json_object.addRef(key, value);
-  }
-
   std::string serialized_data;
-  auto status = json_object.toString(serialized_data);
+  auto status = serializeDatabaseBatch(data, serialized_data);
   if (!status.ok()) {
     VLOG(1) << status.getMessage();
     return status;
@@ -371,6 +594,52 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   }
 }
 
+Status deleteDatabaseValues(const std::string& domain,
+                            const std::vector<std::string>& keys) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    if (!FLAGS_database_batch_requests) {
+      // The core does not accept batched requests, remove each key.
+      for (const auto& key : keys) {
+        auto status = deleteDatabaseValue(domain, key);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+      return Status(0, "OK");
+    }
+
+    auto json_keys = JSON::newArray();
+    for (const auto& key : keys) {
+      json_keys.pushCopy(key);
+    }
+
+    std::string serialized_keys;
+    auto status = json_keys.toString(serialized_keys);
+    if (!status.ok()) {
+      return status;
+    }
+
+    PluginRequest request = {{"action", "removeBatch"},
+                             {"domain", domain},
+                             {"json", std::move(serialized_keys)}};
+    return Registry::call("database", request);
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!DatabasePlugin::kDBInitialized) {
+    throw std::runtime_error("Cannot delete database values");
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->removeBatch(domain, keys);
+  }
+}
+
 Status deleteDatabaseRange(const std::string& domain,
                            const std::string& low,
                            const std::string& high) {
@@ -440,6 +709,142 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status getDatabaseValues(const std::string& domain,
+                         const std::vector<std::string>& keys,
+                         std::vector<std::string>& values) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    values.assign(keys.size(), "");
+    if (!FLAGS_database_batch_requests) {
+      // The core does not accept batched requests, get each value.
+      for (size_t i = 0; i < keys.size(); ++i) {
+        auto status = getDatabaseValue(domain, keys[i], values[i]);
+        if (!status.ok()) {
+          return status;
+        }
+      }
+      return Status(0, "OK");
+    }
+
+    auto json_keys = JSON::newArray();
+    for (const auto& key : keys) {
+      json_keys.pushCopy(key);
+    }
+
+    std::string serialized_keys;
+    auto status = json_keys.toString(serialized_keys);
+    if (!status.ok()) {
+      return status;
+    }
+
+    PluginRequest request = {{"action", "multiGet"},
+                             {"domain", domain},
+                             {"json", std::move(serialized_keys)}};
+    PluginResponse response;
+    status = Registry::call("database", request, response);
+    if (!status.ok() || response.empty() || response[0].count("json") == 0) {
+      return status;
+    }
+
+    auto json_values = JSON::newArray();
+    status = json_values.fromString(response[0].at("json"));
+    if (!status.ok() || !json_values.doc().IsArray()) {
+      return Status(1, "Database multiGet response with an invalid json");
+    }
+
+    const auto& json_values_list = json_values.doc().GetArray();
+    for (size_t i = 0; i < json_values_list.Size() && i < keys.size(); ++i) {
+      const auto& value = json_values_list[i];
+      if (value.IsString()) {
+        values[i].assign(value.GetString(), value.GetStringLength());
+      }
+    }
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!DatabasePlugin::kDBInitialized) {
+    throw std::runtime_error("Cannot get database values");
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->multiGet(domain, keys, values);
+  }
+}
+
+Status scanDatabaseValues(const std::string& domain,
+                          const DatabaseScanRange& range,
+                          DatabaseStringValueList& results) {
+  if (domain.empty()) {
+    return Status(1, "Missing domain");
+  }
+
+  if (RegistryFactory::get().external() && !FLAGS_database_batch_requests) {
+    // The core does not accept batched requests, scan the keys in the range
+    // and get each value.
+    std::vector<std::string> keys;
+    auto status = scanDatabaseKeys(domain, keys, range.prefix, 0);
+    if (!status.ok()) {
+      return status;
+    }
+
+    std::sort(keys.begin(), keys.end());
+    size_t count = 0;
+    for (const auto& key : keys) {
+      if ((!range.low.empty() && key < range.low) ||
+          (!range.high.empty() && key >= range.high)) {
+        continue;
+      }
+
+      std::string value;
+      if (!getDatabaseValue(domain, key, value).ok()) {
+        continue;
+      }
+      results.emplace_back(key, std::move(value));
+      if (range.max > 0 && ++count >= range.max) {
+        break;
+      }
+    }
+    return Status(0, "OK");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // External registries (extensions) do not have databases active.
+    // It is not possible to use an extension-based database.
+    PluginRequest request = {{"action", "scanValues"},
+                             {"domain", domain},
+                             {"prefix", range.prefix},
+                             {"key", range.low},
+                             {"key_high", range.high},
+                             {"max", std::to_string(range.max)}};
+    PluginResponse response;
+    auto status = Registry::call("database", request, response);
+
+    if (status.ok() && response.size() > 0 && response[0].count("json") > 0) {
+      status = deserializeDatabaseBatch(response[0].at("json"), results);
+    }
+    return status;
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!DatabasePlugin::kDBInitialized) {
+    throw std::runtime_error("Cannot scan database values: " + range.prefix);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanValues(
+        domain,
+        range,
+        ([&results](const std::string& key, const std::string& value) {
+          results.emplace_back(key, value);
+          return true;
+        }));
+  }
+}
+
 void resetDatabase() {
   PluginRequest request = {{"action", "reset"}};
   Registry::call("database", request);
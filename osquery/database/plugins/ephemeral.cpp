@@ -8,6 +8,7 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <iostream>
 
 #include "osquery/database/plugins/ephemeral.h"
@@ -142,4 +143,62 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
   }
   return Status(0);
 }
+
+/// Convert a stored value to its string representation.
+class StringVisitor : public boost::static_visitor<std::string> {
+ public:
+  std::string operator()(int value) const {
+    return std::to_string(value);
+  }
+
+  std::string operator()(const std::string& value) const {
+    return value;
+  }
+};
+
+Status EphemeralDatabasePlugin::multiGet(
+    const std::string& domain,
+    const std::vector<std::string>& keys,
+    std::vector<std::string>& values) const {
+  values.assign(keys.size(), "");
+  auto domainIterator = db_.find(domain);
+  if (domainIterator == db_.end()) {
+    return Status(0);
+  }
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto keyIterator = domainIterator->second.find(keys[i]);
+    if (keyIterator != domainIterator->second.end()) {
+      values[i] = boost::apply_visitor(StringVisitor(), keyIterator->second);
+    }
+  }
+  return Status(0);
+}
+
+Status EphemeralDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanRange& range,
+    const DatabaseScanVisitor& visitor) const {
+  auto domainIterator = db_.find(domain);
+  if (domainIterator == db_.end()) {
+    return Status(0);
+  }
+
+  const auto& keys = domainIterator->second;
+  size_t count = 0;
+  for (auto it = keys.lower_bound(std::max(range.prefix, range.low));
+       it != keys.end();
+       ++it) {
+    const auto& key = it->first;
+    if (key.compare(0, range.prefix.size(), range.prefix) != 0 ||
+        (!range.high.empty() && key >= range.high)) {
+      break;
+    }
+    auto value = boost::apply_visitor(StringVisitor(), it->second);
+    if (!visitor(key, value) || (range.max > 0 && ++count >= range.max)) {
+      break;
+    }
+  }
+  return Status(0);
+}
 } // namespace osquery
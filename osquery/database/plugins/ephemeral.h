@@ -69,6 +69,16 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               size_t max) const override;
 
+  /// Batched key lookup method.
+  Status multiGet(const std::string& domain,
+                  const std::vector<std::string>& keys,
+                  std::vector<std::string>& values) const override;
+
+  /// Ordered key/value range method.
+  Status scanValues(const std::string& domain,
+                    const DatabaseScanRange& range,
+                    const DatabaseScanVisitor& visitor) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
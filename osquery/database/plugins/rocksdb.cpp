@@ -8,11 +8,18 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <sys/stat.h>
 
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/table.h>
 
 #include <osquery/filesystem.h>
 #include <osquery/logger.h>
@@ -24,6 +31,12 @@
 
 namespace fs = boost::filesystem;
 
+namespace rocksdb {
+/// The compression types linked into RocksDB, from options_helper.h, which
+/// RocksDB does not install with its public headers.
+std::vector<CompressionType> GetSupportedCompressions();
+} // namespace rocksdb
+
 namespace osquery {
 
 /// Hidden flags created for internal stress testing.
@@ -34,6 +47,65 @@ DECLARE_uint64(rocksdb_buffer_blocks);
 
 DECLARE_string(database_path);
 
+HIDDEN_FLAG(uint64,
+            rocksdb_memory_limit,
+            32,
+            "Megabytes shared by the RocksDB block cache and write buffers");
+
+/// Bloom filter bits per key for the events domain.
+const int kEventsBloomBits = 10;
+
+/// Block size for the large query result values.
+const size_t kQueriesBlockSize = 16 * 1024;
+
+/// Compression for the large query result values, if RocksDB supports it.
+const rocksdb::CompressionType kQueriesCompression = rocksdb::kZSTD;
+
+/// Check if a compression library is linked into RocksDB.
+static bool isCompressionSupported(rocksdb::CompressionType type) {
+  auto supported = rocksdb::GetSupportedCompressions();
+  return std::find(supported.begin(), supported.end(), type) !=
+         supported.end();
+}
+
+/**
+ * @brief Group event keys by their subscriber.
+ *
+ * Event keys are formatted as type.namespace.id, such as
+ * data.auditeventpublisher.process_events.0000000042 or
+ * records.auditeventpublisher.process_events.60.25000000. The prefix is
+ * everything up to and including the last '.', which keeps the records,
+ * data, and indexes of a subscriber together in the prefix bloom filters.
+ */
+class EventKeyPrefix : public rocksdb::SliceTransform {
+ public:
+  const char* Name() const override {
+    return "osquery.EventKeyPrefix";
+  }
+
+  rocksdb::Slice Transform(const rocksdb::Slice& key) const override {
+    return rocksdb::Slice(key.data(), lastSeparator(key) + 1);
+  }
+
+  bool InDomain(const rocksdb::Slice& key) const override {
+    return lastSeparator(key) < key.size();
+  }
+
+  bool InRange(const rocksdb::Slice& /* dst */) const override {
+    return false;
+  }
+
+ private:
+  static size_t lastSeparator(const rocksdb::Slice& key) {
+    for (size_t i = key.size(); i > 0; --i) {
+      if (key[i - 1] == '.') {
+        return i - 1;
+      }
+    }
+    return key.size();
+  }
+};
+
 /**
  * @brief Track external systems marking the RocksDB database as corrupted.
  *
@@ -95,7 +167,7 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.max_manifest_file_size = 1024 * 500;
 
     // Performance and optimization settings.
-    // Use rocksdb::kZSTD to use ZSTD database compression
+    // Query results enable compression in their domain options.
     options_.compression = rocksdb::kNoCompression;
     options_.compaction_style = rocksdb::kCompactionStyleLevel;
     options_.arena_block_size = (4 * 1024);
@@ -107,19 +179,25 @@ Status RocksDBDatabasePlugin::setUp() {
     options_.max_background_flushes =
         static_cast<int>(FLAGS_rocksdb_background_flushes);
 
+    // Split the memory limit between the block cache and the write buffers
+    // of all column families. Reaching the write buffer limit flushes the
+    // largest memtable.
+    auto memory_limit = FLAGS_rocksdb_memory_limit * 1024 * 1024;
+    block_cache_ = rocksdb::NewLRUCache(memory_limit / 2);
+    options_.db_write_buffer_size = memory_limit / 2;
+
     // Create an environment to replace the default logger.
     if (logger_ == nullptr) {
       logger_ = std::make_shared<GlogRocksDBLogger>();
     }
     options_.info_log = logger_;
 
-    column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
-        rocksdb::kDefaultColumnFamilyName, options_));
-
-    for (const auto& cf_name : kDomains) {
-      column_families_.push_back(
-          rocksdb::ColumnFamilyDescriptor(cf_name, options_));
+    // Without the compression library the column families cannot open.
+    auto compress = isCompressionSupported(kQueriesCompression);
+    if (!compress) {
+      VLOG(1) << "RocksDB compression is not supported";
     }
+    setColumnFamilies(compress);
   }
 
   // Consume the current settings.
@@ -170,6 +248,58 @@ Status RocksDBDatabasePlugin::setUp() {
   return Status(0);
 }
 
+rocksdb::ColumnFamilyOptions RocksDBDatabasePlugin::getDomainOptions(
+    const std::string& domain, bool compress) const {
+  rocksdb::ColumnFamilyOptions options(options_);
+
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.block_cache = block_cache_;
+  // Charge index and filter blocks to the shared cache to keep the limit.
+  table_options.cache_index_and_filter_blocks = true;
+  table_options.pin_l0_filter_and_index_blocks_in_cache = true;
+
+  if (domain == kEvents) {
+    // Events are appended in time order, then read and expired by key.
+    // Bloom filters skip tables for the many keys that were never added,
+    // such as empty record bins and expired event IDs.
+    options.prefix_extractor = std::make_shared<EventKeyPrefix>();
+    options.memtable_prefix_bloom_size_ratio = 0.02;
+    table_options.filter_policy.reset(
+        rocksdb::NewBloomFilterPolicy(kEventsBloomBits, false));
+  } else if (domain == kLogs) {
+    // Buffered logs are a queue: written once, read in order, and removed.
+    // Flush small memtables and compact early so the removed lines do not
+    // linger as tombstones scanned by every read.
+    options.max_write_buffer_number = 2;
+    options.min_write_buffer_number_to_merge = 1;
+    options.level0_file_num_compaction_trigger = 2;
+  } else if (domain == kQueries) {
+    // Query results are large values that are read and replaced whole.
+    table_options.block_size = kQueriesBlockSize;
+    if (compress) {
+      options.compression = kQueriesCompression;
+    }
+  }
+
+  options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+  return options;
+}
+
+void RocksDBDatabasePlugin::setColumnFamilies(bool compress) {
+  std::vector<std::string> names = {rocksdb::kDefaultColumnFamilyName};
+  names.insert(names.end(), kDomains.begin(), kDomains.end());
+
+  // Domains are stored in the handle at their kDomains index, which is the
+  // column family opened at that position, so tune by position not by name.
+  column_families_.clear();
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::string domain = (i < kDomains.size()) ? kDomains[i] : "";
+    column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
+        names[i], getDomainOptions(domain, compress)));
+  }
+}
+
 void RocksDBDatabasePlugin::tearDown() {
   close();
 }
@@ -367,6 +497,31 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
   return Status(s.code(), s.ToString());
 }
 
+Status RocksDBDatabasePlugin::removeBatch(
+    const std::string& domain, const std::vector<std::string>& keys) {
+  if (read_only_) {
+    return Status(0, "Database in readonly mode");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+  auto options = rocksdb::WriteOptions();
+
+  // A single write syncs once for the whole batch of keys.
+  if (kEvents != domain) {
+    options.sync = true;
+  }
+
+  rocksdb::WriteBatch batch;
+  for (const auto& key : keys) {
+    batch.Delete(cfh, key);
+  }
+  auto s = getDB()->Write(options, &batch);
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    std::vector<std::string>& results,
                                    const std::string& prefix,
@@ -400,4 +555,75 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
   delete it;
   return Status(0, "OK");
 }
+
+Status RocksDBDatabasePlugin::multiGet(const std::string& domain,
+                                       const std::vector<std::string>& keys,
+                                       std::vector<std::string>& values) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+  std::vector<rocksdb::ColumnFamilyHandle*> handles(keys.size(), cfh);
+  auto statuses = getDB()->MultiGet(
+      rocksdb::ReadOptions(), handles, key_slices, &values);
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    if (statuses[i].IsNotFound()) {
+      values[i].clear();
+    } else if (!statuses[i].ok()) {
+      return Status(statuses[i].code(), statuses[i].ToString());
+    }
+  }
+  return Status(0, "OK");
+}
+
+Status RocksDBDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanRange& range,
+    const DatabaseScanVisitor& visitor) const {
+  if (getDB() == nullptr) {
+    return Status(1, "Database not opened");
+  }
+
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  auto options = rocksdb::ReadOptions();
+  options.verify_checksums = false;
+  options.fill_cache = false;
+  // Ranges may cross the prefixes of a domain's prefix extractor.
+  options.total_order_seek = true;
+  rocksdb::Slice upper_bound(range.high);
+  if (!range.high.empty()) {
+    options.iterate_upper_bound = &upper_bound;
+  }
+
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
+  if (it == nullptr) {
+    return Status(1, "Could not get iterator for " + domain);
+  }
+
+  size_t count = 0;
+  it->Seek(std::max(range.prefix, range.low));
+  for (; it->Valid(); it->Next()) {
+    auto key = it->key();
+    if (!key.starts_with(range.prefix)) {
+      break;
+    }
+    if (!visitor(key.ToString(), it->value().ToString()) ||
+        (range.max > 0 && ++count >= range.max)) {
+      break;
+    }
+  }
+
+  auto s = it->status();
+  return Status(s.code(), s.ToString());
+}
 } // namespace osquery
@@ -10,6 +10,7 @@
 
 #include <atomic>
 
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
 
 #include <osquery/core.h>
@@ -66,12 +67,26 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
                      const std::string& low,
                      const std::string& high) override;
 
+  /// Batched data removal method.
+  Status removeBatch(const std::string& domain,
+                     const std::vector<std::string>& keys) override;
+
   /// Key/index lookup method.
   Status scan(const std::string& domain,
               std::vector<std::string>& results,
               const std::string& prefix,
               size_t max) const override;
 
+  /// Batched key lookup method.
+  Status multiGet(const std::string& domain,
+                  const std::vector<std::string>& keys,
+                  std::vector<std::string>& values) const override;
+
+  /// Ordered key/value range method.
+  Status scanValues(const std::string& domain,
+                    const DatabaseScanRange& range,
+                    const DatabaseScanVisitor& visitor) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -103,6 +118,22 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
    */
   rocksdb::DB* getDB() const;
 
+  /**
+   * @brief Build the column family options for a domain.
+   *
+   * Each domain is tuned for its workload: events are appended in time order
+   * and read by key, logs are a queue, and query results are large values
+   * that are read and replaced whole.
+   *
+   * @param domain the column family name.
+   * @param compress allow compressing the query results.
+   */
+  rocksdb::ColumnFamilyOptions getDomainOptions(const std::string& domain,
+                                                bool compress) const;
+
+  /// Create the column family descriptors from the domain options.
+  void setColumnFamilies(bool compress);
+
   /**
    * @brief Helper method to repair a corrupted db. Best effort only.
    *
@@ -143,11 +174,15 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
+  /// Block cache shared by every column family.
+  std::shared_ptr<rocksdb::Cache> block_cache_{nullptr};
+
   /// Deconstruction mutex.
   Mutex close_mutex_;
 
  private:
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_domain_options);
 };
 } // namespace osquery
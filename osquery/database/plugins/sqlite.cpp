@@ -8,7 +8,9 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <sstream>
+#include <unordered_map>
 
 #include <sqlite3.h>
 #include <sys/stat.h>
@@ -22,6 +24,9 @@
 
 namespace osquery {
 
+/// Bound parameters per multiGet statement, below SQLITE_MAX_VARIABLE_NUMBER.
+const size_t kMultiGetBatchSize = 500;
+
 const std::map<std::string, std::string> kDBSettings = {
     {"synchronous", "OFF"},
     {"count_changes", "OFF"},
@@ -313,4 +318,99 @@ Status SQLiteDatabasePlugin::scan(const std::string& domain,
 
   return Status(0, "OK");
 }
+
+static std::string columnText(sqlite3_stmt* stmt, int column) {
+  auto text = sqlite3_column_text(stmt, column);
+  if (text == nullptr) {
+    return "";
+  }
+  return std::string(reinterpret_cast<const char*>(text),
+                     sqlite3_column_bytes(stmt, column));
+}
+
+Status SQLiteDatabasePlugin::multiGet(const std::string& domain,
+                                      const std::vector<std::string>& keys,
+                                      std::vector<std::string>& values) const {
+  values.assign(keys.size(), "");
+  for (size_t first = 0; first < keys.size(); first += kMultiGetBatchSize) {
+    auto last = std::min(first + kMultiGetBatchSize, keys.size());
+
+    std::stringstream buffer;
+    buffer << "select key, value from " << domain << " where key in (";
+    for (size_t i = first; i < last; i++) {
+      buffer << ((i == first) ? "?" : ", ?") << (i - first + 1);
+    }
+    buffer << ");";
+
+    sqlite3_stmt* stmt = nullptr;
+    auto q = buffer.str();
+    if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return Status(1, "Cannot prepare lookup in domain: " + domain);
+    }
+
+    // A key may be requested more than once.
+    std::unordered_map<std::string, std::vector<size_t>> positions;
+    for (size_t i = first; i < last; i++) {
+      sqlite3_bind_text(stmt,
+                        static_cast<int>(i - first + 1),
+                        keys[i].c_str(),
+                        static_cast<int>(keys[i].size()),
+                        SQLITE_STATIC);
+      positions[keys[i]].push_back(i);
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      auto position = positions.find(columnText(stmt, 0));
+      if (position == positions.end()) {
+        continue;
+      }
+      auto value = columnText(stmt, 1);
+      for (auto i : position->second) {
+        values[i] = value;
+      }
+    }
+    sqlite3_finalize(stmt);
+  }
+  return Status(0, "OK");
+}
+
+Status SQLiteDatabasePlugin::scanValues(
+    const std::string& domain,
+    const DatabaseScanRange& range,
+    const DatabaseScanVisitor& visitor) const {
+  // The key index is ordered by binary collation, like the RocksDB keys.
+  std::string q = "select key, value from " + domain + " where key >= ?1";
+  if (!range.high.empty()) {
+    q += " and key < ?2";
+  }
+  q += " order by key";
+  if (range.max > 0) {
+    q += " limit " + std::to_string(range.max);
+  }
+
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return Status(1, "Cannot prepare scan in domain: " + domain);
+  }
+
+  auto low = std::max(range.prefix, range.low);
+  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
+  if (!range.high.empty()) {
+    sqlite3_bind_text(stmt, 2, range.high.c_str(), -1, SQLITE_STATIC);
+  }
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    auto key = columnText(stmt, 0);
+    if (key.compare(0, range.prefix.size(), range.prefix) != 0) {
+      break;
+    }
+    if (!visitor(key, columnText(stmt, 1))) {
+      break;
+    }
+  }
+  sqlite3_finalize(stmt);
+  return Status(0, "OK");
+}
 } // namespace osquery
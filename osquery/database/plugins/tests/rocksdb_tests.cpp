@@ -55,4 +55,27 @@ TEST_F(RocksDBDatabasePluginTests, test_corruption) {
   resetDatabase();
   EXPECT_FALSE(pathExists(path_ + ".backup"));
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_domain_options) {
+  RocksDBDatabasePlugin plugin;
+
+  auto events = plugin.getDomainOptions(kEvents, true);
+  ASSERT_NE(events.prefix_extractor, nullptr);
+  const auto& prefix = *events.prefix_extractor;
+  EXPECT_EQ(prefix.Transform("data.publisher.subscriber.0000000042").ToString(),
+            "data.publisher.subscriber.");
+  EXPECT_EQ(prefix.Transform("records.publisher.subscriber.60.25").ToString(),
+            "records.publisher.subscriber.60.");
+  EXPECT_FALSE(prefix.InDomain("eid"));
+  EXPECT_EQ(events.compression, rocksdb::kNoCompression);
+
+  auto logs = plugin.getDomainOptions(kLogs, true);
+  EXPECT_EQ(logs.prefix_extractor, nullptr);
+  EXPECT_EQ(logs.max_write_buffer_number, 2);
+
+  EXPECT_EQ(plugin.getDomainOptions(kQueries, true).compression,
+            rocksdb::kZSTD);
+  EXPECT_EQ(plugin.getDomainOptions(kQueries, false).compression,
+            rocksdb::kNoCompression);
+}
 }
@@ -11,6 +11,7 @@
 #include <gtest/gtest.h>
 
 #include <osquery/database.h>
+#include <osquery/registry_factory.h>
 
 #include "osquery/core/json.h"
 #include "osquery/tests/test_util.h"
@@ -155,6 +156,44 @@ TEST_F(DatabaseTests, test_scan_values) {
   EXPECT_EQ(keys.size(), 3U);
 }
 
+TEST_F(DatabaseTests, test_batch_encoding) {
+  DatabaseStringValueList batch = {
+      {"key", "value"}, {"", ""}, {std::string("a\0b", 3), "\"quoted\"\n"}};
+  std::string encoded;
+  auto s = serializeDatabaseBatch(batch, encoded);
+  EXPECT_TRUE(s.ok());
+
+  DatabaseStringValueList decoded;
+  s = deserializeDatabaseBatch(encoded, decoded);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(decoded, batch);
+
+  // A truncated batch is rejected.
+  decoded.clear();
+  encoded.pop_back();
+  s = deserializeDatabaseBatch(encoded, decoded);
+  EXPECT_FALSE(s.ok());
+}
+
+TEST_F(DatabaseTests, test_active_plugin_change) {
+  auto& rf = RegistryFactory::get();
+  auto existing = rf.getActive("database");
+
+  // Changing the active plugin must not use the previous plugin.
+  setDatabaseValue(kLogs, "active", existing);
+  ASSERT_TRUE(rf.setActive("database", "ephemeral"));
+  std::string value;
+  getDatabaseValue(kLogs, "active", value);
+  EXPECT_TRUE(value.empty() || existing == "ephemeral");
+
+  setDatabaseValue(kLogs, "active", "ephemeral");
+  ASSERT_TRUE(rf.setActive("database", existing));
+  if (existing != "ephemeral") {
+    getDatabaseValue(kLogs, "active", value);
+    EXPECT_EQ(value, existing);
+  }
+}
+
 TEST_F(DatabaseTests, test_delete_values_str) {
   setDatabaseValue(kLogs, "k", "0");
 
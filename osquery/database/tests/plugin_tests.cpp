@@ -19,6 +19,7 @@
 namespace osquery {
 
 DECLARE_string(database_path);
+DECLARE_bool(database_batch_requests);
 
 class EphemeralDatabasePluginTests : public DatabasePluginTests {
  protected:
@@ -155,6 +156,28 @@ void DatabasePluginTests::testPutBatch() {
     EXPECT_EQ(expected_value, value);
   }
 
+  // Extensions send batches encoded as a JSON object.
+  DatabaseStringValueList str_batch3 = {
+      {"test_plugin_put_batch_str1", "test_put_str1_value"},
+      {"test_plugin_put_batch_str2", "test_put_str2_value"}};
+  std::string serialized_batch;
+  EXPECT_TRUE(serializeDatabaseBatch(str_batch3, serialized_batch).ok());
+  request = {{"action", "putBatch"},
+             {"domain", kQueries},
+             {"json", std::move(serialized_batch)}};
+
+  s = Registry::call("database", getName(), request);
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> keys, values, expected_values;
+  for (const auto& p : str_batch3) {
+    keys.push_back(p.first);
+    expected_values.push_back(p.second);
+  }
+  s = getDatabaseValues(kQueries, keys, values);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(values, expected_values);
+
   auto reset = std::async(std::launch::async, kTestReseter);
   reset.get();
 }
@@ -247,5 +270,99 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_TRUE(s.ok());
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
+
+  // A limit from an extension request that is not a number is an error.
+  for (const auto& action : {"scan", "scanValues"}) {
+    PluginRequest request = {{"action", action},
+                             {"domain", kQueries},
+                             {"prefix", "test_scan_"},
+                             {"max", "two"}};
+    PluginResponse response;
+    s = Registry::call("database", getName(), request, response);
+    EXPECT_FALSE(s.ok());
+    EXPECT_TRUE(response.empty());
+  }
+}
+
+void DatabasePluginTests::testMultiGet() {
+  getPlugin()->put(kQueries, "test_multi_get1", "1");
+  getPlugin()->put(kQueries, "test_multi_get2", "2");
+
+  std::vector<std::string> values;
+  auto s = getPlugin()->multiGet(
+      kQueries,
+      {"test_multi_get2", "test_multi_get_missing", "test_multi_get1"},
+      values);
+  EXPECT_TRUE(s.ok());
+  std::vector<std::string> expected = {"2", "", "1"};
+  EXPECT_EQ(values, expected);
+
+  // The same lookup through the database API and the extension call.
+  values.clear();
+  s = getDatabaseValues(
+      kQueries, {"test_multi_get1", "test_multi_get1"}, values);
+  EXPECT_TRUE(s.ok());
+  expected = {"1", "1"};
+  EXPECT_EQ(values, expected);
+
+  PluginRequest request = {{"action", "multiGet"},
+                           {"domain", kQueries},
+                           {"json", "[\"test_multi_get2\"]"}};
+  PluginResponse response;
+  s = Registry::call("database", getName(), request, response);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(response.size(), 1U);
+  EXPECT_EQ(response[0]["json"], "[\"2\"]");
+
+  // Batched requests are rejected if the core does not advertise them.
+  FLAGS_database_batch_requests = false;
+  response.clear();
+  s = Registry::call("database", getName(), request, response);
+  EXPECT_FALSE(s.ok());
+  FLAGS_database_batch_requests = true;
+}
+
+void DatabasePluginTests::testScanValues() {
+  getPlugin()->put(kQueries, "test_range_a", "a");
+  getPlugin()->put(kQueries, "test_range_b1", "b1");
+  getPlugin()->put(kQueries, "test_range_b2", "b2");
+  getPlugin()->put(kQueries, "test_range_c", "c");
+  getPlugin()->put(kQueries, "test_rangf", "f");
+
+  DatabaseScanRange range;
+  range.prefix = "test_range_";
+  DatabaseStringValueList results;
+  auto s = scanDatabaseValues(kQueries, range, results);
+  EXPECT_TRUE(s.ok());
+  DatabaseStringValueList expected = {{"test_range_a", "a"},
+                                      {"test_range_b1", "b1"},
+                                      {"test_range_b2", "b2"},
+                                      {"test_range_c", "c"}};
+  EXPECT_EQ(results, expected);
+
+  // Bounds are inclusive low and exclusive high.
+  range.low = "test_range_b";
+  range.high = "test_range_c";
+  results.clear();
+  scanDatabaseValues(kQueries, range, results);
+  expected = {{"test_range_b1", "b1"}, {"test_range_b2", "b2"}};
+  EXPECT_EQ(results, expected);
+
+  range.max = 1;
+  results.clear();
+  scanDatabaseValues(kQueries, range, results);
+  expected = {{"test_range_b1", "b1"}};
+  EXPECT_EQ(results, expected);
+
+  // The visitor may stop the scan.
+  size_t visited = 0;
+  s = getPlugin()->scanValues(
+      kQueries,
+      DatabaseScanRange(),
+      ([&visited](const std::string&, const std::string&) {
+        return ++visited < 2;
+      }));
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(visited, 2U);
 }
 } // namespace osquery
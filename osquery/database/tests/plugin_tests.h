@@ -44,6 +44,12 @@
   }                                                                            \
   TEST_F(n, test_scan_limit) {                                                 \
     testScanLimit();                                                           \
+  }                                                                            \
+  TEST_F(n, test_multi_get) {                                                  \
+    testMultiGet();                                                            \
+  }                                                                            \
+  TEST_F(n, test_scan_values) {                                                \
+    testScanValues();                                                          \
   }
 
 namespace osquery {
@@ -95,5 +101,7 @@ class DatabasePluginTests : public testing::Test {
   void testDeleteRange();
   void testScan();
   void testScanLimit();
+  void testMultiGet();
+  void testScanValues();
 };
 } // namespace osquery
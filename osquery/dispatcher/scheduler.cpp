@@ -9,8 +9,10 @@
  */
 
 #include <ctime>
+#include <map>
 
 #include <boost/format.hpp>
+#include <boost/noncopyable.hpp>
 
 #include <osquery/config.h>
 #include <osquery/core.h>
@@ -20,10 +22,12 @@
 #include <osquery/logger.h>
 #include <osquery/numeric_monitoring.h>
 #include <osquery/query.h>
+#include <osquery/registry_factory.h>
 #include <osquery/system.h>
 
 #include "osquery/config/parsers/decorators.h"
 #include "osquery/core/process.h"
+#include "osquery/core/query_budget.h"
 #include "osquery/dispatcher/scheduler.h"
 #include "osquery/sql/sqlite_util.h"
 
@@ -48,6 +52,11 @@ FLAG(uint64,
 
 FLAG(uint64, schedule_epoch, 0, "Epoch for scheduled queries");
 
+FLAG(bool,
+     schedule_changes,
+     false,
+     "Use table changes for differential queries that select from one table");
+
 HIDDEN_FLAG(bool, enable_monitor, true, "Enable the schedule monitor");
 
 HIDDEN_FLAG(bool,
@@ -58,68 +67,281 @@ HIDDEN_FLAG(bool,
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
-  // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentPid());
-  auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
-  auto t0 = getUnixTime();
-  Config::get().recordQueryStart(name);
-  SQLInternal sql(query.query, true);
-  // Snapshot the performance after, and compare.
-  auto t1 = getUnixTime();
-  auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
-  if (r0.size() > 0 && r1.size() > 0) {
-    // Calculate a size as the expected byte output of results.
-    // This does not dedup result differentials and is not aware of snapshots.
-    size_t size = 0;
-    for (const auto& row : sql.rows()) {
-      for (const auto& column : row) {
-        size += column.first.size();
-        size += column.second.size();
-      }
+namespace {
+/// The use of table changes by a differential scheduled query.
+struct QueryChanges {
+  /// The query the table was planned for.
+  std::string query;
+
+  /// The table providing changes, empty if the query cannot use changes.
+  std::string table;
+
+  /// The cursor of the stored results, empty if they were not from a feed.
+  std::string cursor;
+};
+
+/// Table changes of scheduled queries by name, used by the scheduler thread.
+std::map<std::string, QueryChanges> kQueryChanges;
+
+/// Find the table providing changes for a query, planned once per query.
+QueryChanges& getQueryChanges(const std::string& name,
+                              const ScheduledQuery& query) {
+  auto& changes = kQueryChanges[name];
+  if (changes.query == query.query) {
+    return changes;
+  }
+
+  changes = QueryChanges();
+  changes.query = query.query;
+  QueryPlanner planner(query.query);
+  if (!planner.isRowProjection()) {
+    return changes;
+  }
+
+  auto table = planner.tables().front();
+  if (Registry::get().exists("table", table, true)) {
+    auto plugin = Registry::get().plugin("table", table);
+    auto table_plugin = std::dynamic_pointer_cast<TablePlugin>(plugin);
+    if (table_plugin != nullptr && table_plugin->providesChanges()) {
+      VLOG(1) << "Scheduled query " << name << " uses changes of " << table;
+      changes.table = std::move(table);
+    }
+  }
+  return changes;
+}
+
+/// Execute a query, scans of the feed's table yield its changes.
+SQLInternal runQuery(const std::string& query, TableChangeFeed* feed) {
+  TableChangeFeed::Scope scope(feed);
+  return SQLInternal(query, true);
+}
+
+/// Calculate a size as the expected byte output of results.
+size_t getResultsSize(const QueryData& results) {
+  size_t size = 0;
+  for (const auto& row : results) {
+    for (const auto& column : row) {
+      size += column.first.size();
+      size += column.second.size();
+    }
+  }
+  return size;
+}
+
+/**
+ * @brief The performance and budget of one execution of a scheduled query.
+ *
+ * An execution may run the query more than once, for example when the
+ * changes of its table are not available. It is recorded once, when it
+ * finishes.
+ */
+class QueryExecution : private boost::noncopyable {
+ public:
+  QueryExecution(const std::string& name, const ScheduledQuery& query)
+      : name_(name), pid_(std::to_string(PlatformProcess::getCurrentPid())) {
+    // Snapshot the performance and times for the worker before running.
+    r0_ = SQL::selectFrom({"resident_size", "user_time", "system_time"},
+                          "processes",
+                          "pid",
+                          EQUALS,
+                          pid_);
+    t0_ = getUnixTime();
+    Config::get().recordQueryStart(name_);
+    auto budget = getQueryBudget(query.budget);
+    if (budget.limited()) {
+      tracker_ = std::make_unique<QueryBudgetTracker>(budget);
+    }
+  }
+
+  /// Record the execution, size is the expected byte output of its results.
+  void finish(size_t size) {
+    if (tracker_ != nullptr && !tracker_->reason().empty()) {
+      // Only this query is stopped, the worker continues the schedule.
+      LOG(WARNING) << "Scheduled query exceeded its budget ("
+                   << tracker_->reason() << "): " << name_;
+      Config::get().blacklistQuery(name_);
+    }
+    // Stop enforcing the budget before inspecting the worker's performance.
+    tracker_.reset();
+    // Snapshot the performance after, and compare.
+    auto t1 = getUnixTime();
+    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
+                              "processes",
+                              "pid",
+                              EQUALS,
+                              pid_);
+    if (r0_.size() > 0 && r1.size() > 0) {
+      // This does not dedup result differentials and is not aware of
+      // snapshots. Always called while processes table is working.
+      Config::get().recordQueryPerformance(
+          name_, t1 - t0_, size, r0_[0], r1[0]);
     }
-    // Always called while processes table is working.
-    Config::get().recordQueryPerformance(name, t1 - t0, size, r0[0], r1[0]);
   }
+
+ private:
+  std::string name_;
+  std::string pid_;
+  QueryData r0_;
+  size_t t0_{0};
+  std::unique_ptr<QueryBudgetTracker> tracker_;
+};
+} // namespace
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    TableChangeFeed* feed) {
+  QueryExecution execution(name, query);
+  auto sql = runQuery(query.query, feed);
+  execution.finish(getResultsSize(sql.rows()));
   return sql;
 }
 
+namespace {
+/// Fill in the metadata of a query log item for a scheduled query.
+void initQueryLogItem(const std::string& name, QueryLogItem& item) {
+  item.name = name;
+  // Fill in a host identifier fields based on configuration or availability.
+  item.identifier = getHostIdentifier();
+  item.time = osquery::getUnixTime();
+  item.epoch = FLAGS_schedule_epoch;
+  item.calendar_time = osquery::getAsciiTime();
+  getDecorations(item.decorations);
+}
+
+/// Log the differential results of a scheduled query, if there are any.
+Status logQueryResults(const ScheduledQuery& query, QueryLogItem& item) {
+  DiffResults& diff_results = item.results;
+  if (query.options.count("removed") && !query.options.at("removed")) {
+    diff_results.removed.clear();
+  }
+
+  if (diff_results.added.empty() && diff_results.removed.empty()) {
+    // No diff results or events to emit.
+    return Status::success();
+  }
+
+  VLOG(1) << "Found results for query: " << item.name;
+
+  auto status = logQueryLogItem(item);
+  if (!status.ok()) {
+    // If log directory is not available, then the daemon shouldn't continue.
+    std::string error = "Error logging the results of query: " + item.name +
+                        ": " + status.toString();
+    LOG(ERROR) << error;
+    Initializer::requestShutdown(EXIT_CATASTROPHIC, error);
+  }
+  return status;
+}
+
+/**
+ * @brief Execute a differential query over the changes of its table.
+ *
+ * The query runs once over the rows the table added and once over the rows
+ * it removed since the cursor of the stored results. Rows in both did not
+ * change in the columns the query selects.
+ *
+ * @param item [output] the query log item of the differential results.
+ * @return failure if the query's stored results must be replaced.
+ */
+Status launchChanges(const std::string& name,
+                     const ScheduledQuery& query,
+                     QueryChanges& changes,
+                     QueryLogItem& item) {
+  TableChangeFeed feed(changes.table, changes.cursor);
+  auto added = runQuery(query.query, &feed);
+  if (!added.ok() || !feed.ok()) {
+    return Status(1, "Table changes are not available");
+  }
+
+  feed.select(TableChangeFeed::REMOVED);
+  auto removed = runQuery(query.query, &feed);
+  if (!removed.ok()) {
+    return Status(1, "Cannot select removed rows: " +
+                         removed.getMessageString());
+  }
+
+  initQueryLogItem(name, item);
+  item.columns = added.columns();
+
+  // Comparisons and stores must include escaped data.
+  added.escapeResults();
+  removed.escapeResults();
+  QueryDataSet removed_qd(removed.rows().begin(), removed.rows().end());
+  item.results = diff(removed_qd, added.rows());
+
+  auto status = Query(name, query).addDifferential(
+      item.results, item.epoch, item.counter);
+  if (!status.ok()) {
+    return status;
+  }
+
+  changes.cursor = feed.cursor();
+  return Status::success();
+}
+} // namespace
+
 inline Status launchQuery(const std::string& name,
                           const ScheduledQuery& query) {
   // Execute the scheduled query and create a named query object.
   LOG(INFO) << "Executing scheduled query " << name << ": " << query.query;
   runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
+  bool snapshot =
+      query.options.count("snapshot") && query.options.at("snapshot");
+  QueryChanges* changes = nullptr;
+  if (FLAGS_schedule_changes && !snapshot) {
+    changes = &getQueryChanges(name, query);
+    if (changes->table.empty()) {
+      changes = nullptr;
+    }
+  }
+
+  // The attempt to use changes and the scan replacing it are one execution.
+  QueryExecution execution(name, query);
+  if (changes != nullptr && !changes->cursor.empty()) {
+    QueryLogItem item;
+    auto status = launchChanges(name, query, *changes, item);
+    if (status.ok()) {
+      execution.finish(getResultsSize(item.results.added) +
+                       getResultsSize(item.results.removed));
+      return logQueryResults(query, item);
+    }
+
+    // Replace the stored results with a complete set of results.
+    VLOG(1) << "Cannot use table changes for scheduled query " << name << ": "
+            << status.getMessage();
+    changes->cursor.clear();
+  }
+
+  // Without a cursor the feed yields all rows, and a cursor to their changes.
+  std::unique_ptr<TableChangeFeed> feed;
+  if (changes != nullptr) {
+    feed = std::make_unique<TableChangeFeed>(changes->table, "");
+  }
+
+  auto sql = runQuery(query.query, feed.get());
+  if (feed != nullptr && !feed->ok()) {
+    // The table did not provide its rows, they are generated by a scan.
+    feed.reset();
+    if (!sql.ok()) {
+      sql = runQuery(query.query, nullptr);
+    }
+  }
+  execution.finish(getResultsSize(sql.rows()));
+
   if (!sql.ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getMessageString();
     return Status::failure("Error executing scheduled query");
   }
 
-  // Fill in a host identifier fields based on configuration or availability.
-  std::string ident = getHostIdentifier();
-
   // A query log item contains an optional set of differential results or
   // a copy of the most-recent execution alongside some query metadata.
   QueryLogItem item;
-  item.name = name;
-  item.identifier = ident;
+  initQueryLogItem(name, item);
   item.columns = sql.columns();
-  item.time = osquery::getUnixTime();
-  item.epoch = FLAGS_schedule_epoch;
-  item.calendar_time = osquery::getAsciiTime();
-  getDecorations(item.decorations);
 
-  if (query.options.count("snapshot") && query.options.at("snapshot")) {
+  if (snapshot) {
     // This is a snapshot query, emit results with a differential or state.
     item.snapshot_results = std::move(sql.rows());
     logSnapshotQuery(item);
@@ -146,31 +368,16 @@ inline Status launchQuery(const std::string& name,
 
       // If the database is not available then the daemon cannot continue.
       Initializer::requestShutdown(EXIT_CATASTROPHIC, line);
+    } else if (feed != nullptr) {
+      // The stored results are the table's rows at the feed's cursor.
+      changes->cursor = feed->cursor();
     }
   } else {
     diff_results.added = std::move(sql.rows());
   }
 
-  if (query.options.count("removed") && !query.options.at("removed")) {
-    diff_results.removed.clear();
-  }
-
-  if (diff_results.added.empty() && diff_results.removed.empty()) {
-    // No diff results or events to emit.
-    return status;
-  }
-
-  VLOG(1) << "Found results for query: " << name;
-
-  status = logQueryLogItem(item);
-  if (!status.ok()) {
-    // If log directory is not available, then the daemon shouldn't continue.
-    std::string error = "Error logging the results of query: " + name + ": " +
-                        status.toString();
-    LOG(ERROR) << error;
-    Initializer::requestShutdown(EXIT_CATASTROPHIC, error);
-  }
-  return status;
+  auto log_status = logQueryResults(query, item);
+  return (status.ok()) ? log_status : status;
 }
 
 inline void launchQueryWithProfiling(const std::string& name,
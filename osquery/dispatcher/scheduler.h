@@ -16,6 +16,7 @@
 #include <osquery/dispatcher.h>
 
 #include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/table_changes.h"
 
 namespace osquery {
 
@@ -57,7 +58,14 @@ class SchedulerRunner : public InternalRunnable {
   const std::chrono::milliseconds max_time_drift_;
 };
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
+/**
+ * @brief Execute a scheduled query and record its performance.
+ *
+ * If a change feed is provided, scans of its table yield the table's changes.
+ */
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    TableChangeFeed* feed = nullptr);
 
 /// Start querying according to the config's schedule
 void startScheduler();
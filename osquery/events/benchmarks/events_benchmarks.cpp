@@ -12,6 +12,7 @@
 
 #include <osquery/config.h>
 #include <osquery/events.h>
+#include <osquery/flags.h>
 #include <osquery/registry_factory.h>
 #include <osquery/tables.h>
 
@@ -19,6 +20,8 @@
 
 namespace osquery {
 
+DECLARE_uint64(events_dispatch_queue);
+
 class BenchmarkEventPublisher
     : public EventPublisher<SubscriptionContext, EventContext> {
   DECLARE_PUBLISHER("benchmark");
@@ -117,6 +120,29 @@ static void EVENTS_subscribe_fire(benchmark::State& state) {
 
 BENCHMARK(EVENTS_subscribe_fire);
 
+static void EVENTS_subscribe_fire_queued(benchmark::State& state) {
+  auto plugin = Config::get().getParser("events");
+  plugin->setUp();
+
+  auto pub = std::make_shared<BenchmarkEventPublisher>();
+  EventFactory::registerEventPublisher(pub);
+
+  // Deliver events to the subscriber through its dispatch queue.
+  FLAGS_events_dispatch_queue = state.range(0);
+  auto sub = std::make_shared<BenchmarkEventSubscriber>();
+  EventFactory::registerEventSubscriber(sub);
+  sub->benchmarkInit();
+
+  while (state.KeepRunning()) {
+    pub->benchmarkFire();
+  }
+
+  EventFactory::deregisterEventSubscriber(sub->getName());
+  FLAGS_events_dispatch_queue = 0;
+}
+
+BENCHMARK(EVENTS_subscribe_fire_queued)->Arg(1024)->Arg(65536);
+
 static void EVENTS_add_events(benchmark::State& state) {
   auto pub = std::make_shared<BenchmarkEventPublisher>();
   EventFactory::registerEventPublisher(pub);
@@ -8,8 +8,12 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <exception>
+#include <memory>
 #include <thread>
 
 #include <boost/algorithm/string.hpp>
@@ -21,11 +25,13 @@
 #include <osquery/events.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/numeric_monitoring.h>
 #include <osquery/registry_factory.h>
 #include <osquery/sql.h>
 #include <osquery/system.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/core/json.h"
 
 namespace osquery {
 
@@ -35,6 +41,9 @@ CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 /// Checkpoint interval to inspect max event buffering.
 #define EVENTS_CHECKPOINT 256
 
+/// Event data values read from the database with each request.
+const size_t kEventsReadBatchSize = 1024;
+
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
 
 FLAG(bool,
@@ -50,6 +59,96 @@ FLAG(uint64, events_expiry, 3600, "Timeout to expire event subscriber results");
 // overriding in subclasses
 FLAG(uint64, events_max, 50000, "Maximum number of events per type to buffer");
 
+FLAG(uint64,
+     events_dispatch_queue,
+     0,
+     "Per-subscriber queue size for asynchronous event delivery (0 = sync)");
+
+/**
+ * @brief A bounded queue of events delivered on a subscriber thread.
+ *
+ * Publishers push events that should fire and return immediately. A slow
+ * subscriber callback then only delays its own queue. When the queue is full
+ * new events are dropped and counted instead of stalling the publisher.
+ */
+class EventSubscriberDispatcher : public InternalRunnable {
+ public:
+  EventSubscriberDispatcher(const std::string& name, size_t max_queue)
+      : InternalRunnable("EventSubscriberDispatcher"),
+        name_(name),
+        max_queue_(max_queue) {}
+
+  /// Queue an event, returns false if it was dropped.
+  bool push(const SubscriptionRef& sub, const EventContextRef& ec) {
+    {
+      std::lock_guard<std::mutex> lock(queue_lock_);
+      if (queue_.size() >= max_queue_) {
+        dropped_++;
+        return false;
+      }
+      queue_.emplace_back(sub, ec);
+    }
+    queue_condition_.notify_one();
+    return true;
+  }
+
+  /// The number of events dropped since the dispatcher started.
+  size_t dropped() const {
+    return dropped_;
+  }
+
+ protected:
+  void start() override {
+    size_t reported = 0;
+    std::deque<std::pair<SubscriptionRef, EventContextRef>> events;
+    while (!interrupted()) {
+      {
+        std::unique_lock<std::mutex> lock(queue_lock_);
+        queue_condition_.wait_for(lock, std::chrono::seconds(1), [this]() {
+          return !queue_.empty() || interrupted();
+        });
+        events.swap(queue_);
+      }
+
+      for (const auto& event : events) {
+        event.first->callback(event.second, event.first->context);
+      }
+      events.clear();
+
+      size_t dropped = dropped_;
+      if (dropped > reported) {
+        monitoring::record("osquery.events." + name_ + ".dropped",
+                           dropped - reported,
+                           monitoring::PreAggregationType::Sum);
+        reported = dropped;
+      }
+    }
+  }
+
+  void stop() override {
+    queue_condition_.notify_all();
+  }
+
+ private:
+  /// The subscriber name, used for monitoring paths.
+  std::string name_;
+
+  /// Maximum number of events waiting for delivery.
+  size_t max_queue_{0};
+
+  /// Events waiting for the dispatch thread.
+  std::deque<std::pair<SubscriptionRef, EventContextRef>> queue_;
+
+  /// Protects the queue.
+  std::mutex queue_lock_;
+
+  /// Wakes the dispatch thread when events are queued.
+  std::condition_variable queue_condition_;
+
+  /// Count of events dropped because the queue was full.
+  std::atomic<size_t> dropped_{0};
+};
+
 static inline EventTime timeFromRecord(const std::string& record) {
   // Convert a stored index "as string bytes" to a time value.
   return static_cast<EventTime>(tryTo<long long>(record).takeOr(0ll));
@@ -102,24 +201,76 @@ static inline void setOptimizeData(EventTime time,
   setDatabaseValue(kEvents, "optimize_eid." + query_name, toIndex(eid));
 }
 
+static inline bool isPaddedEID(const std::string& expr) {
+  return expr.size() == 10 &&
+         std::all_of(expr.begin(), expr.end(), [](char c) {
+           return c >= '0' && c <= '9';
+         });
+}
+
+/**
+ * @brief Narrow inclusive bounds using a comparison constraint.
+ *
+ * A stop of zero is unbounded, returns false if nothing can match.
+ */
+template <typename T>
+static bool applyBoundConstraint(unsigned char op, T expr, T& start, T& stop) {
+  if (op == EQUALS) {
+    start = std::max(start, expr);
+    stop = (stop == 0) ? expr : std::min(stop, expr);
+  } else if (op == GREATER_THAN) {
+    start = std::max(start, expr + 1);
+  } else if (op == GREATER_THAN_OR_EQUALS) {
+    start = std::max(start, expr);
+  } else if (op == LESS_THAN || op == LESS_THAN_OR_EQUALS) {
+    if (op == LESS_THAN) {
+      if (expr <= 1) {
+        return false;
+      }
+      expr--;
+    } else if (expr == 0) {
+      return false;
+    }
+    stop = (stop == 0) ? expr : std::min(stop, expr);
+  }
+  return stop == 0 || start <= stop;
+}
+
+/// Decode the columns of a stored event row that the query uses.
+static Status deserializeUsedColumns(const std::string& json,
+                                     const QueryContext* context,
+                                     Row& r) {
+  if (context == nullptr || !context->colsUsed) {
+    return deserializeRowJSON(json, r);
+  }
+
+  auto doc = JSON::newObject();
+  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+    return Status(1, "Cannot deserializing JSON");
+  }
+
+  for (const auto& i : doc.doc().GetObject()) {
+    if (!i.value.IsString()) {
+      continue;
+    }
+    std::string name(i.name.GetString(), i.name.GetStringLength());
+    if (!name.empty() && context->isColumnUsed(name)) {
+      r[name].assign(i.value.GetString(), i.value.GetStringLength());
+    }
+  }
+  return Status();
+}
+
 void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
   // Stop is an unsigned (-1), our end of time equivalent.
-  EventTime start = 0, stop = 0;
+  EventBounds bounds;
   if (context.constraints["time"].getAll().size() > 0) {
     // Use the 'time' constraint to optimize backing-store lookups.
     for (const auto& constraint : context.constraints["time"].getAll()) {
       EventTime expr = timeFromRecord(constraint.expr);
-      if (constraint.op == EQUALS) {
-        stop = start = expr;
-        break;
-      } else if (constraint.op == GREATER_THAN) {
-        start = std::max(start, expr + 1);
-      } else if (constraint.op == GREATER_THAN_OR_EQUALS) {
-        start = std::max(start, expr);
-      } else if (constraint.op == LESS_THAN) {
-        stop = std::min(stop, expr - 1);
-      } else if (constraint.op == LESS_THAN_OR_EQUALS) {
-        stop = std::min(stop, expr);
+      if (!applyBoundConstraint(
+              constraint.op, expr, bounds.start, bounds.stop)) {
+        return;
       }
     }
   } else if (Initializer::isDaemon() && FLAGS_events_optimize) {
@@ -127,7 +278,7 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
     // allows optimization, only emit events since the last query.
     std::string query_name;
     getOptimizeData(optimize_time_, optimize_eid_, query_name, dbNamespace());
-    start = optimize_time_;
+    bounds.start = optimize_time_;
     optimize_time_ = getUnixTime() - 1;
 
     // Track the queries that have selected data.
@@ -136,7 +287,19 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
       queries_.insert(query_name);
     }
   }
-  get(yield, start, stop);
+
+  // The 'eid' column is text, only padded IDs compare as numbers.
+  for (const auto& constraint : context.constraints["eid"].getAll()) {
+    if (!isPaddedEID(constraint.expr)) {
+      continue;
+    }
+    auto eid = tryTo<std::size_t>(constraint.expr).takeOr(std::size_t{0});
+    if (!applyBoundConstraint(
+            constraint.op, eid, bounds.eid_start, bounds.eid_stop)) {
+      return;
+    }
+  }
+  get(yield, bounds, &context);
 }
 
 EventContextID EventPublisherPlugin::numEvents() const {
@@ -148,12 +311,8 @@ size_t EventPublisherPlugin::numSubscriptions() {
   return subscriptions_.size();
 }
 
-void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
-  if (isEnding()) {
-    // Cannot emit/fire while ending
-    return;
-  }
-
+void EventPublisherPlugin::stampEventContext(const EventContextRef& ec,
+                                             EventTime time) {
   EventContextID ec_id = 0;
   ec_id = next_ec_id_.fetch_add(1);
 
@@ -167,14 +326,57 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
       ec->time = time;
     }
   }
+}
+
+void EventPublisherPlugin::fireSubscriber(const SubscriptionRef& subscription,
+                                          const EventContextRef& ec) {
+  // Subscriptions are routed to their subscriber when they are added.
+  auto es = subscription->subscriber.lock();
+  if (es == nullptr) {
+    es = EventFactory::getEventSubscriber(subscription->subscriber_name);
+  }
+  if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
+    fireCallback(subscription, ec);
+  }
+}
+
+void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
+  if (isEnding()) {
+    // Cannot emit/fire while ending
+    return;
+  }
 
+  stampEventContext(ec, time);
   ReadLock lock(subscription_lock_);
   for (const auto& subscription : subscriptions_) {
-    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
-    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
-      fireCallback(subscription, ec);
+    fireSubscriber(subscription, ec);
+  }
+}
+
+void EventPublisherPlugin::fireSubscription(const SubscriptionRef& sub,
+                                            const EventContextRef& ec,
+                                            EventTime time) {
+  if (isEnding()) {
+    return;
+  }
+
+  stampEventContext(ec, time);
+  ReadLock lock(subscription_lock_);
+  fireSubscriber(sub, ec);
+}
+
+void EventPublisherPlugin::dispatchCallback(const SubscriptionRef& sub,
+                                            const EventContextRef& ec) {
+  auto es = sub->subscriber.lock();
+  if (es != nullptr) {
+    // The dispatcher is reset when the subscriber is deregistered.
+    auto dispatcher = std::atomic_load(&es->dispatcher_);
+    if (dispatcher != nullptr) {
+      dispatcher->push(sub, ec);
+      return;
     }
   }
+  sub->callback(ec, sub->context);
 }
 
 std::vector<std::string> EventSubscriberPlugin::getIndexes(EventTime start,
@@ -383,25 +585,34 @@ bool EventSubscriberPlugin::executedAllQueries() const {
   return queries_.size() >= query_count_;
 }
 
+size_t EventSubscriberPlugin::numDropped() const {
+  auto dispatcher = std::atomic_load(&dispatcher_);
+  return (dispatcher != nullptr) ? dispatcher->dropped() : 0;
+}
+
 std::vector<EventRecord> EventSubscriberPlugin::getRecords(
     const std::vector<std::string>& indexes, bool optimize) {
   auto record_key = "records." + dbNamespace();
 
-  std::vector<EventRecord> records;
+  std::vector<std::string> record_keys;
+  record_keys.reserve(indexes.size());
   for (const auto& index : indexes) {
-    std::vector<std::string> bin_records;
-    {
-      std::string record_value;
-      getDatabaseValue(kEvents, record_key + "." + index, record_value);
-      if (record_value.empty()) {
-        // There are actually no events in this bin, interesting error case.
-        continue;
-      }
+    record_keys.push_back(record_key + "." + index);
+  }
 
-      // Each list is tokenized into a record=event_id:time.
-      bin_records = split(record_value, ",");
+  std::vector<std::string> record_values;
+  getDatabaseValues(kEvents, record_keys, record_values);
+
+  std::vector<EventRecord> records;
+  for (const auto& record_value : record_values) {
+    if (record_value.empty()) {
+      // There are actually no events in this bin, interesting error case.
+      continue;
     }
 
+    // Each list is tokenized into a record=event_id:time.
+    auto bin_records = split(record_value, ",");
+
     // Iterate over every 2 items: EID:TIME.
     for (const auto& record : bin_records) {
       const auto vals = split(record, ":");
@@ -511,18 +722,19 @@ const std::string EventSubscriberPlugin::getEventID() {
 void EventSubscriberPlugin::get(RowYield& yield,
                                 EventTime start,
                                 EventTime stop) {
+  EventBounds bounds;
+  bounds.start = start;
+  bounds.stop = stop;
+  get(yield, bounds, nullptr);
+}
+
+void EventSubscriberPlugin::get(RowYield& yield,
+                                const EventBounds& bounds,
+                                const QueryContext* context) {
   // Get the records for this time range.
-  auto indexes = getIndexes(start, stop);
+  auto indexes = getIndexes(bounds.start, bounds.stop);
   auto records = getRecords(indexes);
 
-  std::string events_key = "data." + dbNamespace();
-  std::vector<std::string> mapped_records;
-  for (const auto& record : records) {
-    if (record.second >= start && (record.second <= stop || stop == 0)) {
-      mapped_records.push_back(events_key + "." + record.first);
-    }
-  }
-
   if (FLAGS_events_optimize && !records.empty()) {
     // If records were returned save the ordered-last as the optimization EID.
     auto const eidr_exp = tryTo<unsigned long int>(records.back().first, 10);
@@ -531,22 +743,52 @@ void EventSubscriberPlugin::get(RowYield& yield,
     }
   }
 
-  // Select mapped_records using event_ids as keys.
-  std::string data_value;
-  for (const auto& record : mapped_records) {
-    Row r;
-    auto status = getDatabaseValue(kEvents, record, data_value);
-    if (data_value.length() == 0) {
-      // There is no record here, interesting error case.
+  // Select the records within the bounds using event_ids as keys.
+  auto events_key = "data." + dbNamespace() + ".";
+  bool eid_bounded = bounds.eid_start > 0 || bounds.eid_stop > 0;
+  std::vector<std::string> keys;
+  std::vector<std::string> data_values;
+  auto yieldEvents = ([&]() {
+    getDatabaseValues(kEvents, keys, data_values);
+    keys.clear();
+    for (auto& data_value : data_values) {
+      if (data_value.length() == 0) {
+        // There is no record here, interesting error case.
+        continue;
+      }
+
+      Row r;
+      auto status = deserializeUsedColumns(data_value, context, r);
+      data_value.clear();
+      if (status.ok()) {
+        yield(r);
+      }
+    }
+  });
+
+  for (const auto& record : records) {
+    if (record.second < bounds.start ||
+        (bounds.stop != 0 && record.second > bounds.stop)) {
       continue;
     }
-    status = deserializeRowJSON(data_value, r);
-    data_value.clear();
-    if (status.ok()) {
-      yield(r);
+    if (eid_bounded) {
+      auto eid = static_cast<size_t>(timeFromRecord(record.first));
+      if (eid < bounds.eid_start ||
+          (bounds.eid_stop != 0 && eid > bounds.eid_stop)) {
+        continue;
+      }
+    }
+
+    keys.push_back(events_key + record.first);
+    if (keys.size() >= kEventsReadBatchSize) {
+      yieldEvents();
     }
   }
 
+  if (!keys.empty()) {
+    yieldEvents();
+  }
+
   auto expiry = getEventsExpiry();
   if (expiry > 0) {
     // Make sure the configured expiration is at least the minimum needed to
@@ -927,8 +1169,22 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
   }
   specialized_sub->state(EventState::EVENT_SETUP);
 
+  // Register before init so the Subscriptions it adds resolve to it.
+  auto& ef = EventFactory::getInstance();
+  {
+    WriteLock lock(getInstance().factory_lock_);
+    ef.event_subs_[name] = specialized_sub;
+  }
+
   // Let the subscriber initialize any Subscriptions.
   if (!FLAGS_disable_events && !specialized_sub->disabled) {
+    if (FLAGS_events_dispatch_queue > 0 &&
+        std::atomic_load(&specialized_sub->dispatcher_) == nullptr) {
+      auto dispatcher = std::make_shared<EventSubscriberDispatcher>(
+          name, FLAGS_events_dispatch_queue);
+      std::atomic_store(&specialized_sub->dispatcher_, dispatcher);
+      Dispatcher::addService(dispatcher);
+    }
     specialized_sub->expireCheck();
     status = specialized_sub->init();
     specialized_sub->state(EventState::EVENT_RUNNING);
@@ -936,12 +1192,6 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
     specialized_sub->state(EventState::EVENT_PAUSED);
   }
 
-  auto& ef = EventFactory::getInstance();
-  {
-    WriteLock lock(getInstance().factory_lock_);
-    ef.event_subs_[name] = specialized_sub;
-  }
-
   // Set state of subscriber.
   if (!status.ok()) {
     specialized_sub->state(EventState::EVENT_FAILED);
@@ -966,6 +1216,13 @@ Status EventFactory::addSubscription(const std::string& type_id,
     return Status(1, "Unknown event publisher");
   }
 
+  // Resolve the subscriber once, instead of for every fired event.
+  if (subscription->subscriber.expired() &&
+      exists(subscription->subscriber_name)) {
+    subscription->subscriber =
+        getEventSubscriber(subscription->subscriber_name);
+  }
+
   // The event factory is responsible for configuring the event types.
   return publisher->addSubscription(subscription);
 }
@@ -1045,6 +1302,13 @@ Status EventFactory::deregisterEventSubscriber(const std::string& sub) {
   auto& subscriber = ef.event_subs_.at(sub);
   subscriber->state(EventState::EVENT_NONE);
   subscriber->tearDown();
+  // Publishers may still hold the dispatcher, only stop its thread. The reset
+  // lets a later registration of the subscriber start a new dispatcher.
+  auto dispatcher = std::atomic_exchange(
+      &subscriber->dispatcher_, std::shared_ptr<EventSubscriberDispatcher>());
+  if (dispatcher != nullptr) {
+    dispatcher->interrupt();
+  }
   ef.event_subs_.erase(sub);
   return Status(0);
 }
@@ -8,17 +8,23 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <sstream>
 
 #include <fnmatch.h>
 #include <linux/limits.h>
 #include <poll.h>
+#include <sys/ioctl.h>
 
 #include <boost/filesystem.hpp>
 
 #include <osquery/config.h>
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/numeric_monitoring.h>
 #include <osquery/registry_factory.h>
 #include <osquery/system.h>
 
@@ -28,11 +34,17 @@ namespace fs = boost::filesystem;
 
 namespace osquery {
 
+FLAG(uint64,
+     inotify_coalesce_window,
+     0,
+     "Milliseconds to coalesce duplicate inotify events (default 0, off)");
+
 static const size_t kINotifyMaxEvents = 512;
 static const size_t kINotifyEventSize =
     sizeof(struct inotify_event) + (NAME_MAX + 1);
-static const size_t kINotifyBufferSize =
-    (kINotifyMaxEvents * kINotifyEventSize);
+
+/// Maximum number of reads used to drain the inotify handle per wakeup.
+static const size_t kINotifyMaxReads = 16;
 
 std::map<int, std::string> kMaskActions = {
     {IN_ACCESS, "ACCESSED"},
@@ -61,7 +73,7 @@ Status INotifyEventPublisher::setUp() {
   }
 
   WriteLock lock(scratch_mutex_);
-  scratch_ = (char*)malloc(kINotifyBufferSize);
+  scratch_ = (char*)malloc(inotify_events_ * kINotifyEventSize);
   if (scratch_ == nullptr) {
     return Status(1, "Could not allocate scratch space");
   }
@@ -207,10 +219,15 @@ void INotifyEventPublisher::tearDown() {
 }
 
 void INotifyEventPublisher::handleOverflow() {
+  overflowed_events_++;
+  static const monitoring::Metric kOverflowed(
+      "osquery.events.inotify.overflowed");
+  kOverflowed.record(1);
+
   if (inotify_events_ < kINotifyMaxEvents) {
     VLOG(1) << "inotify was overflown: increasing scratch buffer";
-    // Exponential increment.
-    inotify_events_ = inotify_events_ * 2;
+    // Exponential increment, applied once the current buffer is handled.
+    scratch_request_ = std::max(scratch_request_, inotify_events_ * 2);
   } else if (last_overflow_ != -1 && getUnixTime() - last_overflow_ < 60) {
     return;
   } else {
@@ -219,38 +236,65 @@ void INotifyEventPublisher::handleOverflow() {
   }
 }
 
-Status INotifyEventPublisher::run() {
-  struct pollfd fds[1];
-  fds[0].fd = getHandle();
-  fds[0].events = POLLIN;
-  int selector = ::poll(fds, 1, 1000);
-  if (selector == -1) {
-    if (errno == EINTR) {
-      return Status(0, "inotify poll interrupted");
-    }
-    LOG(WARNING) << "Could not read inotify handle";
-    return Status(1, "inotify poll failed");
+void INotifyEventPublisher::growScratch(size_t events) {
+  events = std::min(events, kINotifyMaxEvents);
+  if (scratch_ == nullptr || events <= inotify_events_) {
+    return;
   }
 
-  if (selector == 0) {
-    // Read timeout.
-    return Status(0, "Continue");
+  auto scratch = (char*)realloc(scratch_, events * kINotifyEventSize);
+  if (scratch == nullptr) {
+    // Continue reading with the existing buffer.
+    return;
   }
+  scratch_ = scratch;
+  inotify_events_ = events;
+}
 
-  if (!(fds[0].revents & POLLIN)) {
-    return Status(0, "Invalid poll response");
+bool INotifyEventPublisher::coalesceEvent(const struct inotify_event* event,
+                                          uint64_t now) {
+  auto window = FLAGS_inotify_coalesce_window;
+  if (window == 0) {
+    return false;
   }
 
-  WriteLock lock(scratch_mutex_);
-  ssize_t record_num =
-      ::read(getHandle(), scratch_, inotify_events_ * kINotifyEventSize);
-  if (record_num == 0 || record_num == -1) {
-    return Status(1, "INotify read failed");
+  // Events for a path share a watch descriptor and (optional) name.
+  std::string key(reinterpret_cast<const char*>(&event->wd),
+                  sizeof(event->wd));
+  if (event->len > 0) {
+    key.append(event->name, ::strnlen(event->name, event->len));
+  }
+
+  // Only the previous event for the path is compared, so a different mask in
+  // between (CREATE, DELETE, CREATE) fires each event.
+  auto it = recent_events_.find(key);
+  if (it != recent_events_.end() && it->second.first == event->mask &&
+      now - it->second.second < window) {
+    return true;
   }
+  recent_events_[key] = std::make_pair(event->mask, now);
+  return false;
+}
 
-  for (char* p = scratch_; p < scratch_ + record_num;) {
+void INotifyEventPublisher::expireCoalesced(uint64_t now) {
+  auto window = FLAGS_inotify_coalesce_window;
+  for (auto it = recent_events_.begin(); it != recent_events_.end();) {
+    if (window == 0 || now - it->second.second >= window) {
+      it = recent_events_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void INotifyEventPublisher::handleEvents(const char* buffer,
+                                         size_t size,
+                                         uint64_t now) {
+  size_t coalesced = 0;
+  for (const char* p = buffer; p < buffer + size;) {
     // Cast the inotify struct, make shared pointer, and append to contexts.
-    auto event = reinterpret_cast<struct inotify_event*>(p);
+    auto event =
+        reinterpret_cast<struct inotify_event*>(const_cast<char*>(p));
     if (event->mask & IN_Q_OVERFLOW) {
       // The inotify queue was overflown (try to recieve more events from OS).
       handleOverflow();
@@ -263,16 +307,93 @@ Status INotifyEventPublisher::run() {
     } else if (event->mask & IN_DELETE_SELF) {
       // A file was moved to replace the watched path.
       removeMonitor(event->wd, false);
+    } else if (coalesceEvent(event, now)) {
+      // A duplicate within the window, skip creating an EventContext.
+      coalesced++;
     } else {
       auto ec = createEventContextFrom(event);
       if (!ec->action.empty()) {
-        fire(ec);
+        // The watch descriptor already identified the owning Subscription.
+        SubscriptionRef sub;
+        if (ec->isub_ctx != nullptr) {
+          ReadLock sub_lock(subscription_lock_);
+          sub = ec->isub_ctx->subscription_.lock();
+        }
+        if (sub != nullptr) {
+          fireSubscription(sub, ec);
+        } else {
+          fire(ec);
+        }
       }
     }
     // Continue to iterate
     p += (sizeof(struct inotify_event)) + event->len;
   }
 
+  if (coalesced > 0) {
+    coalesced_events_ += coalesced;
+    static const monitoring::Metric kCoalesced(
+        "osquery.events.inotify.coalesced");
+    kCoalesced.record(coalesced);
+  }
+}
+
+Status INotifyEventPublisher::run() {
+  struct pollfd fds[1];
+  fds[0].fd = getHandle();
+  fds[0].events = POLLIN;
+  int selector = ::poll(fds, 1, 1000);
+  if (selector == -1) {
+    if (errno == EINTR) {
+      return Status(0, "inotify poll interrupted");
+    }
+    LOG(WARNING) << "Could not read inotify handle";
+    return Status(1, "inotify poll failed");
+  }
+
+  if (selector == 0) {
+    // Read timeout.
+    return Status(0, "Continue");
+  }
+
+  if (!(fds[0].revents & POLLIN)) {
+    return Status(0, "Invalid poll response");
+  }
+
+  WriteLock lock(scratch_mutex_);
+  auto now = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+  expireCoalesced(now);
+
+  // Drain the handle, growing the scratch space to fit the pending events.
+  for (size_t reads = 0; reads < kINotifyMaxReads; ++reads) {
+    int pending = 0;
+    if (::ioctl(getHandle(), FIONREAD, &pending) == -1) {
+      pending = 0;
+    }
+    if (reads > 0 && pending <= 0) {
+      break;
+    }
+
+    auto needed = (static_cast<size_t>(std::max(pending, 0)) +
+                   kINotifyEventSize - 1) /
+                  kINotifyEventSize;
+    growScratch(std::max(needed, scratch_request_));
+    scratch_request_ = 0;
+
+    ssize_t record_num =
+        ::read(getHandle(), scratch_, inotify_events_ * kINotifyEventSize);
+    if (record_num == 0 || record_num == -1) {
+      if (reads > 0) {
+        break;
+      }
+      return Status(1, "INotify read failed");
+    }
+    handleEvents(scratch_, static_cast<size_t>(record_num), now);
+  }
+
   return Status(0, "OK");
 }
 
@@ -320,7 +441,10 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
   }
 
   // inotify will not monitor recursively, new directories need watches.
-  if (sc->recursive && ec->action == "CREATED" && isDirectory(ec->path)) {
+  // The event mask reports directories, avoid a stat of every created path.
+  if (sc->recursive && ec->action == "CREATED" &&
+      (ec->event != nullptr ? (ec->event->mask & IN_ISDIR) != 0
+                            : isDirectory(ec->path).ok())) {
     const_cast<INotifyEventPublisher*>(this)->addMonitor(
         ec->path + '/',
         const_cast<INotifySubscriptionContextRef&>(sc),
@@ -329,12 +453,14 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
   }
 
   // exclude paths should be applied at last
-  auto path = ec->path.substr(0, ec->path.rfind('/'));
-  // Need to have two finds,
-  // what if somebody excluded an individual file inside a directory
-  if (!exclude_paths_.empty() &&
-      (exclude_paths_.find(path) || exclude_paths_.find(ec->path))) {
-    return false;
+  if (!exclude_paths_.empty()) {
+    boost::string_view path(ec->path);
+    auto parent = path.substr(0, path.rfind('/'));
+    // Need to have two finds,
+    // what if somebody excluded an individual file inside a directory
+    if (exclude_paths_.find(parent) || exclude_paths_.find(path)) {
+      return false;
+    }
   }
 
   return true;
@@ -446,6 +572,7 @@ Status INotifyEventPublisher::addSubscription(
     }
   }
 
+  received_inotify_sc->subscription_ = subscription;
   subscriptions_.push_back(subscription);
   return Status(0);
 }
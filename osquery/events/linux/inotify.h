@@ -11,6 +11,7 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include <sys/inotify.h>
@@ -87,6 +88,9 @@ struct INotifySubscriptionContext : public SubscriptionContext {
   /// Map of path and status change time of file/directory.
   PathStatusChangeTimeMap path_sc_time_;
 
+  /// The Subscription owning this context, events on its watches route here.
+  std::weak_ptr<Subscription> subscription_;
+
  private:
   friend class INotifyEventPublisher;
 };
@@ -246,6 +250,28 @@ class INotifyEventPublisher
   /// If we overflow, try to read more events from OS at time.
   void handleOverflow();
 
+  /// Grow the scratch space to hold a number of events, up to a maximum.
+  void growScratch(size_t events);
+
+  /// Fire, or coalesce, each event read into a buffer.
+  void handleEvents(const char* buffer, size_t size, uint64_t now);
+
+  /**
+   * @brief Check if an event duplicates one recently fired.
+   *
+   * An event with the same watch descriptor, mask, and name as the previous
+   * event for that path, seen within the `inotify_coalesce_window`
+   * (milliseconds) of it firing, is coalesced.
+   *
+   * @param event the raw inotify event.
+   * @param now a monotonic time in milliseconds.
+   * @return true if the event should be dropped.
+   */
+  bool coalesceEvent(const struct inotify_event* event, uint64_t now);
+
+  /// Forget events that fired before the coalescing window.
+  void expireCoalesced(uint64_t now);
+
   /// Map of watched path string to inotify watch file descriptor.
   /// Used for sanity check from unit test(s).
   PathDescriptorMap path_descriptors_;
@@ -265,6 +291,19 @@ class INotifyEventPublisher
   /// Tracks how many events to be received from OS.
   size_t inotify_events_{16};
 
+  /// A requested scratch size (in events) after an overflow.
+  size_t scratch_request_{0};
+
+  /// The mask and fire time of the last event for each recent (wd, name).
+  std::unordered_map<std::string, std::pair<uint32_t, uint64_t>>
+      recent_events_;
+
+  /// Count of events coalesced into a duplicate.
+  std::atomic<size_t> coalesced_events_{0};
+
+  /// Count of inotify queue overflows.
+  std::atomic<size_t> overflowed_events_{0};
+
   /// Enable for sanity check from unit test(s).
   bool inotify_sanity_check{false};
 
@@ -274,6 +313,7 @@ class INotifyEventPublisher
    * We place this here, and include a mutex to do heap/lazy allocation of the
    * near-3k buffer when the publisher loads. This reduces the need to stack
    * allocate a local buffer every 200mils and also improves the eventless-case.
+   * The buffer grows (to inotify_events_) when more events are pending.
    *
    * Allocated during setUp, removed in tearDown, protected by scratch_mutex_.
    */
@@ -291,6 +331,8 @@ class INotifyEventPublisher
   FRIEND_TEST(INotifyTests, test_inotify_optimization);
   FRIEND_TEST(INotifyTests, test_inotify_recursion);
   FRIEND_TEST(INotifyTests, test_inotify_match_subscription);
+  FRIEND_TEST(INotifyTests, test_inotify_exclude_patterns);
+  FRIEND_TEST(INotifyTests, test_inotify_coalesce_events);
   FRIEND_TEST(INotifyTests, test_inotify_embedded_wildcards);
 };
 }
@@ -10,6 +10,8 @@
 
 #include <stdio.h>
 
+#include <cstring>
+
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 
@@ -17,6 +19,7 @@
 
 #include <osquery/events.h>
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/registry_factory.h>
 #include <osquery/tables.h>
 
@@ -27,6 +30,8 @@ namespace fs = boost::filesystem;
 
 namespace osquery {
 
+DECLARE_uint64(inotify_coalesce_window);
+
 const int kMaxEventLatency = 3000;
 
 class INotifyTests : public testing::Test {
@@ -263,6 +268,91 @@ TEST_F(INotifyTests, test_inotify_match_subscription) {
   }
 }
 
+TEST_F(INotifyTests, test_inotify_exclude_patterns) {
+  event_pub_ = std::make_shared<INotifyEventPublisher>(true);
+  event_pub_->exclude_paths_.insert("/var/%/cache/%%");
+  event_pub_->exclude_paths_.insert("/home/%");
+  event_pub_->exclude_paths_.insert("/opt/app/build.log");
+
+  auto sc = event_pub_->createSubscriptionContext();
+  sc->path = "/%%";
+  auto ec = event_pub_->createEventContext();
+  ec->isub_ctx = sc;
+
+  // A single component wildcard followed by a recursive wildcard.
+  ec->path = "/var/lib/cache/a/b/c";
+  EXPECT_FALSE(event_pub_->shouldFire(sc, ec));
+  ec->path = "/var/lib/cache";
+  EXPECT_FALSE(event_pub_->shouldFire(sc, ec));
+  ec->path = "/var/lib/state/cache";
+  EXPECT_TRUE(event_pub_->shouldFire(sc, ec));
+
+  // A trailing single component wildcard.
+  ec->path = "/home/user/.bashrc";
+  EXPECT_FALSE(event_pub_->shouldFire(sc, ec));
+  ec->path = "/homes/user";
+  EXPECT_TRUE(event_pub_->shouldFire(sc, ec));
+
+  // Exact file exclusions do not exclude siblings.
+  ec->path = "/opt/app/build.log";
+  EXPECT_FALSE(event_pub_->shouldFire(sc, ec));
+  ec->path = "/opt/app/run.log";
+  EXPECT_TRUE(event_pub_->shouldFire(sc, ec));
+
+  event_pub_->exclude_paths_.clear();
+  EXPECT_TRUE(event_pub_->exclude_paths_.empty());
+  ec->path = "/home/user/.bashrc";
+  EXPECT_TRUE(event_pub_->shouldFire(sc, ec));
+}
+
+TEST_F(INotifyTests, test_inotify_coalesce_events) {
+  event_pub_ = std::make_shared<INotifyEventPublisher>(true);
+
+  // Space for an event and a short name.
+  alignas(struct inotify_event) char buffer[sizeof(struct inotify_event) + 16];
+  auto event = reinterpret_cast<struct inotify_event*>(buffer);
+  event->wd = 1;
+  event->mask = IN_MODIFY;
+  event->cookie = 0;
+  event->len = 16;
+  std::memset(event->name, 0, 16);
+  std::strcpy(event->name, "file.log");
+
+  // Coalescing is disabled by default.
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1000));
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1000));
+
+  auto window = FLAGS_inotify_coalesce_window;
+  FLAGS_inotify_coalesce_window = 100;
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1000));
+  EXPECT_TRUE(event_pub_->coalesceEvent(event, 1050));
+
+  // A different mask or name is not a duplicate.
+  event->mask = IN_ATTRIB;
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1050));
+  event->mask = IN_MODIFY;
+  std::strcpy(event->name, "other.log");
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1050));
+  std::strcpy(event->name, "file.log");
+
+  // After the window the next duplicate fires again.
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1100));
+  EXPECT_TRUE(event_pub_->coalesceEvent(event, 1150));
+
+  // An event in between with another mask ends the duplicate run.
+  event->mask = IN_CREATE;
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1200));
+  event->mask = IN_DELETE;
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1210));
+  event->mask = IN_CREATE;
+  EXPECT_FALSE(event_pub_->coalesceEvent(event, 1220));
+  EXPECT_TRUE(event_pub_->coalesceEvent(event, 1230));
+
+  event_pub_->expireCoalesced(1400);
+  EXPECT_TRUE(event_pub_->recent_events_.empty());
+  FLAGS_inotify_coalesce_window = window;
+}
+
 class TestINotifyEventSubscriber
     : public EventSubscriber<INotifyEventPublisher> {
  public:
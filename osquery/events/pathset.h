@@ -10,13 +10,13 @@
 
 #pragma once
 
-#include <mutex>
-#include <set>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
-#include <vector>
 
 #include <boost/noncopyable.hpp>
-#include <boost/tokenizer.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include <osquery/core.h>
 #include <osquery/filesystem.h>
@@ -24,12 +24,13 @@
 namespace osquery {
 
 /**
- * @brief multiset based implementation for path search.
+ * @brief Trie based implementation for path search.
  *
- * 'multiset' is used because with patterns we can serach for equivalent keys.
- * Since  '/This/Path/is' ~= '/This/Path/%' ~= '/This/Path/%%' (equivalent).
+ * Patterns are compiled into a tree of path components when inserted. A
+ * lookup walks the tree once per path component, without tokenizing or
+ * copying the searched path.
  *
- * multiset is protected by lock. It is threadsafe.
+ * The tree is protected by lock. It is threadsafe.
  *
  * PathSet can take any of the two policies -
  * 1. patternedPath - Path can contain pattern '%' and '%%'.
@@ -45,114 +46,136 @@ class PathSet : private boost::noncopyable {
   void insert(const std::string& str) {
     auto pattern = str;
     replaceGlobWildcards(pattern);
-    auto vpath = PathType::createVPath(pattern);
 
     WriteLock lock(mset_lock_);
-    for (auto& path : vpath) {
-      paths_.insert(std::move(path));
-    }
+    PathType::insert(root_, pattern);
   }
 
-  bool find(const std::string& str) const {
-    auto path = PathType::createPath(str);
-
+  bool find(boost::string_view str) const {
     ReadLock lock(mset_lock_);
-    if (paths_.find(path) != paths_.end()) {
-      return true;
-    }
-    return false;
+    return PathType::find(root_, str);
   }
 
   void clear() {
     WriteLock lock(mset_lock_);
-    paths_.clear();
+    root_ = Node();
   }
 
   bool empty() const {
     ReadLock lock(mset_lock_);
-    return paths_.empty();
+    return root_.empty();
   }
 
  private:
-  typedef typename PathType::Path Path;
-  typedef typename PathType::Compare Compare;
-  std::multiset<Path, Compare> paths_;
+  typedef typename PathType::Node Node;
+  Node root_;
   mutable Mutex mset_lock_;
 };
 
 class patternedPath {
  public:
-  typedef boost::tokenizer<boost::char_separator<char>> tokenizer;
-  typedef std::vector<std::string> Path;
-  typedef std::vector<Path> VPath;
-  struct Compare {
-    bool operator()(const Path& lhs, const Path& rhs) const {
-      size_t psize = (lhs.size() < rhs.size()) ? lhs.size() : rhs.size();
-      unsigned ndx;
-      for (ndx = 0; ndx < psize; ++ndx) {
-        if (lhs[ndx] == "**" || rhs[ndx] == "**") {
-          return false;
-        }
-
-        if (lhs[ndx] == "*" || rhs[ndx] == "*") {
-          continue;
-        }
-
-        int rc = lhs[ndx].compare(rhs[ndx]);
-
-        if (rc > 0) {
-          return false;
-        }
-
-        if (rc < 0) {
-          return true;
-        }
+  struct Node {
+    /// Literal path components, searchable without a std::string copy.
+    std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+
+    /// The '*' component, matching any single path component.
+    std::unique_ptr<Node> any;
+
+    /// A pattern ends at this component.
+    bool terminal{false};
+
+    /// Any path continuing below this component matches ('**').
+    bool recursive{false};
+
+    bool empty() const {
+      return children.empty() && any == nullptr && !terminal;
+    }
+  };
+
+  static void insert(Node& root, const std::string& str) {
+    if (str == "/") {
+      auto& child = root.children[""];
+      if (child == nullptr) {
+        child = std::make_unique<Node>();
       }
+      child->terminal = true;
+      return;
+    }
 
-      if ((ndx == rhs.size() && rhs[ndx - 1] == "*") ||
-          (ndx == lhs.size() && lhs[ndx - 1] == "*")) {
-        return false;
+    Node* node = &root;
+    bool trailing_any = false;
+    boost::string_view path(str);
+    while (nextComponent(path)) {
+      auto component = takeComponent(path);
+      if (component == "**") {
+        // Both the parent and everything below it match.
+        node->terminal = true;
+        node->recursive = true;
+        return;
       }
 
-      return (lhs.size() < rhs.size());
+      std::unique_ptr<Node>* next = nullptr;
+      if (component == "*") {
+        next = &node->any;
+      } else {
+        next = &node->children[component.to_string()];
+      }
+      if (*next == nullptr) {
+        *next = std::make_unique<Node>();
+      }
+      node = next->get();
+      trailing_any = (component == "*");
     }
-  };
 
-  static Path createPath(const std::string& str) {
-    boost::char_separator<char> sep{"/"};
-    tokenizer tokens(str, sep);
-    Path path;
+    node->terminal = true;
+    // A trailing '*' also matches the contents of the matched component.
+    node->recursive = node->recursive || trailing_any;
+  }
 
+  static bool find(const Node& root, boost::string_view str) {
     if (str == "/") {
-      path.push_back("");
+      auto it = root.children.find("");
+      return root.recursive ||
+             (it != root.children.end() && it->second->terminal);
     }
+    return match(root, str);
+  }
 
-    for (std::string component : tokens) {
-      path.push_back(std::move(component));
+ private:
+  /// Skip separators, return true if another component remains.
+  static bool nextComponent(boost::string_view& path) {
+    auto start = path.find_first_not_of('/');
+    if (start == boost::string_view::npos) {
+      path.clear();
+      return false;
     }
-    return path;
+    path.remove_prefix(start);
+    return true;
+  }
+
+  /// Remove and return the leading component of a separator-trimmed path.
+  static boost::string_view takeComponent(boost::string_view& path) {
+    auto end = path.find('/');
+    auto component = path.substr(0, end);
+    path.remove_prefix(component.size());
+    return component;
   }
 
-  static VPath createVPath(const std::string& str) {
-    boost::char_separator<char> sep{"/"};
-    tokenizer tokens(str, sep);
-    VPath vpath;
-    Path path;
+  static bool match(const Node& node, boost::string_view path) {
+    if (!nextComponent(path)) {
+      return node.terminal;
+    }
 
-    if (str == "/") {
-      path.push_back("");
+    if (node.recursive) {
+      return true;
     }
 
-    for (std::string component : tokens) {
-      if (component == "**") {
-        vpath.push_back(path);
-        path.push_back(std::move(component));
-        break;
-      }
-      path.push_back(std::move(component));
+    auto component = takeComponent(path);
+    auto it = node.children.find(component);
+    if (it != node.children.end() && match(*it->second, path)) {
+      return true;
     }
-    vpath.push_back(std::move(path));
-    return vpath;
+    return node.any != nullptr && match(*node.any, path);
   }
 };
 
@@ -329,6 +329,47 @@ TEST_F(EventsDatabaseTests, test_gentable) {
   EXPECT_LE(6U, keys.size());
 }
 
+TEST_F(EventsDatabaseTests, test_gentable_bounds) {
+  auto sub = std::make_shared<DBFakeEventSubscriber>();
+  sub->doNotExpire();
+  for (size_t i = 1000; i < 1000 + 10; ++i) {
+    sub->testAdd(i);
+  }
+
+  // The upper time bound applies without a lower bound.
+  auto vtc = std::make_unique<VirtualTableContent>();
+  QueryContext context(vtc.get());
+  context.constraints["time"].add(Constraint(LESS_THAN, "1003"));
+  auto results = genRows(sub.get(), context);
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ("1000", results[0]["time"]);
+  EXPECT_EQ("1002", results[2]["time"]);
+
+  // Event IDs are bounded if compared as padded IDs.
+  auto eid = results[1]["eid"];
+  QueryContext eid_context(vtc.get());
+  eid_context.constraints["eid"].add(Constraint(GREATER_THAN_OR_EQUALS, eid));
+  eid_context.constraints["time"].add(Constraint(LESS_THAN_OR_EQUALS, "1003"));
+  results = genRows(sub.get(), eid_context);
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ(eid, results[0]["eid"]);
+
+  // Only the used columns are decoded.
+  QueryContext used_context(vtc.get());
+  used_context.colsUsed = UsedColumns({"time"});
+  used_context.constraints["time"].add(Constraint(EQUALS, "1005"));
+  results = genRows(sub.get(), used_context);
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ(1U, results[0].size());
+  EXPECT_EQ("1005", results[0]["time"]);
+
+  // Contradicting bounds select nothing.
+  QueryContext empty_context(vtc.get());
+  empty_context.constraints["time"].add(Constraint(GREATER_THAN, "1005"));
+  empty_context.constraints["time"].add(Constraint(LESS_THAN, "1004"));
+  EXPECT_TRUE(genRows(sub.get(), empty_context).empty());
+}
+
 TEST_F(EventsDatabaseTests, test_optimize) {
   auto sub = std::make_shared<DBFakeEventSubscriber>();
   for (size_t i = 800; i < 800 + 10; ++i) {
@@ -8,17 +8,25 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #include <boost/filesystem/operations.hpp>
 
 #include <gtest/gtest.h>
 
 #include <osquery/config.h>
 #include <osquery/events.h>
+#include <osquery/flags.h>
 #include <osquery/registry_factory.h>
 #include <osquery/tables.h>
 
 namespace osquery {
 
+DECLARE_uint64(events_dispatch_queue);
+
 class EventsTests : public ::testing::Test {
  public:
   void SetUp() override {
@@ -520,6 +528,83 @@ TEST_F(EventsTests, test_fire_event) {
   EXPECT_TRUE(status.ok());
 }
 
+static std::atomic<size_t> kQueuedBellHathTolled{0};
+static std::mutex kQueuedBellLock;
+static std::condition_variable kQueuedBellRung;
+
+Status TestTheeQueuedCallback(const EventContextRef& ec,
+                              const SubscriptionContextRef& sc) {
+  {
+    std::lock_guard<std::mutex> lock(kQueuedBellLock);
+    kQueuedBellHathTolled += 1;
+  }
+  kQueuedBellRung.notify_all();
+  return Status(0, "OK");
+}
+
+/// Wait for the dispatch thread to deliver, or drop, a number of events.
+static bool waitQueuedBell(const EventSubscriberPlugin& sub, size_t events) {
+  std::unique_lock<std::mutex> lock(kQueuedBellLock);
+  return kQueuedBellRung.wait_for(lock, std::chrono::seconds(5), [&]() {
+    return kQueuedBellHathTolled + sub.numDropped() >= events;
+  });
+}
+
+TEST_F(EventsTests, test_fire_event_queued) {
+  FLAGS_events_dispatch_queue = 2;
+
+  auto pub = std::make_shared<BasicEventPublisher>();
+  pub->setName("BasicPublisher");
+  auto status = EventFactory::registerEventPublisher(pub);
+  ASSERT_TRUE(status.ok());
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  auto subscription = Subscription::create("fake_events");
+  subscription->callback = TestTheeQueuedCallback;
+  status = EventFactory::addSubscription("BasicPublisher", subscription);
+  ASSERT_TRUE(status.ok());
+
+  // Events are delivered on the subscriber's dispatch thread.
+  auto ec = pub->createEventContext();
+  pub->fire(ec, 0);
+  EXPECT_TRUE(waitQueuedBell(*sub, 1));
+  EXPECT_EQ(1U, kQueuedBellHathTolled);
+
+  // Events beyond the queue size are dropped and counted.
+  for (size_t i = 0; i < 100; i++) {
+    pub->fire(ec, 0);
+  }
+  EXPECT_TRUE(waitQueuedBell(*sub, 101));
+  EXPECT_EQ(101U, kQueuedBellHathTolled + sub->numDropped());
+
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(0U, sub->numDropped());
+
+  // A subscriber registered again starts a new dispatch thread.
+  kQueuedBellHathTolled = 0;
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+  subscription = Subscription::create("fake_events");
+  subscription->callback = TestTheeQueuedCallback;
+  status = EventFactory::addSubscription("BasicPublisher", subscription);
+  ASSERT_TRUE(status.ok());
+
+  pub->fire(ec, 0);
+  EXPECT_TRUE(waitQueuedBell(*sub, 1));
+  EXPECT_EQ(1U, kQueuedBellHathTolled);
+
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+
+  status = EventFactory::deregisterEventPublisher(pub->type());
+  EXPECT_TRUE(status.ok());
+  FLAGS_events_dispatch_queue = 0;
+}
+
 class SubFakeEventSubscriber : public FakeEventSubscriber {
  public:
   SubFakeEventSubscriber() : FakeEventSubscriber(true) {
@@ -513,6 +513,11 @@ Status startExtension(const std::string& manager_path,
   rf.setActive("config", options["config_plugin"].value);
   rf.setActive("logger", options["logger_plugin"].value);
   rf.setActive("distributed", options["distributed_plugin"].value);
+  // Send batched database requests only if the core advertises them.
+  auto batches = options.find("database_batch_requests");
+  Flag::updateValue("database_batch_requests",
+                    (batches != options.end()) ? batches->second.value
+                                               : "false");
   // Set up all lazy registry plugins and the active config/logger plugin.
   rf.setUp();
 
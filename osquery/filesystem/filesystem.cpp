@@ -8,12 +8,17 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
 #include <sstream>
 
 #include <fcntl.h>
 #include <sys/stat.h>
 
 #ifndef WIN32
+#include <dirent.h>
 #include <glob.h>
 #include <pwd.h>
 #include <sys/time.h>
@@ -46,6 +51,12 @@ HIDDEN_FLAG(bool, allow_unsafe, false, "Allow unsafe executable permissions");
 /// Disable forensics (atime/mtime preserving) file reads.
 HIDDEN_FLAG(bool, disable_forensic, true, "Disable atime/mtime preservation");
 
+/// Recursive globs may list the directories of each depth concurrently.
+HIDDEN_FLAG(uint64,
+            glob_walk_threads,
+            1,
+            "Threads used to list directories for recursive globs");
+
 static const size_t kMaxRecursiveGlobs = 64;
 
 Status writeTextFile(const fs::path& path,
@@ -270,60 +281,179 @@ Status removePath(const fs::path& path) {
   return Status(0, std::to_string(removed_files));
 }
 
-static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
-  if (path.empty() || path.back() != '/') {
-    return false;
+/// The entries of a directory listed for a recursive glob.
+struct GlobListing {
+  /// The directory identity, used for loop detection (if known).
+  std::pair<uint64_t, uint64_t> id{0, 0};
+
+  /// Entries in glob order, directories include a trailing separator.
+  std::vector<std::string> entries;
+};
+
+static inline bool isGlobDirectory(const std::string& path) {
+  return !path.empty() && (path.back() == '/' || path.back() == '\\');
+}
+
+#ifndef WIN32
+static GlobListing listGlobDirectory(const std::string& dir) {
+  GlobListing listing;
+  auto dp = ::opendir(dir.c_str());
+  if (dp == nullptr) {
+    return listing;
   }
 
-  path.pop_back();
+  // A single stat per directory, following symlinks, identifies loops.
   struct stat d_stat;
-  // On Windows systems (lstat not implemented) this immiedately returns
-  if (!platformLstat(path, d_stat).ok()) {
-    return false;
+  if (::fstat(::dirfd(dp), &d_stat) == 0) {
+    listing.id = std::make_pair(static_cast<uint64_t>(d_stat.st_dev),
+                                static_cast<uint64_t>(d_stat.st_ino));
   }
 
-  if ((d_stat.st_mode & 0170000) == 0) {
-    return false;
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dp)) != nullptr) {
+    // Like a '*' glob, skip hidden entries including '.' and '..'.
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    auto path = dir + entry->d_name;
+    // Only symlinks and unknown types require a stat, as GLOB_MARK would.
+    bool directory = (entry->d_type == DT_DIR);
+    if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+      struct stat e_stat;
+      directory =
+          (::stat(path.c_str(), &e_stat) == 0 && S_ISDIR(e_stat.st_mode));
+    }
+    if (directory) {
+      path += '/';
+    }
+    listing.entries.push_back(std::move(path));
   }
+  ::closedir(dp);
 
-  if (dsym_inos.find(d_stat.st_ino) == dsym_inos.end()) {
-    dsym_inos.insert(d_stat.st_ino);
-  } else {
-    LOG(WARNING) << "Symlink loop detected possibly involving: " << path;
-    return true;
+  std::sort(listing.entries.begin(), listing.entries.end());
+  return listing;
+}
+#else
+static GlobListing listGlobDirectory(const std::string& dir) {
+  GlobListing listing;
+  listing.entries = platformGlob(dir + "*");
+  return listing;
+}
+#endif
+
+static std::vector<GlobListing> listGlobDirectories(
+    const std::vector<std::string>& dirs) {
+  std::vector<GlobListing> listings(dirs.size());
+  auto threads = std::min(static_cast<size_t>(FLAGS_glob_walk_threads),
+                          dirs.size());
+  if (threads <= 1) {
+    for (size_t i = 0; i < dirs.size(); i++) {
+      listings[i] = listGlobDirectory(dirs[i]);
+    }
+    return listings;
+  }
+
+  // Workers take the next unlisted directory, slow directories (such as
+  // network mounts) do not hold up the remaining work.
+  std::atomic<size_t> next{0};
+  std::vector<std::future<void>> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.push_back(
+        std::async(std::launch::async, [&dirs, &listings, &next]() {
+          for (size_t i = next++; i < dirs.size(); i = next++) {
+            listings[i] = listGlobDirectory(dirs[i]);
+          }
+        }));
+  }
+  for (auto& worker : workers) {
+    worker.wait();
+  }
+  return listings;
+}
+
+/// A listed directory and those listed above it, used for loop detection.
+struct GlobAncestor {
+  std::pair<uint64_t, uint64_t> id;
+  std::shared_ptr<const GlobAncestor> parent;
+};
+
+using GlobAncestorRef = std::shared_ptr<const GlobAncestor>;
+
+static bool isGlobLoop(const GlobAncestorRef& ancestor,
+                       const std::pair<uint64_t, uint64_t>& id) {
+  for (auto it = ancestor.get(); it != nullptr; it = it->parent.get()) {
+    if (it->id == id) {
+      return true;
+    }
   }
   return false;
 }
 
-static void genGlobs(std::string path,
-                     std::vector<std::string>& results,
-                     GlobLimits limits) {
-  // Use our helped escape/replace for wildcards.
-  replaceGlobWildcards(path, limits);
-  // inodes of directory symlinks for loop detection
-  std::set<int> dsym_inos;
+/**
+ * @brief Expand a trailing '**' below the first level of glob results.
+ *
+ * Each directory is listed once, depth by depth, instead of re-globbing the
+ * full pattern with another wildcard level. Results keep the order of the
+ * previous level-by-level globbing.
+ */
+static void walkGlobs(const std::vector<std::string>& paths,
+                      std::vector<std::string>& results) {
+  std::vector<std::string> dirs;
+  std::vector<GlobAncestorRef> ancestors;
+  for (const auto& path : paths) {
+    if (isGlobDirectory(path)) {
+      dirs.push_back(path);
+      ancestors.push_back(nullptr);
+    }
+  }
 
-  // Generate a glob set and recurse for double star.
-  for (size_t glob_index = 0; ++glob_index < kMaxRecursiveGlobs;) {
-    auto glob_results = platformGlob(path);
+  for (size_t depth = 1; ++depth < kMaxRecursiveGlobs && !dirs.empty();) {
+    auto listings = listGlobDirectories(dirs);
 
-    for (auto& result_path : glob_results) {
-      results.push_back(result_path);
+    std::vector<std::string> next_dirs;
+    std::vector<GlobAncestorRef> next_ancestors;
+    for (size_t i = 0; i < listings.size(); i++) {
+      auto& listing = listings[i];
+      auto ancestor = ancestors[i];
+      if (listing.id.second != 0) {
+        if (isGlobLoop(ancestor, listing.id)) {
+          LOG(WARNING) << "Symlink loop detected possibly involving: "
+                       << dirs[i];
+          continue;
+        }
+        ancestor = std::make_shared<const GlobAncestor>(
+            GlobAncestor{listing.id, ancestors[i]});
+      }
 
-      if (checkForLoops(dsym_inos, result_path)) {
-        glob_index = kMaxRecursiveGlobs;
+      for (auto& entry : listing.entries) {
+        results.push_back(entry);
+        if (isGlobDirectory(entry)) {
+          next_dirs.push_back(std::move(entry));
+          next_ancestors.push_back(ancestor);
+        }
       }
     }
+    dirs = std::move(next_dirs);
+    ancestors = std::move(next_ancestors);
+  }
+}
 
-    // The end state is a non-recursive ending or empty set of matches.
-    size_t wild = path.rfind("**");
-    // Allow a trailing slash after the double wild indicator.
-    if (glob_results.size() == 0 || wild > path.size() ||
-        wild + 3 < path.size()) {
-      break;
-    }
+static void genGlobs(std::string path,
+                     std::vector<std::string>& results,
+                     GlobLimits limits) {
+  // Use our helped escape/replace for wildcards.
+  replaceGlobWildcards(path, limits);
+
+  // Generate a glob set and walk the matched directories for double star.
+  auto glob_results = platformGlob(path);
+  results.insert(results.end(), glob_results.begin(), glob_results.end());
 
-    path += "/**";
+  // The end state is a non-recursive ending or empty set of matches.
+  size_t wild = path.rfind("**");
+  // Allow a trailing slash after the double wild indicator.
+  if (!glob_results.empty() && wild <= path.size() && wild + 3 >= path.size()) {
+    walkGlobs(glob_results, results);
   }
 
   // Prune results based on settings/requested glob limitations.
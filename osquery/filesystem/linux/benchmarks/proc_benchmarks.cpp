@@ -0,0 +1,73 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/filesystem.h>
+
+#include "osquery/core/conversions.h"
+#include "osquery/filesystem/linux/proc.h"
+
+namespace osquery {
+
+// Scale with the number of processes on the host, run on a host with many
+// processes to compare the per-process cost.
+
+static void PROC_read_files(benchmark::State& state) {
+  std::set<std::string> pids;
+  procProcesses(pids);
+
+  while (state.KeepRunning()) {
+    for (const auto& pid : pids) {
+      std::string content;
+      if (readFile(kLinuxProcPath + "/" + pid + "/stat", content).ok()) {
+        benchmark::DoNotOptimize(split(content, " "));
+      }
+      if (readFile(kLinuxProcPath + "/" + pid + "/status", content).ok()) {
+        for (const auto& line : split(content, "\n")) {
+          benchmark::DoNotOptimize(split(line, ':', 1));
+        }
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pids.size());
+}
+
+BENCHMARK(PROC_read_files);
+
+static void PROC_process_reader(benchmark::State& state) {
+  std::set<std::string> pids;
+  procProcesses(pids);
+
+  ProcProcessReader proc;
+  while (state.KeepRunning()) {
+    for (const auto& pid : pids) {
+      if (!proc.open(pid).ok()) {
+        continue;
+      }
+
+      boost::string_view content;
+      ProcStat stat;
+      if (proc.read("stat", content).ok()) {
+        benchmark::DoNotOptimize(procParseStat(content, stat));
+      }
+      if (proc.read("status", content).ok()) {
+        procParseFields(content,
+                        [](boost::string_view key, boost::string_view value) {
+                          benchmark::DoNotOptimize(value);
+                        });
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pids.size());
+}
+
+BENCHMARK(PROC_process_reader);
+} // namespace osquery
@@ -8,6 +8,9 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <cerrno>
+
+#include <fcntl.h>
 #include <linux/limits.h>
 #include <unistd.h>
 
@@ -341,4 +344,116 @@ Status procReadDescriptor(const std::string& process,
   }
 }
 
+/// Bytes initially reserved for reading a /proc file.
+const size_t kProcReadSize{4096};
+
+ProcProcessReader::~ProcProcessReader() {
+  close();
+}
+
+Status ProcProcessReader::open(const std::string& pid) {
+  close();
+  auto path = kLinuxProcPath + "/" + pid;
+  fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_ < 0) {
+    return Status(1, "Cannot open " + path);
+  }
+  return Status(0);
+}
+
+void ProcProcessReader::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+Status ProcProcessReader::read(const char* name, boost::string_view& content) {
+  content.clear();
+  auto fd = ::openat(fd_, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status(1, std::string("Cannot open ") + name);
+  }
+
+  // Files in /proc report a size of zero, read until the end.
+  if (buffer_.size() < kProcReadSize) {
+    buffer_.resize(kProcReadSize);
+  }
+  size_t size = 0;
+  while (true) {
+    if (size == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    auto bytes = ::read(fd, buffer_.data() + size, buffer_.size() - size);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      ::close(fd);
+      if (bytes < 0) {
+        return Status(1, std::string("Cannot read ") + name);
+      }
+      break;
+    }
+    size += static_cast<size_t>(bytes);
+  }
+
+  content = boost::string_view(buffer_.data(), size);
+  return Status(0);
+}
+
+Status ProcProcessReader::readLink(const char* name, std::string& target) {
+  char link[PATH_MAX];
+  auto size = ::readlinkat(fd_, name, link, sizeof(link));
+  if (size <= 0) {
+    return Status(1, std::string("Cannot read link ") + name);
+  }
+  target.assign(link, static_cast<size_t>(size));
+  return Status(0);
+}
+
+boost::string_view procNextToken(boost::string_view& content) {
+  size_t start = 0;
+  while (start < content.size() &&
+         std::isspace(static_cast<unsigned char>(content[start]))) {
+    start++;
+  }
+  auto end = start;
+  while (end < content.size() &&
+         !std::isspace(static_cast<unsigned char>(content[end]))) {
+    end++;
+  }
+  auto token = content.substr(start, end - start);
+  content.remove_prefix(end);
+  return token;
+}
+
+Status procParseStat(boost::string_view content, ProcStat& stat) {
+  // The command name may contain spaces and parentheses, skip to the last.
+  auto start = content.rfind(')');
+  if (start == boost::string_view::npos || content.size() <= start + 2) {
+    return Status(1, "Invalid /proc/stat header");
+  }
+  content.remove_prefix(start + 2);
+
+  // Fields are numbered following the command name, starting with the state.
+  boost::string_view fields[20];
+  for (auto& field : fields) {
+    field = procNextToken(content);
+    if (field.empty()) {
+      return Status(1, "Invalid /proc/stat content");
+    }
+  }
+
+  stat.state = fields[0];
+  stat.parent = fields[1];
+  stat.group = fields[2];
+  stat.user_time = fields[11];
+  stat.system_time = fields[12];
+  stat.nice = fields[16];
+  stat.threads = fields[17];
+  stat.start_time = fields[19];
+  return Status(0);
+}
+
 } // namespace osquery
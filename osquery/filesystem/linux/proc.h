@@ -10,13 +10,17 @@
 
 #pragma once
 
+#include <cctype>
 #include <unordered_map>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <linux/limits.h>
 #include <unistd.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include <osquery/filesystem.h>
 #include <osquery/logger.h>
@@ -95,6 +99,94 @@ std::string procDecodeAddressFromHex(const std::string& encoded_address,
 
 unsigned short procDecodePortFromHex(const std::string& encoded_port);
 
+/**
+ * @brief Read the files of a single process under /proc/<pid>.
+ *
+ * The process directory is opened once and each file is opened relative to
+ * it. If the process exits, later reads fail rather than reading the files of
+ * a new process reusing the pid. File content is read into a buffer owned by
+ * the reader, which is reused for every file and every process.
+ */
+class ProcProcessReader : private boost::noncopyable {
+ public:
+  ProcProcessReader() = default;
+  ~ProcProcessReader();
+
+  /// Open the directory of a process, closing the previous process.
+  Status open(const std::string& pid);
+
+  /// Close the directory of the current process.
+  void close();
+
+  /**
+   * @brief Read a file of the current process, such as "stat".
+   *
+   * The content remains valid until the next read.
+   */
+  Status read(const char* name, boost::string_view& content);
+
+  /// Read the target of a symlink of the current process, such as "exe".
+  Status readLink(const char* name, std::string& target);
+
+ private:
+  /// The /proc/<pid> directory of the current process.
+  int fd_{-1};
+
+  /// Content of the last file read.
+  std::vector<char> buffer_;
+};
+
+/// Fields of /proc/<pid>/stat, the values point into the file content.
+struct ProcStat {
+  boost::string_view state;
+  boost::string_view parent;
+  boost::string_view group;
+  boost::string_view user_time;
+  boost::string_view system_time;
+  boost::string_view nice;
+  boost::string_view threads;
+  boost::string_view start_time;
+};
+
+/// Parse the fields following the command name in /proc/<pid>/stat.
+Status procParseStat(boost::string_view content, ProcStat& stat);
+
+/// Remove and return the first whitespace-delimited token of content.
+boost::string_view procNextToken(boost::string_view& content);
+
+/**
+ * @brief Call visit(key, value) for each "Key: Value" line of content.
+ *
+ * This parses /proc/<pid>/status and /proc/<pid>/io without copying. Values
+ * are trimmed of whitespace, and lines without a value are skipped.
+ */
+template <typename Visitor>
+void procParseFields(boost::string_view content, Visitor visit) {
+  while (!content.empty()) {
+    auto end = content.find('\n');
+    auto line = content.substr(0, end);
+    content.remove_prefix(end == boost::string_view::npos ? content.size()
+                                                          : end + 1);
+
+    auto delim = line.find(':');
+    if (delim == boost::string_view::npos) {
+      continue;
+    }
+    auto value = line.substr(delim + 1);
+    while (!value.empty() &&
+           std::isspace(static_cast<unsigned char>(value.front()))) {
+      value.remove_prefix(1);
+    }
+    while (!value.empty() &&
+           std::isspace(static_cast<unsigned char>(value.back()))) {
+      value.remove_suffix(1);
+    }
+    if (delim > 0 && !value.empty()) {
+      visit(line.substr(0, delim), value);
+    }
+  }
+}
+
 /**
  * @brief Construct a map of socket inode number to socket information collected
  * from /proc/<pid>/net for a certain family and protocol under a certain pid.
@@ -0,0 +1,88 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/core.h>
+
+#include "osquery/filesystem/linux/proc.h"
+
+namespace osquery {
+
+class ProcTests : public testing::Test {};
+
+TEST_F(ProcTests, test_parse_stat) {
+  ProcStat stat;
+  std::string content =
+      "42 (a (b) c) S 1 42 42 0 -1 4194560 100 0 0 0 7 3 0 0 20 0 4 0 "
+      "1234 0 0\n";
+  ASSERT_TRUE(procParseStat(content, stat).ok());
+  EXPECT_EQ(stat.state, "S");
+  EXPECT_EQ(stat.parent, "1");
+  EXPECT_EQ(stat.group, "42");
+  EXPECT_EQ(stat.user_time, "7");
+  EXPECT_EQ(stat.system_time, "3");
+  EXPECT_EQ(stat.nice, "0");
+  EXPECT_EQ(stat.threads, "4");
+  EXPECT_EQ(stat.start_time, "1234");
+
+  // The stat content is truncated.
+  EXPECT_FALSE(procParseStat("42 (a) S 1 42 42 0", stat).ok());
+  EXPECT_FALSE(procParseStat("42 (a", stat).ok());
+}
+
+TEST_F(ProcTests, test_parse_fields) {
+  std::string content =
+      "Name:\tosqueryd\nUmask:\t0022\nUid:\t0\t1\t2\t3\nEmpty:\t\n"
+      "VmRSS:\t    1024 kB";
+
+  std::map<std::string, std::string> fields;
+  procParseFields(content,
+                  [&fields](boost::string_view key, boost::string_view value) {
+                    fields[key.to_string()] = value.to_string();
+                  });
+  EXPECT_EQ(fields.size(), 4U);
+  EXPECT_EQ(fields["Name"], "osqueryd");
+  EXPECT_EQ(fields["Uid"], "0\t1\t2\t3");
+  EXPECT_EQ(fields["VmRSS"], "1024 kB");
+  EXPECT_EQ(fields.count("Empty"), 0U);
+
+  boost::string_view ids(fields["Uid"]);
+  EXPECT_EQ(procNextToken(ids), "0");
+  EXPECT_EQ(procNextToken(ids), "1");
+  EXPECT_EQ(ids, "\t2\t3");
+}
+
+TEST_F(ProcTests, test_process_reader) {
+  ProcProcessReader proc;
+  ASSERT_TRUE(proc.open(std::to_string(getpid())).ok());
+
+  boost::string_view content;
+  ASSERT_TRUE(proc.read("stat", content).ok());
+  ProcStat stat;
+  EXPECT_TRUE(procParseStat(content, stat).ok());
+  EXPECT_EQ(stat.parent, std::to_string(getppid()));
+
+  // Files larger than the initial buffer are read completely.
+  ASSERT_TRUE(proc.read("maps", content).ok());
+  ASSERT_FALSE(content.empty());
+  EXPECT_EQ(content.back(), '\n');
+
+  std::string exe;
+  EXPECT_TRUE(proc.readLink("exe", exe).ok());
+  EXPECT_FALSE(exe.empty());
+  EXPECT_FALSE(proc.read("missing", content).ok());
+
+  // Reads fail once the process directory is closed.
+  proc.close();
+  EXPECT_FALSE(proc.read("stat", content).ok());
+  EXPECT_FALSE(proc.open("0").ok());
+}
+} // namespace osquery
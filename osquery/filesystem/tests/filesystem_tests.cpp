@@ -34,6 +34,7 @@ namespace fs = boost::filesystem;
 namespace osquery {
 
 DECLARE_uint64(read_max);
+DECLARE_uint64(glob_walk_threads);
 
 class FilesystemTests : public testing::Test {
  protected:
@@ -325,6 +326,47 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+TEST_F(FilesystemTests, test_wildcard_double_threads) {
+  std::vector<std::string> serial;
+  resolveFilePattern(kFakeDirectory + "/%%", serial);
+
+  auto threads = FLAGS_glob_walk_threads;
+  FLAGS_glob_walk_threads = 4;
+  std::vector<std::string> results;
+  resolveFilePattern(kFakeDirectory + "/%%", results);
+  FLAGS_glob_walk_threads = threads;
+
+  // Concurrent directory listing does not change the results or their order.
+  EXPECT_EQ(results, serial);
+}
+
+#ifndef WIN32
+TEST_F(FilesystemTests, test_wildcard_double_loop) {
+  std::vector<std::string> expected;
+  resolveFilePattern(kFakeDirectory + "/%%", expected);
+  expected.push_back(kFakeDirectory + "/deep1/deep2/loop/");
+
+  boost::system::error_code ec;
+  fs::create_directory_symlink(
+      kFakeDirectory + "/deep1", kFakeDirectory + "/deep1/deep2/loop", ec);
+  ASSERT_FALSE(ec);
+
+  std::vector<std::string> results;
+  auto status = resolveFilePattern(kFakeDirectory + "/%%", results);
+  EXPECT_TRUE(status.ok());
+
+  // The symlink is included but the walk does not descend into the loop.
+  EXPECT_TRUE(contains(results, kFakeDirectory + "/deep1/deep2/loop/"));
+  EXPECT_FALSE(
+      contains(results, kFakeDirectory + "/deep1/deep2/loop/level1.txt"));
+
+  // Otherwise the results are those of the fixture without the symlink.
+  std::sort(expected.begin(), expected.end());
+  std::sort(results.begin(), results.end());
+  EXPECT_EQ(results, expected);
+}
+#endif
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(kFakeDirectory + "/%11/%sh", results);
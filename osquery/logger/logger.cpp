@@ -447,7 +447,12 @@ Status logString(const std::string& message,
 
 namespace {
 const std::string kTotalQueryCounterMonitorPath("query.total.count");
+
+const monitoring::Metric& totalQueryCounter() {
+  static const monitoring::Metric metric(kTotalQueryCounterMonitorPath);
+  return metric;
 }
+} // namespace
 
 Status logQueryLogItem(const QueryLogItem& results) {
   return logQueryLogItem(results, RegistryFactory::get().getActive("logger"));
@@ -460,8 +465,7 @@ Status logQueryLogItem(const QueryLogItem& results,
   }
 
   if (Killswitch::get().isTotalQueryCounterMonitorEnabled()) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
+    totalQueryCounter().record(1);
   }
 
   std::vector<std::string> json_items;
@@ -489,8 +493,7 @@ Status logSnapshotQuery(const QueryLogItem& item) {
   }
 
   if (Killswitch::get().isTotalQueryCounterMonitorEnabled()) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
+    totalQueryCounter().record(1);
   }
 
   std::vector<std::string> json_items;
@@ -10,6 +10,8 @@
 
 #include <algorithm>
 #include <chrono>
+#include <future>
+#include <iterator>
 #include <thread>
 
 #include <boost/property_tree/json_parser.hpp>
@@ -21,6 +23,7 @@
 #include <osquery/system.h>
 
 #include "osquery/config/parsers/decorators.h"
+#include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
 #include "osquery/logger/plugins/buffered.h"
 
@@ -33,68 +36,84 @@ FLAG(uint64,
      1000000,
      "Maximum number of logs in buffered output plugins (0 = unlimited)");
 
+FLAG(uint64,
+     buffered_log_inflight,
+     1,
+     "Number of log batches buffered output plugins send concurrently");
+
 const std::chrono::seconds BufferedLogForwarder::kLogPeriod{
     std::chrono::seconds(4)};
 const size_t BufferedLogForwarder::kMaxLogLines{1024};
+const size_t BufferedLogForwarder::kIndexWidth{20};
 
 Status BufferedLogForwarder::setUp() {
-  // initialize buffer_count_ by scanning the DB
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, 0);
+  RecursiveLock lock(count_mutex_);
+  // The buffer count is stored alongside the buffered logs.
+  std::string count;
+  if (getDatabaseValue(kLogs, genCountKey(), count).ok()) {
+    auto value = tryTo<unsigned long long>(count);
+    if (value) {
+      buffer_count_ = value.take();
+      return Status(0);
+    }
+  }
 
+  // Logs buffered before the count was stored are counted once, and their
+  // unpadded indexes are rewritten so they sort in the order they were made.
+  std::vector<std::string> indexes;
+  auto status = scanDatabaseKeys(kLogs, indexes, index_name_ + '_', 0);
   if (!status.ok()) {
     return Status(1, "Error scanning for buffered log count");
   }
 
-  RecursiveLock lock(count_mutex_);
-  buffer_count_ = indexes.size();
-  return Status(0);
+  size_t buffer_count = 0;
+  iterate(indexes, [this, &buffer_count](std::string& index) {
+    if (!isResultIndex(index) && !isStatusIndex(index)) {
+      return;
+    }
+
+    buffer_count++;
+    if (!isPaddedIndex(index)) {
+      auto migrated = migrateIndex(index);
+      if (!migrated.ok()) {
+        VLOG(1) << "Cannot migrate buffered log index " << index << ": "
+                << migrated.getMessage();
+      }
+    }
+  });
+
+  buffer_count_ = buffer_count;
+  return setDatabaseValue(kLogs, genCountKey(), std::to_string(buffer_count_));
 }
 
 void BufferedLogForwarder::check() {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  // Get a list of the oldest buffered log items, enough to fill each of the
+  // in-flight batches with up to max_log_lines_ lines.
+  size_t inflight = std::max<size_t>(1, FLAGS_buffered_log_inflight);
+  DatabaseScanRange range;
+  range.prefix = index_name_ + '_';
+  range.max = max_log_lines_ * inflight;
+  DatabaseStringValueList lines;
+  scanDatabaseValues(kLogs, range, lines);
 
   // For each index, accumulate the log line into the result or status set.
+  std::vector<std::string> result_indexes, status_indexes;
   std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.emplace_back(std::move(value));
-            }
-          }));
+  for (auto& line : lines) {
+    bool is_result = isResultIndex(line.first);
+    auto& target = is_result ? results : statuses;
+    auto& target_indexes = is_result ? result_indexes : status_indexes;
+    target.emplace_back(std::move(line.second));
+    target_indexes.emplace_back(std::move(line.first));
+  }
 
   // If any results/statuses were found in the flushed buffer, send.
   if (results.size() > 0) {
-    status = send(results, "result");
-    if (!status.ok()) {
-      VLOG(1) << "Error sending results to logger: " << status.getMessage();
-    } else {
-      // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
-    }
+    sendBatches(results, result_indexes, "result");
   }
 
   if (statuses.size() > 0) {
-    status = send(statuses, "status");
-    if (!status.ok()) {
-      VLOG(1) << "Error sending status to logger: " << status.getMessage();
-    } else {
-      // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
-    }
+    sendBatches(statuses, status_indexes, "status");
   }
 
   // Purge any logs exceeding the max after our send attempt
@@ -103,6 +122,51 @@ void BufferedLogForwarder::check() {
   }
 }
 
+void BufferedLogForwarder::sendBatches(std::vector<std::string>& log_data,
+                                       std::vector<std::string>& indexes,
+                                       const std::string& log_type) {
+  // Split the lines, and their indexes, into batches of at most
+  // max_log_lines_.
+  std::vector<std::vector<std::string>> batches;
+  std::vector<std::vector<std::string>> batch_indexes;
+  for (size_t i = 0; i < log_data.size(); i += max_log_lines_) {
+    size_t last = std::min(i + max_log_lines_, log_data.size());
+    batches.emplace_back(std::make_move_iterator(log_data.begin() + i),
+                         std::make_move_iterator(log_data.begin() + last));
+    batch_indexes.emplace_back(std::make_move_iterator(indexes.begin() + i),
+                               std::make_move_iterator(indexes.begin() + last));
+  }
+
+  std::vector<Status> statuses(batches.size());
+  if (batches.size() == 1) {
+    statuses[0] = send(batches[0], log_type);
+  } else {
+    // Several batches may be in flight to the remote endpoint at once.
+    std::vector<std::future<Status>> sends;
+    for (auto& batch : batches) {
+      sends.push_back(
+          std::async(std::launch::async, [this, &batch, &log_type]() {
+            return send(batch, log_type);
+          }));
+    }
+    for (size_t i = 0; i < sends.size(); i++) {
+      statuses[i] = sends[i].get();
+    }
+  }
+
+  for (size_t i = 0; i < batches.size(); i++) {
+    if (!statuses[i].ok()) {
+      VLOG(1) << "Error sending " << log_type
+              << " to logger: " << statuses[i].getMessage();
+      continue;
+    }
+
+    // Clear the logs once they were sent, only the indexes in the batch are
+    // removed as others may have been written between them.
+    deleteValuesWithCount(batch_indexes[i]);
+  }
+}
+
 void BufferedLogForwarder::purge() {
   RecursiveLock lock(count_mutex_);
   if (buffer_count_ <= FLAGS_buffered_log_max) {
@@ -112,35 +176,38 @@ void BufferedLogForwarder::purge() {
   size_t purge_count = buffer_count_ - FLAGS_buffered_log_max;
 
   // Collect purge_count indexes of each type (result/status) before
-  // partitioning to find the oldest. Note this assumes that the indexes are
-  // returned in ascending lexicographic order (true for RocksDB).
+  // partitioning to find the oldest. The scans seek to each prefix and stop
+  // after purge_count indexes, they do not visit the whole backlog.
   std::vector<std::string> indexes;
-  auto status =
-      scanDatabaseKeys(kLogs, indexes, genIndexPrefix(true), purge_count);
-  if (!status.ok()) {
-    LOG(ERROR) << "Error scanning DB during buffered log purge";
-    return;
-  }
-
-  LOG(WARNING) << "Purging buffered logs limit (" << FLAGS_buffered_log_max
-               << ") exceeded: " << buffer_count_;
+  for (bool results : {true, false}) {
+    DatabaseScanRange range;
+    range.prefix = genIndexPrefix(results);
+    range.max = purge_count;
+    DatabaseStringValueList lines;
+    auto status = scanDatabaseValues(kLogs, range, lines);
+    if (!status.ok()) {
+      LOG(ERROR) << "Error scanning DB during buffered log purge";
+      return;
+    }
 
-  std::vector<std::string> status_indexes;
-  status = scanDatabaseKeys(
-      kLogs, status_indexes, genIndexPrefix(false), purge_count);
-  if (!status.ok()) {
-    LOG(ERROR) << "Error scanning DB during buffered log purge";
-    return;
+    for (auto& line : lines) {
+      indexes.push_back(std::move(line.first));
+    }
   }
 
-  indexes.insert(indexes.end(), status_indexes.begin(), status_indexes.end());
-
   if (indexes.size() < purge_count) {
+    // The stored count is ahead of the backlog, for example after a crash
+    // between removing logs and storing the count. Every log was found.
     LOG(ERROR) << "Trying to purge " << purge_count << " logs but only found "
                << indexes.size();
+    buffer_count_ = indexes.size();
+    setDatabaseValue(kLogs, genCountKey(), std::to_string(buffer_count_));
     return;
   }
 
+  LOG(WARNING) << "Purging buffered logs limit (" << FLAGS_buffered_log_max
+               << ") exceeded: " << buffer_count_;
+
   size_t prefix_size = genIndexPrefix(true).size();
   // Partition the indexes so that the first purge_count elements are the
   // oldest indexes (the ones to be purged)
@@ -158,11 +225,9 @@ void BufferedLogForwarder::purge() {
   indexes.erase(indexes.begin() + purge_count, indexes.end());
 
   // Now only indexes of logs to be deleted remain
-  iterate(indexes, [this](const std::string& index) {
-    if (!deleteValueWithCount(kLogs, index).ok()) {
-      LOG(ERROR) << "Error deleting value during buffered log purge";
-    }
-  });
+  if (!deleteValuesWithCount(indexes).ok()) {
+    LOG(ERROR) << "Error deleting values during buffered log purge";
+  }
 }
 
 void BufferedLogForwarder::start() {
@@ -176,7 +241,7 @@ void BufferedLogForwarder::start() {
 
 Status BufferedLogForwarder::logString(const std::string& s, size_t time) {
   std::string index = genResultIndex(time);
-  return addValueWithCount(kLogs, index, s);
+  return addValueWithCount(index, s);
 }
 
 Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
@@ -221,7 +286,7 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
       json.pop_back();
     }
     std::string index = genStatusIndex(time);
-    Status status = addValueWithCount(kLogs, index, json);
+    Status status = addValueWithCount(index, json);
     if (!status.ok()) {
       // Do not continue if any line fails.
       return status;
@@ -260,29 +325,80 @@ std::string BufferedLogForwarder::genIndex(bool results, size_t time) {
   if (time == 0) {
     time = getUnixTime();
   }
-  return genIndexPrefix(results) + std::to_string(time) + '_' +
-         std::to_string(++log_index_);
+  return genIndexPrefix(results) + padIndex(time) + '_' +
+         padIndex(++log_index_);
+}
+
+std::string BufferedLogForwarder::padIndex(size_t value) {
+  auto padded = std::to_string(value);
+  if (padded.size() < kIndexWidth) {
+    padded.insert(0, kIndexWidth - padded.size(), '0');
+  }
+  return padded;
+}
+
+bool BufferedLogForwarder::isPaddedIndex(const std::string& index) {
+  return index.size() == genIndexPrefix(true).size() + kIndexWidth * 2 + 1;
+}
+
+std::string BufferedLogForwarder::genCountKey() {
+  // The separator differs from indexes so the count is not scanned as a log.
+  return index_name_ + ".count";
+}
+
+Status BufferedLogForwarder::migrateIndex(const std::string& index) {
+  // An unpadded index is the index prefix followed by "<time>_<counter>".
+  size_t prefix_size = genIndexPrefix(true).size();
+  auto separator = index.find('_', prefix_size);
+  if (separator == std::string::npos) {
+    return Status(1, "Invalid index");
+  }
+
+  auto time = tryTo<unsigned long long>(
+      index.substr(prefix_size, separator - prefix_size));
+  auto counter = tryTo<unsigned long long>(index.substr(separator + 1));
+  if (!time || !counter) {
+    return Status(1, "Invalid index");
+  }
+
+  std::string value;
+  auto status = getDatabaseValue(kLogs, index, value);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto padded = index.substr(0, prefix_size) + padIndex(time.take()) + '_' +
+                padIndex(counter.take());
+  status = setDatabaseValue(kLogs, padded, value);
+  if (!status.ok()) {
+    return status;
+  }
+  return deleteDatabaseValue(kLogs, index);
 }
 
-Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
-                                               const std::string& key,
+Status BufferedLogForwarder::addValueWithCount(const std::string& key,
                                                const std::string& value) {
-  Status status = setDatabaseValue(domain, key, value);
+  // Store the count with the value so the two cannot drift apart.
+  RecursiveLock lock(count_mutex_);
+  Status status = setDatabaseBatch(
+      kLogs,
+      {std::make_pair(key, value),
+       std::make_pair(genCountKey(), std::to_string(buffer_count_ + 1))});
   if (status.ok()) {
-    RecursiveLock lock(count_mutex_);
     buffer_count_++;
   }
   return status;
 }
 
-Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
-                                                  const std::string& key) {
-  Status status = deleteDatabaseValue(domain, key);
+Status BufferedLogForwarder::deleteValuesWithCount(
+    const std::vector<std::string>& keys) {
+  Status status = deleteDatabaseValues(kLogs, keys);
   if (status.ok()) {
     RecursiveLock lock(count_mutex_);
-    if (buffer_count_ > 0) {
-      buffer_count_--;
-    }
+    buffer_count_ =
+        (buffer_count_ > keys.size()) ? buffer_count_ - keys.size() : 0;
+    status =
+        setDatabaseValue(kLogs, genCountKey(), std::to_string(buffer_count_));
   }
   return status;
 }
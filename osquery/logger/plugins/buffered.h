@@ -53,6 +53,9 @@ class BufferedLogForwarder : public InternalRunnable {
   static const std::chrono::seconds kLogPeriod;
   static const size_t kMaxLogLines;
 
+  /// Width of the zero-padded numeric components of a buffered log index.
+  static const size_t kIndexWidth;
+
  protected:
   // These constructors are made available for subclasses to use, but
   // subclasses should expose appropriate constructors to their users.
@@ -134,12 +137,24 @@ class BufferedLogForwarder : public InternalRunnable {
   /**
    * @brief Check for new logs and send.
    *
-   * Scan the logs domain for up to max_log_lines_ log lines.
-   * Sort those lines into status and request types then forward (send) each
-   * set. On success, clear the data and indexes. Calls purge upon completion.
+   * Scan the logs domain for up to max_log_lines_ log lines per in-flight
+   * batch. Sort those lines into status and request types then forward (send)
+   * each set. On success, clear the data and indexes. Calls purge upon
+   * completion.
    */
   void check();
 
+  /**
+   * @brief Send a set of log lines of one type in one or more batches.
+   *
+   * Batches hold at most max_log_lines_ lines and are sent concurrently when
+   * the buffered_log_inflight flag allows. The indexes of each acknowledged
+   * batch are removed with a single batched delete.
+   */
+  void sendBatches(std::vector<std::string>& log_data,
+                   std::vector<std::string>& indexes,
+                   const std::string& log_type);
+
   /**
    * @brief Purge the oldest logs, if the max is exceeded
    *
@@ -172,20 +187,31 @@ class BufferedLogForwarder : public InternalRunnable {
 
   std::string genIndex(bool results, size_t time = 0);
 
+  /// Zero-pad an index component so indexes sort in the order they are made.
+  std::string padIndex(size_t value);
+
+  /// Return whether the index was generated with zero-padded components.
+  bool isPaddedIndex(const std::string& index);
+
+  /// Key storing the count of buffered logs in the logs domain.
+  std::string genCountKey();
+
+  /// Rewrite a log buffered with an unpadded index to a zero-padded index.
+  Status migrateIndex(const std::string& index);
+
   /**
-   * @brief Add a database value while maintaining count
+   * @brief Add a log while maintaining count
    *
+   * The log and the updated count are written in a single batch.
    */
-  Status addValueWithCount(const std::string& domain,
-                           const std::string& key,
-                           const std::string& value);
+  Status addValueWithCount(const std::string& key, const std::string& value);
 
   /**
-   * @brief Delete a database value while maintaining count
+   * @brief Delete a list of logs while maintaining count
    *
+   * Only the given keys are removed, then the updated count is stored.
    */
-  Status deleteValueWithCount(const std::string& domain,
-                              const std::string& key);
+  Status deleteValuesWithCount(const std::vector<std::string>& keys);
 
  protected:
   /// Seconds between flushing logs
@@ -17,6 +17,7 @@
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <osquery/database.h>
 #include <osquery/dispatcher.h>
 #include <osquery/logger.h>
 #include <osquery/system.h>
@@ -31,6 +32,7 @@ namespace pt = boost::property_tree;
 namespace osquery {
 
 DECLARE_uint64(buffered_log_max);
+DECLARE_uint64(buffered_log_inflight);
 
 // Check that the string matches the StatusLogLine
 MATCHER_P(MatchesStatus, expected, "") {
@@ -93,6 +95,10 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
   FRIEND_TEST(BufferedLogForwarderTests, test_multiple);
   FRIEND_TEST(BufferedLogForwarderTests, test_async);
   FRIEND_TEST(BufferedLogForwarderTests, test_split);
+  FRIEND_TEST(BufferedLogForwarderTests, test_inflight);
+  FRIEND_TEST(BufferedLogForwarderTests, test_sent_only);
+  FRIEND_TEST(BufferedLogForwarderTests, test_count);
+  FRIEND_TEST(BufferedLogForwarderTests, test_migrate);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge_max);
 
@@ -103,10 +109,10 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
 TEST_F(BufferedLogForwarderTests, test_index) {
   MockBufferedLogForwarder runner;
   if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_1"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_2"));
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_3"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_4"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_0+1"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_0+2"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_0+3"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_0+4"));
   }
 
   EXPECT_TRUE(runner.isResultIndex(runner.genResultIndex()));
@@ -290,6 +296,102 @@ TEST_F(BufferedLogForwarderTests, test_split) {
   runner2.check();
 }
 
+// Verify that several batches may be sent per check and acknowledged alone
+TEST_F(BufferedLogForwarderTests, test_inflight) {
+  FLAGS_buffered_log_inflight = 2;
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 2);
+  runner.logString("foo");
+  runner.logString("bar");
+  runner.logString("baz");
+  runner.logString("qux");
+  runner.logString("quux");
+
+  // The first two batches are in flight together, the second fails.
+  EXPECT_CALL(runner, send(ElementsAre("foo", "bar"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("baz", "qux"), "result"))
+      .WillOnce(Return(Status(1, "fail")));
+  runner.check();
+
+  // Only the acknowledged batch was removed.
+  EXPECT_CALL(runner, send(ElementsAre("baz", "qux"), "result"))
+      .WillOnce(Return(Status(0)));
+  EXPECT_CALL(runner, send(ElementsAre("quux"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.check();
+  FLAGS_buffered_log_inflight = 1;
+}
+
+// Verify that a log written between the indexes of a batch is not removed
+TEST_F(BufferedLogForwarderTests, test_sent_only) {
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 100);
+  size_t time = getUnixTime();
+  runner.logString("foo", time);
+  runner.logString("baz", time + 2);
+
+  // While the batch is in flight a log sorting between its indexes arrives.
+  EXPECT_CALL(runner, send(ElementsAre("foo", "baz"), "result"))
+      .WillOnce(DoAll(InvokeWithoutArgs([&runner, time]() {
+                        runner.logString("bar", time + 1);
+                      }),
+                      Return(Status(0))));
+  runner.check();
+  EXPECT_EQ(1U, runner.buffer_count_);
+
+  EXPECT_CALL(runner, send(ElementsAre("bar"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  EXPECT_EQ(0U, runner.buffer_count_);
+
+  runner.check();
+}
+
+// Verify that the buffer count is stored and restored by setUp
+TEST_F(BufferedLogForwarderTests, test_count) {
+  StrictMock<MockBufferedLogForwarder> runner("count");
+  runner.logString("foo");
+  runner.logString("bar");
+  runner.logString("baz");
+
+  StrictMock<MockBufferedLogForwarder> restarted("count");
+  ASSERT_TRUE(restarted.setUp().ok());
+  EXPECT_EQ(3U, restarted.buffer_count_);
+
+  EXPECT_CALL(restarted, send(ElementsAre("foo", "bar", "baz"), "result"))
+      .WillOnce(Return(Status(0)));
+  restarted.check();
+  EXPECT_EQ(0U, restarted.buffer_count_);
+
+  std::string count;
+  getDatabaseValue(kLogs, restarted.genCountKey(), count);
+  EXPECT_EQ("0", count);
+}
+
+// Verify that logs buffered with unpadded indexes are counted and sent in
+// the order they were written
+TEST_F(BufferedLogForwarderTests, test_migrate) {
+  StrictMock<MockBufferedLogForwarder> runner("migrate");
+  deleteDatabaseValue(kLogs, runner.genCountKey());
+  setDatabaseValue(kLogs, "migrate_r_10_2", "bar");
+  setDatabaseValue(kLogs, "migrate_r_9_1", "foo");
+
+  ASSERT_TRUE(runner.setUp().ok());
+  EXPECT_EQ(2U, runner.buffer_count_);
+
+  std::string value;
+  EXPECT_FALSE(getDatabaseValue(kLogs, "migrate_r_9_1", value).ok() &&
+               !value.empty());
+
+  EXPECT_CALL(runner, send(ElementsAre("foo", "bar"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  EXPECT_EQ(0U, runner.buffer_count_);
+
+  runner.check();
+}
+
 // Test the purge() function independently of check()
 TEST_F(BufferedLogForwarderTests, test_purge) {
   FLAGS_buffered_log_max = 3;
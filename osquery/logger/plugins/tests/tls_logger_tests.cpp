@@ -16,6 +16,7 @@
 #include "osquery/tests/test_additional_util.h"
 #include "osquery/tests/test_util.h"
 
+#include "osquery/core/json.h"
 #include "osquery/logger/plugins/tls_logger.h"
 
 namespace osquery {
@@ -25,6 +26,13 @@ class TLSLoggerTests : public testing::Test {
   void runCheck(const std::shared_ptr<TLSLogForwarder>& runner) {
     runner->check();
   }
+
+  void spliceLogLines(const std::string& node_key,
+                      const std::string& log_type,
+                      std::vector<std::string>& log_data,
+                      std::string& body) {
+    TLSLogForwarder::spliceLogLines(node_key, log_type, log_data, body);
+  }
 };
 
 TEST_F(TLSLoggerTests, test_database) {
@@ -76,4 +84,40 @@ TEST_F(TLSLoggerTests, test_send) {
   TLSServerRunner::unsetClientConfig();
   TLSServerRunner::stop();
 }
+
+TEST_F(TLSLoggerTests, test_splice_log_lines) {
+  std::vector<std::string> log_data = {
+      "{\"a\":1}", "not json", "", "{\"b\":\"c\"}"};
+
+  std::string body;
+  spliceLogLines("key", "result", log_data, body);
+  EXPECT_EQ(
+      "{\"node_key\":\"key\",\"log_type\":\"result\","
+      "\"data\":[{\"a\":1},{\"b\":\"c\"}]}",
+      body);
+
+  // The spliced body must be valid JSON.
+  JSON doc;
+  EXPECT_TRUE(doc.fromString(body).ok());
+  EXPECT_EQ(2U, doc.doc()["data"].Size());
+
+  // Lines that look like objects but do not parse are skipped.
+  log_data = {"{\"a\":1}",
+              "{\"truncated\":\"abc}",
+              "{\"a\":1}{\"b\":2}",
+              "{\"a\":1,}",
+              std::string("{\"a\":1}\0}", 9),
+              "{\"b\":\"c\"}"};
+  spliceLogLines("key", "result", log_data, body);
+  EXPECT_EQ(
+      "{\"node_key\":\"key\",\"log_type\":\"result\","
+      "\"data\":[{\"a\":1},{\"b\":\"c\"}]}",
+      body);
+  EXPECT_TRUE(doc.fromString(body).ok());
+
+  std::vector<std::string> empty_data;
+  spliceLogLines("key", "status", empty_data, body);
+  EXPECT_EQ("{\"node_key\":\"key\",\"log_type\":\"status\",\"data\":[]}",
+            body);
+}
 }
@@ -8,8 +8,6 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
-#include <boost/property_tree/ptree.hpp>
-
 #include <osquery/enroll.h>
 #include <osquery/flags.h>
 #include <osquery/registry.h>
@@ -82,41 +80,72 @@ void TLSLoggerPlugin::init(const std::string& name,
   logStatus(log);
 }
 
-Status TLSLogForwarder::send(std::vector<std::string>& log_data,
-                             const std::string& log_type) {
+/// Check that a buffered log line is a single, complete JSON object.
+static bool isJSONObject(const std::string& line) {
+  if (line.empty() || line.front() != '{' || line.back() != '}' ||
+      line.find('\0') != std::string::npos) {
+    return false;
+  }
+
+  // Validate without building a document, the line is spliced as-is.
+  rapidjson::Reader reader;
+  rapidjson::StringStream stream(line.c_str());
+  rapidjson::BaseReaderHandler<> handler;
+  return !reader.Parse(stream, handler).IsError();
+}
+
+void TLSLogForwarder::spliceLogLines(const std::string& node_key,
+                                     const std::string& log_type,
+                                     std::vector<std::string>& log_data,
+                                     std::string& body) {
+  // Serialize the small envelope once, then reopen it to append the lines.
   JSON params;
-  params.add("node_key", getNodeKey("tls"));
+  params.add("node_key", node_key);
   params.add("log_type", log_type);
+  params.toString(body);
+  body.pop_back();
 
-  {
-    // Read each logged line into JSON and populate a list of lines.
-    // The result list will use the 'data' key.
-    auto children = params.newArray();
-    iterate(log_data, ([&params, &children](std::string& item) {
-              // Enforce a max log line size for TLS logging.
-              if (item.size() > FLAGS_logger_tls_max) {
-                LOG(WARNING) << "Line exceeds TLS logger max: " << item.size();
-                return;
-              }
-
-              JSON child;
-              Status s = child.fromString(item);
-              if (!s.ok()) {
-                // The log line entered was not valid JSON, skip it.
-                return;
-              }
-              std::string().swap(item);
-              params.push(child.doc(), children.doc());
-            }));
-    params.add("data", children.doc());
+  size_t size = body.size() + 12;
+  for (const auto& item : log_data) {
+    size += item.size() + 1;
   }
+  body.reserve(size);
+
+  // Each buffered line is already a serialized JSON object. Validate it and
+  // append it to the 'data' list as-is rather than re-serializing it.
+  body += ",\"data\":[";
+  bool first = true;
+  iterate(log_data, ([&body, &first](std::string& item) {
+            // Enforce a max log line size for TLS logging.
+            if (item.size() > FLAGS_logger_tls_max) {
+              LOG(WARNING) << "Line exceeds TLS logger max: " << item.size();
+              return;
+            }
+
+            if (!isJSONObject(item)) {
+              // The log line entered was not valid JSON, skip it.
+              return;
+            }
+
+            if (!first) {
+              body += ',';
+            }
+            first = false;
+            body += item;
+            std::string().swap(item);
+          }));
+  body += "]}";
+}
+
+Status TLSLogForwarder::send(std::vector<std::string>& log_data,
+                             const std::string& log_type) {
+  std::string body;
+  spliceLogLines(getNodeKey("tls"), log_type, log_data, body);
 
   // The response body is ignored (status is set appropriately by
-  // TLSRequestHelper::go())
-  std::string response;
-  if (FLAGS_logger_tls_compress) {
-    params.add("_compress", true);
-  }
-  return TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
+  // TLSRequestHelper::goSerialized())
+  JSON response;
+  return TLSRequestHelper::goSerialized<JSONSerializer>(
+      uri_, body, FLAGS_logger_tls_compress, response);
 }
 }
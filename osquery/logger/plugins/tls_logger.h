@@ -32,6 +32,18 @@ class TLSLogForwarder : public BufferedLogForwarder {
   Status send(std::vector<std::string>& log_data,
               const std::string& log_type) override;
 
+  /**
+   * @brief Build a request body from buffered log lines.
+   *
+   * Buffered lines are already serialized JSON objects, so they are spliced
+   * into the 'data' list of the request envelope without being parsed.
+   * Lines that are too large or are not objects are skipped.
+   */
+  static void spliceLogLines(const std::string& node_key,
+                             const std::string& log_type,
+                             std::vector<std::string>& log_data,
+                             std::string& body);
+
   /// Endpoint URI
   std::string uri_;
 
@@ -8,6 +8,12 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 #include <boost/format.hpp>
@@ -34,6 +40,10 @@ FLAG(uint64,
      numeric_monitoring_pre_aggregation_time,
      60,
      "Time period in seconds for numeric monitoring pre-aggreagation buffer.");
+FLAG(bool,
+     numeric_monitoring_batch,
+     false,
+     "Send the pre-aggregated points to plugins as a single batch request");
 
 namespace {
 using monitoring::PreAggregationType;
@@ -118,6 +128,133 @@ namespace {
 class FlusherIsScheduled {};
 FlusherIsScheduled schedule();
 
+/**
+ * Values of one metric recorded by one thread since the last flush.
+ */
+struct MetricSlot {
+  bool recorded = false;
+  ValueType value = 0;
+  Summary summary;
+};
+
+/**
+ * The metric slots of one thread.
+ * Only the owning thread records, the flusher takes the slots. The spin flag
+ * is therefore only contended while a flush takes this thread's slots.
+ */
+class ThreadRecorder final {
+ public:
+  void record(std::size_t id,
+              ValueType value,
+              PreAggregationType pre_aggregation) {
+    while (lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    if (id >= slots_.size()) {
+      slots_.resize(id + 1);
+    }
+    auto& slot = slots_[id];
+    switch (pre_aggregation) {
+    case PreAggregationType::Sum:
+      slot.value = slot.recorded ? slot.value + value : value;
+      break;
+    case PreAggregationType::Min:
+      slot.value = slot.recorded ? std::min(slot.value, value) : value;
+      break;
+    case PreAggregationType::Max:
+      slot.value = slot.recorded ? std::max(slot.value, value) : value;
+      break;
+    default:
+      slot.summary.add(value);
+      break;
+    }
+    slot.recorded = true;
+    lock_.clear(std::memory_order_release);
+  }
+
+  std::vector<MetricSlot> take() {
+    auto taken = std::vector<MetricSlot>{};
+    while (lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    std::swap(taken, slots_);
+    lock_.clear(std::memory_order_release);
+    return taken;
+  }
+
+  /// Set when the owning thread exits, the slots are taken once more.
+  std::atomic<bool> exited{false};
+
+ private:
+  std::vector<MetricSlot> slots_;
+  std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+};
+
+/**
+ * Registered metric paths and the recorders of all threads that recorded.
+ */
+class MetricRegistry final {
+ public:
+  static MetricRegistry& get() {
+    static MetricRegistry instance{};
+    return instance;
+  }
+
+  std::size_t add(const std::string& path, PreAggregationType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(path, type);
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    auto id = metrics_.size();
+    metrics_.push_back(key);
+    ids_.emplace(std::move(key), id);
+    return id;
+  }
+
+  std::shared_ptr<ThreadRecorder> addRecorder() {
+    auto recorder = std::make_shared<ThreadRecorder>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    recorders_.push_back(recorder);
+    return recorder;
+  }
+
+  /// Merge and take the values recorded by all threads as points.
+  std::vector<Point> takePoints(const TimePoint& time_point) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto points = std::vector<Point>{};
+    for (auto it = recorders_.begin(); it != recorders_.end();) {
+      // Read the exit before taking, no values are recorded after it.
+      auto exited = (*it)->exited.load();
+      auto slots = (*it)->take();
+      for (std::size_t id = 0; id < slots.size(); ++id) {
+        if (!slots[id].recorded) {
+          continue;
+        }
+        const auto& metric = metrics_[id];
+        if (slots[id].summary.count() > 0) {
+          points.emplace_back(metric.first,
+                              std::move(slots[id].summary),
+                              metric.second,
+                              time_point);
+        } else {
+          points.emplace_back(
+              metric.first, slots[id].value, metric.second, time_point);
+        }
+      }
+      it = exited ? recorders_.erase(it) : std::next(it);
+    }
+    return points;
+  }
+
+ private:
+  std::map<std::pair<std::string, PreAggregationType>, std::size_t> ids_;
+  std::vector<std::pair<std::string, PreAggregationType>> metrics_;
+  std::vector<std::shared_ptr<ThreadRecorder>> recorders_;
+  std::mutex mutex_;
+};
+
 class PreAggregationBuffer final {
  public:
   static PreAggregationBuffer& get() {
@@ -141,33 +278,61 @@ class PreAggregationBuffer final {
 
   void flush() {
     auto points = takeCachedPoints();
+    if (!FLAGS_numeric_monitoring_batch) {
+      for (const auto& pt : points) {
+        dispatchOne(
+            pt.path_, pt.value_, pt.pre_aggregation_type_, pt.time_point_);
+      }
+      return;
+    }
+
+    if (points.empty()) {
+      return;
+    }
+
+    auto requests = std::vector<PluginRequest>{};
+    requests.reserve(points.size());
     for (const auto& pt : points) {
-      dispatchOne(
-          pt.path_, pt.value_, pt.pre_aggregation_type_, pt.time_point_);
+      requests.push_back(createRequest(
+          pt.path_, pt.value_, pt.pre_aggregation_type_, pt.time_point_));
     }
+    dispatch(createBatchRequest(requests));
   }
 
  private:
   std::vector<Point> takeCachedPoints() {
+    auto recorded = MetricRegistry::get().takePoints(Clock::now());
     std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pt : recorded) {
+      cache_.addPoint(std::move(pt));
+    }
     auto points = cache_.takePoints();
     return points;
   }
 
+  static PluginRequest createRequest(const std::string& path,
+                                     const ValueType& value,
+                                     const PreAggregationType& pre_aggregation,
+                                     const TimePoint& time_point) {
+    return {
+        {recordKeys().path, path},
+        {recordKeys().value, std::to_string(value)},
+        {recordKeys().pre_aggregation, to<std::string>(pre_aggregation)},
+        {recordKeys().timestamp,
+         std::to_string(time_point.time_since_epoch().count())},
+    };
+  }
+
   void dispatchOne(const std::string& path,
                    const ValueType& value,
                    const PreAggregationType& pre_aggregation,
                    const TimePoint& time_point) {
+    dispatch(createRequest(path, value, pre_aggregation, time_point));
+  }
+
+  void dispatch(const PluginRequest& request) {
     auto status = Registry::call(
-        registryName(),
-        FLAGS_numeric_monitoring_plugins,
-        {
-            {recordKeys().path, path},
-            {recordKeys().value, std::to_string(value)},
-            {recordKeys().pre_aggregation, to<std::string>(pre_aggregation)},
-            {recordKeys().timestamp,
-             std::to_string(time_point.time_since_epoch().count())},
-        });
+        registryName(), FLAGS_numeric_monitoring_plugins, request);
     if (!status.ok()) {
       LOG(ERROR) << "Data loss. Numeric monitoring point dispatch failed: "
                  << status.what();
@@ -199,6 +364,28 @@ FlusherIsScheduled schedule() {
   return FlusherIsScheduled{};
 }
 
+/**
+ * Owns the calling thread's recorder, and marks it exited with the thread.
+ */
+class ThreadRecorderHolder final {
+ public:
+  ThreadRecorderHolder() : recorder(MetricRegistry::get().addRecorder()) {
+    // The thread's values are only merged by a scheduled flush.
+    PreAggregationBuffer::get();
+  }
+
+  ~ThreadRecorderHolder() {
+    recorder->exited = true;
+  }
+
+  std::shared_ptr<ThreadRecorder> recorder;
+};
+
+ThreadRecorder& localRecorder() {
+  thread_local ThreadRecorderHolder holder;
+  return *holder.recorder;
+}
+
 } // namespace
 
 void flush() {
@@ -216,5 +403,22 @@ void record(const std::string& path,
       path, value, pre_aggregation, std::move(time_point));
 }
 
+Metric::Metric(std::string path, PreAggregationType pre_aggregation)
+    : path_(std::move(path)),
+      pre_aggregation_(pre_aggregation),
+      id_(MetricRegistry::get().add(path_, pre_aggregation_)) {}
+
+void Metric::record(ValueType value) const {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+  if (pre_aggregation_ == PreAggregationType::None ||
+      0 == FLAGS_numeric_monitoring_pre_aggregation_time) {
+    monitoring::record(path_, value, pre_aggregation_);
+    return;
+  }
+  localRecorder().record(id_, value, pre_aggregation_);
+}
+
 } // namespace monitoring
 } // namespace osquery
@@ -11,6 +11,7 @@
 #include <osquery/plugin.h>
 #include <osquery/registry_factory.h>
 
+#include "osquery/core/json.h"
 #include "osquery/numeric_monitoring/plugin_interface.h"
 
 namespace osquery {
@@ -32,6 +33,7 @@ RecordKeys createRecordKeys() {
   keys.value = "value";
   keys.timestamp = "timestamp";
   keys.pre_aggregation = "pre_aggregation";
+  keys.batch = "batch";
   return keys;
 };
 
@@ -42,6 +44,21 @@ const RecordKeys& recordKeys() {
   return keys;
 }
 
+PluginRequest createBatchRequest(const std::vector<PluginRequest>& points) {
+  auto doc = JSON::newArray();
+  for (const auto& point : points) {
+    auto obj = doc.getObject();
+    for (const auto& field : point) {
+      doc.addRef(field.first, field.second, obj);
+    }
+    doc.push(obj);
+  }
+
+  std::string serialized;
+  doc.toString(serialized);
+  return {{recordKeys().batch, std::move(serialized)}};
+}
+
 } // namespace monitoring
 
 Status NumericMonitoringPlugin::call(const PluginRequest& request,
@@ -50,4 +67,38 @@ Status NumericMonitoringPlugin::call(const PluginRequest& request,
   return Status();
 }
 
+Status NumericMonitoringPlugin::forEachPoint(
+    const PluginRequest& request,
+    const std::function<Status(const PluginRequest& point)>& record) {
+  auto batch = request.find(monitoring::recordKeys().batch);
+  if (batch == request.end()) {
+    return record(request);
+  }
+
+  auto doc = JSON::newArray();
+  if (!doc.fromString(batch->second).ok() || !doc.doc().IsArray()) {
+    return Status(1, "Invalid numeric monitoring batch");
+  }
+
+  auto status = Status();
+  for (const auto& item : doc.doc().GetArray()) {
+    if (!item.IsObject()) {
+      status = Status(1, "Invalid numeric monitoring batch point");
+      continue;
+    }
+
+    PluginRequest point;
+    for (const auto& field : item.GetObject()) {
+      if (field.value.IsString()) {
+        point[field.name.GetString()] = field.value.GetString();
+      }
+    }
+    auto point_status = record(point);
+    if (!point_status.ok()) {
+      status = point_status;
+    }
+  }
+  return status;
+}
+
 } // namespace osquery
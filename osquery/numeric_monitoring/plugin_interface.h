@@ -11,7 +11,9 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include <osquery/core.h>
 #include <osquery/expected.h>
@@ -29,10 +31,19 @@ struct RecordKeys {
   std::string value;
   std::string timestamp;
   std::string pre_aggregation;
+  std::string batch;
 };
 
 const RecordKeys& recordKeys();
 
+/**
+ * @brief Serialize single point requests into one batch request.
+ *
+ * The batch request contains a JSON array of the point requests in the
+ * recordKeys().batch key.
+ */
+PluginRequest createBatchRequest(const std::vector<PluginRequest>& points);
+
 const char* registryName();
 
 } // namespace monitoring
@@ -45,6 +56,18 @@ const char* registryName();
 class NumericMonitoringPlugin : public Plugin {
  public:
   Status call(const PluginRequest& request, PluginResponse& response) override;
+
+ protected:
+  /**
+   * @brief Call @param record for each point of a request.
+   *
+   * A request is either a single point, or a batch of points sent by the
+   * pre-aggregation buffer flush @see createBatchRequest.
+   * Every point is recorded even if a previous one failed.
+   */
+  static Status forEachPoint(
+      const PluginRequest& request,
+      const std::function<Status(const PluginRequest& point)>& record);
 };
 
 } // namespace osquery
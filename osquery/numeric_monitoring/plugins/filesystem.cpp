@@ -67,12 +67,16 @@ Status NumericMonitoringFilesystemPlugin::call(const PluginRequest& request,
   if (!isSetUp()) {
     return Status(1, "NumericMonitoringFilesystemPlugin is not set up");
   }
-  auto line = std::string{};
-  auto status = formTheLine(line, request);
-  if (status.ok()) {
-    std::unique_lock<std::mutex> lock(output_file_mutex_);
-    output_file_stream_ << line << std::endl;
-  }
+  std::unique_lock<std::mutex> lock(output_file_mutex_);
+  auto status = forEachPoint(request, [this](const PluginRequest& point) {
+    auto line = std::string{};
+    auto point_status = formTheLine(line, point);
+    if (point_status.ok()) {
+      output_file_stream_ << line << '\n';
+    }
+    return point_status;
+  });
+  output_file_stream_.flush();
   return status;
 }
 
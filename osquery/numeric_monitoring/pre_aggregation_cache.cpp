@@ -8,6 +8,9 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include <boost/io/detail/quoted_manip.hpp>
 
 #include "osquery/numeric_monitoring/pre_aggregation_cache.h"
@@ -16,6 +19,155 @@ namespace osquery {
 
 namespace monitoring {
 
+namespace {
+
+/// Relative accuracy of the percentile estimates.
+const double kSummaryAccuracy = 0.01;
+
+const double kSummaryGamma = (1 + kSummaryAccuracy) / (1 - kSummaryAccuracy);
+
+const double kSummaryLogGamma = std::log(kSummaryGamma);
+
+bool isSummaryType(PreAggregationType type) {
+  switch (type) {
+  case PreAggregationType::Avg:
+  case PreAggregationType::Stddev:
+  case PreAggregationType::P10:
+  case PreAggregationType::P50:
+  case PreAggregationType::P95:
+  case PreAggregationType::P99:
+    return true;
+  default:
+    return false;
+  }
+}
+
+ValueType toValue(double value) {
+  return static_cast<ValueType>(std::llround(value));
+}
+
+ValueType summaryValue(const Summary& summary, PreAggregationType type) {
+  switch (type) {
+  case PreAggregationType::Avg:
+    return toValue(summary.mean());
+  case PreAggregationType::Stddev:
+    return toValue(summary.stddev());
+  case PreAggregationType::P10:
+    return summary.quantile(0.10);
+  case PreAggregationType::P50:
+    return summary.quantile(0.50);
+  case PreAggregationType::P95:
+    return summary.quantile(0.95);
+  case PreAggregationType::P99:
+    return summary.quantile(0.99);
+  default:
+    return 0;
+  }
+}
+
+} // namespace
+
+int Summary::bucketIndex(double magnitude) {
+  return static_cast<int>(std::ceil(std::log(magnitude) / kSummaryLogGamma));
+}
+
+double Summary::bucketValue(int index) {
+  return 2 * std::pow(kSummaryGamma, index) / (kSummaryGamma + 1);
+}
+
+void Summary::add(ValueType value) {
+  min_ = (count_ == 0) ? value : std::min(min_, value);
+  max_ = (count_ == 0) ? value : std::max(max_, value);
+
+  ++count_;
+  auto delta = static_cast<double>(value) - mean_;
+  mean_ += delta / static_cast<double>(count_);
+  m2_ += delta * (static_cast<double>(value) - mean_);
+
+  if (value > 0) {
+    ++positive_[bucketIndex(static_cast<double>(value))];
+  } else if (value < 0) {
+    ++negative_[bucketIndex(-static_cast<double>(value))];
+  } else {
+    ++zero_;
+  }
+}
+
+void Summary::merge(const Summary& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  if (count_ == 0) {
+    *this = other;
+    return;
+  }
+
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+
+  // Chan et al. parallel combination of the mean and squared differences.
+  auto count = static_cast<double>(count_ + other.count_);
+  auto delta = other.mean_ - mean_;
+  mean_ += delta * static_cast<double>(other.count_) / count;
+  m2_ += other.m2_ + delta * delta * static_cast<double>(count_) *
+                         static_cast<double>(other.count_) / count;
+  count_ += other.count_;
+
+  for (const auto& bucket : other.positive_) {
+    positive_[bucket.first] += bucket.second;
+  }
+  for (const auto& bucket : other.negative_) {
+    negative_[bucket.first] += bucket.second;
+  }
+  zero_ += other.zero_;
+}
+
+double Summary::stddev() const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  return std::sqrt(m2_ / static_cast<double>(count_));
+}
+
+ValueType Summary::quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<std::size_t>(
+      std::max(0.0, std::min(q, 1.0)) * static_cast<double>(count_ - 1));
+  if (rank == 0) {
+    return min_;
+  }
+  if (rank + 1 == count_) {
+    return max_;
+  }
+  auto clamp = [this](double estimate) {
+    return std::max(min_, std::min(max_, toValue(estimate)));
+  };
+
+  // Walk the buckets in value order: negative by decreasing magnitude, zero,
+  // and positive by increasing magnitude.
+  std::size_t seen = 0;
+  for (auto it = negative_.rbegin(); it != negative_.rend(); ++it) {
+    seen += it->second;
+    if (seen > rank) {
+      return clamp(-bucketValue(it->first));
+    }
+  }
+  seen += zero_;
+  if (seen > rank) {
+    return 0;
+  }
+  for (const auto& bucket : positive_) {
+    seen += bucket.second;
+    if (seen > rank) {
+      return clamp(bucketValue(bucket.first));
+    }
+  }
+  return max_;
+}
+
 Point::Point(std::string path,
              ValueType value,
              PreAggregationType pre_aggregation_type,
@@ -23,7 +175,25 @@ Point::Point(std::string path,
     : path_(std::move(path)),
       value_(std::move(value)),
       pre_aggregation_type_(std::move(pre_aggregation_type)),
-      time_point_(std::move(time_point)) {}
+      time_point_(std::move(time_point)) {
+  if (isSummaryType(pre_aggregation_type_)) {
+    summary_.add(value_);
+  }
+  if (pre_aggregation_type_ == PreAggregationType::Stddev) {
+    // A single value does not deviate.
+    value_ = 0;
+  }
+}
+
+Point::Point(std::string path,
+             Summary summary,
+             PreAggregationType pre_aggregation_type,
+             TimePoint time_point)
+    : path_(std::move(path)),
+      value_(summaryValue(summary, pre_aggregation_type)),
+      pre_aggregation_type_(std::move(pre_aggregation_type)),
+      time_point_(std::move(time_point)),
+      summary_(std::move(summary)) {}
 
 bool Point::tryToAggregate(const Point& new_point) {
   if (path_ != new_point.path_) {
@@ -46,13 +216,16 @@ bool Point::tryToAggregate(const Point& new_point) {
   time_point_ = std::max(time_point_, new_point.time_point_);
   switch (pre_aggregation_type_) {
   case PreAggregationType::None:
+    return false;
   case PreAggregationType::Avg:
   case PreAggregationType::Stddev:
   case PreAggregationType::P10:
   case PreAggregationType::P50:
   case PreAggregationType::P95:
   case PreAggregationType::P99:
-    return false;
+    summary_.merge(new_point.summary_);
+    value_ = summaryValue(summary_, pre_aggregation_type_);
+    break;
   case PreAggregationType::Sum:
     value_ = value_ + new_point.value_;
     break;
@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <map>
 #include <unordered_map>
+#include <vector>
 
 #include <osquery/numeric_monitoring.h>
 
@@ -18,6 +20,51 @@ namespace osquery {
 
 namespace monitoring {
 
+/**
+ * Mergeable summary of observed values, used for the Avg, Stddev and
+ * percentile pre-aggregation types.
+ * Mean and variance are kept with Welford's algorithm. Percentiles are
+ * estimated from logarithmic buckets with 1% relative accuracy, the memory is
+ * bounded by the range of the values rather than the number of them.
+ */
+class Summary {
+ public:
+  void add(ValueType value);
+
+  void merge(const Summary& other);
+
+  std::size_t count() const noexcept {
+    return count_;
+  }
+
+  double mean() const noexcept {
+    return mean_;
+  }
+
+  /// Population standard deviation.
+  double stddev() const;
+
+  /// Estimate the value at quantile @param q, from 0 to 1.
+  ValueType quantile(double q) const;
+
+ private:
+  static int bucketIndex(double magnitude);
+
+  static double bucketValue(int index);
+
+ private:
+  std::size_t count_ = 0;
+  double mean_ = 0.0;
+  double m2_ = 0.0;
+  ValueType min_ = 0;
+  ValueType max_ = 0;
+
+  /// Bucket counts of positive and negative values, by magnitude.
+  std::map<int, std::size_t> positive_;
+  std::map<int, std::size_t> negative_;
+  std::size_t zero_ = 0;
+};
+
 /**
  * Monitoring system smallest unit
  * Consists of watched value itself, watching time, unique name for this set of
@@ -41,6 +88,15 @@ class Point {
                  PreAggregationType pre_aggregation_type,
                  TimePoint time_point);
 
+  /**
+   * Constructor for a point of already summarized values, the value is
+   * computed from @param summary for one of the summary pre-aggregation types.
+   */
+  explicit Point(std::string path,
+                 Summary summary,
+                 PreAggregationType pre_aggregation_type,
+                 TimePoint time_point);
+
   /**
    * Try to aggregate @param new_point into itself.
    * If `pre_aggregation_type` and `path` are the same in `new_point`, the value
@@ -55,6 +111,9 @@ class Point {
   ValueType value_;
   PreAggregationType pre_aggregation_type_;
   TimePoint time_point_;
+
+  /// Observed values, for the types computed from a summary.
+  Summary summary_;
 };
 
 class PreAggregationCache {
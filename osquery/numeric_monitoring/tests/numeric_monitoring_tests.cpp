@@ -8,6 +8,9 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <boost/filesystem.hpp>
@@ -57,6 +60,7 @@ GTEST_TEST(NumericMonitoringTests, PreAggregationTypeToStringRecall) {
 DECLARE_bool(enable_numeric_monitoring);
 DECLARE_string(numeric_monitoring_plugins);
 DECLARE_uint64(numeric_monitoring_pre_aggregation_time);
+DECLARE_bool(numeric_monitoring_batch);
 
 const auto kNameForTestPlugin =
     "test_plugin_osquery/numeric_monitoring/tests/numeric_monitoring_tests";
@@ -64,14 +68,19 @@ const auto kNameForTestPlugin =
 class NumericMonitoringInMemoryTestPlugin : public NumericMonitoringPlugin {
  public:
   Status call(const PluginRequest& request, PluginResponse& response) override {
-    NumericMonitoringInMemoryTestPlugin::points.push_back(request);
-    return Status::success();
+    ++NumericMonitoringInMemoryTestPlugin::calls;
+    return forEachPoint(request, [](const PluginRequest& point) {
+      NumericMonitoringInMemoryTestPlugin::points.push_back(point);
+      return Status::success();
+    });
   }
 
   static std::vector<PluginRequest> points;
+  static std::size_t calls;
 };
 
 std::vector<PluginRequest> NumericMonitoringInMemoryTestPlugin::points;
+std::size_t NumericMonitoringInMemoryTestPlugin::calls = 0;
 
 REGISTER(NumericMonitoringInMemoryTestPlugin,
          monitoring::registryName(),
@@ -122,6 +131,126 @@ GTEST_TEST(NumericMonitoringTests, record_with_buffer) {
   Dispatcher::joinServices();
 }
 
+GTEST_TEST(NumericMonitoringTests, record_with_buffer_batch) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+  const auto batch = FLAGS_numeric_monitoring_batch;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+  FLAGS_numeric_monitoring_batch = true;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+  NumericMonitoringInMemoryTestPlugin::calls = 0;
+
+  const auto avg_path = "some.path.to.avg";
+  const auto p50_path = "some.path.to.p50";
+  for (auto value : {3, 1, 2, 10, 4}) {
+    monitoring::record(avg_path,
+                       monitoring::ValueType{value},
+                       monitoring::PreAggregationType::Avg);
+    monitoring::record(p50_path,
+                       monitoring::ValueType{value},
+                       monitoring::PreAggregationType::P50);
+  }
+  monitoring::flush();
+
+  // Both aggregated points are sent in a single plugin call.
+  EXPECT_EQ(1, NumericMonitoringInMemoryTestPlugin::calls);
+  ASSERT_EQ(2, NumericMonitoringInMemoryTestPlugin::points.size());
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    auto value = std::stoll(point.at(monitoring::recordKeys().value));
+    if (point.at(monitoring::recordKeys().path) == avg_path) {
+      EXPECT_EQ(4, value);
+      EXPECT_EQ("avg", point.at(monitoring::recordKeys().pre_aggregation));
+    } else {
+      EXPECT_EQ(p50_path, point.at(monitoring::recordKeys().path));
+      EXPECT_EQ(3, value);
+    }
+  }
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+  FLAGS_numeric_monitoring_batch = batch;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
+GTEST_TEST(NumericMonitoringTests, record_metric_from_threads) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+
+  const auto sum_path = "some.path.to.metric.sum";
+  const auto max_path = "some.path.to.metric.max";
+  monitoring::Metric sum_metric(sum_path);
+  monitoring::Metric max_metric(max_path, monitoring::PreAggregationType::Max);
+
+  // Values recorded by exited threads, and points recorded by path, are
+  // merged with the values of the current thread.
+  auto threads = std::vector<std::thread>{};
+  for (int i = 1; i <= 4; ++i) {
+    threads.emplace_back([&sum_metric, &max_metric, i]() {
+      for (int j = 0; j < 100; ++j) {
+        sum_metric.record(1);
+        max_metric.record(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  sum_metric.record(10);
+  monitoring::record(
+      sum_path, monitoring::ValueType{5}, monitoring::PreAggregationType::Sum);
+  monitoring::flush();
+
+  ASSERT_EQ(2, NumericMonitoringInMemoryTestPlugin::points.size());
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    auto value = std::stoll(point.at(monitoring::recordKeys().value));
+    if (point.at(monitoring::recordKeys().path) == sum_path) {
+      EXPECT_EQ(400 + 10 + 5, value);
+    } else {
+      EXPECT_EQ(max_path, point.at(monitoring::recordKeys().path));
+      EXPECT_EQ(4, value);
+    }
+  }
+
+  // Nothing is left to flush.
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+  monitoring::flush();
+  EXPECT_TRUE(NumericMonitoringInMemoryTestPlugin::points.empty());
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
 GTEST_TEST(NumericMonitoringTests, record_without_buffer) {
   const auto isEnabled = FLAGS_enable_numeric_monitoring;
   const auto plugins = FLAGS_numeric_monitoring_plugins;
@@ -32,13 +32,7 @@ GTEST_TEST(PreAggregationPoint, tryToUpdate_same_path_none) {
 
 GTEST_TEST(PreAggregationPoint, tryToUpdate_same_path_different_types) {
   const std::set<monitoring::PreAggregationType> nonaggregatable = {
-      monitoring::PreAggregationType::None,
-      monitoring::PreAggregationType::Avg,
-      monitoring::PreAggregationType::Stddev,
-      monitoring::PreAggregationType::P10,
-      monitoring::PreAggregationType::P50,
-      monitoring::PreAggregationType::P95,
-      monitoring::PreAggregationType::P99};
+      monitoring::PreAggregationType::None};
   const auto now = monitoring::Clock::now();
   const auto path = "test.path.to.nowhere/paranoid";
   using UnderType = std::underlying_type<monitoring::PreAggregationType>::type;
@@ -114,6 +108,62 @@ GTEST_TEST(PreAggregationPoint, tryToUpdate_max) {
   EXPECT_EQ(42, prev_pt.value_);
 }
 
+GTEST_TEST(PreAggregationPoint, tryToUpdate_avg_stddev) {
+  const auto now = monitoring::Clock::now();
+  const auto path = "test.path.to.nowhere";
+  auto avg_pt =
+      monitoring::Point(path, 2, monitoring::PreAggregationType::Avg, now);
+  auto stddev_pt =
+      monitoring::Point(path, 2, monitoring::PreAggregationType::Stddev, now);
+  EXPECT_EQ(2, avg_pt.value_);
+  EXPECT_EQ(0, stddev_pt.value_);
+  for (auto value : {4, 4, 4, 5, 5, 7, 9}) {
+    ASSERT_TRUE(avg_pt.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::Avg, now)));
+    ASSERT_TRUE(stddev_pt.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::Stddev, now)));
+  }
+  EXPECT_EQ(5, avg_pt.value_);
+  EXPECT_EQ(2, stddev_pt.value_);
+  EXPECT_EQ(8U, avg_pt.summary_.count());
+}
+
+GTEST_TEST(PreAggregationPoint, tryToUpdate_percentiles) {
+  const auto now = monitoring::Clock::now();
+  const auto path = "test.path.to.nowhere";
+  auto p10_pt =
+      monitoring::Point(path, 1, monitoring::PreAggregationType::P10, now);
+  auto p95_pt =
+      monitoring::Point(path, 1, monitoring::PreAggregationType::P95, now);
+  for (auto value = 2; value <= 1000; ++value) {
+    ASSERT_TRUE(p10_pt.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::P10, now)));
+    ASSERT_TRUE(p95_pt.tryToAggregate(monitoring::Point(
+        path, value, monitoring::PreAggregationType::P95, now)));
+  }
+  // Estimates are within 1% of the exact percentiles.
+  EXPECT_NEAR(100, p10_pt.value_, 2);
+  EXPECT_NEAR(950, p95_pt.value_, 10);
+}
+
+GTEST_TEST(PreAggregationSummary, merge) {
+  auto left = monitoring::Summary{};
+  auto right = monitoring::Summary{};
+  auto all = monitoring::Summary{};
+  for (auto value = -500; value <= 500; ++value) {
+    (value % 2 == 0 ? left : right).add(value);
+    all.add(value);
+  }
+  left.merge(right);
+  EXPECT_EQ(all.count(), left.count());
+  EXPECT_NEAR(all.mean(), left.mean(), 1e-9);
+  EXPECT_NEAR(all.stddev(), left.stddev(), 1e-9);
+  EXPECT_EQ(-500, left.quantile(0));
+  EXPECT_EQ(500, left.quantile(1));
+  EXPECT_EQ(0, left.quantile(0.5));
+  EXPECT_EQ(all.quantile(0.99), left.quantile(0.99));
+}
+
 GTEST_TEST(PreAggregationCache, life_cycle) {
   const auto now = monitoring::Clock::now();
   auto cache = monitoring::PreAggregationCache{};
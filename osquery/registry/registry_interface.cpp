@@ -32,6 +32,7 @@ void RegistryInterface::remove(const std::string& item_name) {
   for (const auto& alias : removed_aliases) {
     aliases_.erase(alias);
   }
+  epoch_++;
 }
 
 bool RegistryInterface::isInternal(const std::string& item_name) const {
@@ -78,6 +79,7 @@ Status RegistryInterface::setActive(const std::string& item_name) {
   {
     WriteUpgradeLock wlock(lock);
     active_ = item_name;
+    epoch_++;
   }
 
   // The active plugin is setup when initialized.
@@ -202,6 +204,7 @@ Status RegistryInterface::addPlugin(const std::string& plugin_name,
     internal_.push_back(plugin_name);
   }
 
+  epoch_++;
   return Status(0, "OK");
 }
 
@@ -294,6 +297,7 @@ void RegistryInterface::removeExternal(const RouteUUID& uuid) {
       external_.erase(item);
       routes_.erase(item);
     }
+    epoch_++;
   }
 }
 
@@ -229,6 +229,21 @@ class Request {
       return s;
     }
 
+    return callSerialized(serialized);
+  }
+
+  /**
+   * @brief Send a request with an already-serialized body
+   *
+   * Callers that can produce the serialized form of their parameters more
+   * cheaply than building a JSON document (for example by splicing existing
+   * JSON strings) may bypass the serializer.
+   *
+   * @param serialized the request body, in the serializer's content type
+   *
+   * @return success or failure of the operation
+   */
+  Status callSerialized(const std::string& serialized) {
     bool compress = false;
     auto it = options_.doc().FindMember("compress");
     if (it != options_.doc().MemberEnd() && it->value.IsBool()) {
@@ -77,7 +77,6 @@ class TLSRequestHelper : private boost::noncopyable {
   template <class TSerializer>
   static Status go(const std::string& uri, JSON& params, JSON& output) {
     auto& params_doc = params.doc();
-    auto& output_doc = output.doc();
 
     auto node_key = getNodeKey("tls");
 
@@ -138,41 +137,50 @@ class TLSRequestHelper : private boost::noncopyable {
     if (!status.ok()) {
       return status;
     }
+    return checkResponse(output);
+  }
 
-    // Receive config or key rejection
-    it = output_doc.FindMember("node_invalid");
-    if (it != output_doc.MemberEnd()) {
-      assert(it->value.IsBool());
-
-      if (it->value.GetBool()) {
-        if (!FLAGS_disable_reenrollment) {
-          clearNodeKey();
-        }
-
-        std::string message = "Request failed: Invalid node key";
-
-        it = output_doc.FindMember("error");
-        if (it != output_doc.MemberEnd()) {
-          message +=
-              ": " + std::string(it->value.IsString() ? it->value.GetString()
-                                                      : "<unknown>");
-        }
-
-        return Status(1, message);
-      }
+  /**
+   * @brief Send a TLS request with a pre-serialized body
+   *
+   * The body must already contain the node_key when not using the TLS node
+   * API. This avoids building a JSON document for callers that already hold
+   * serialized JSON, such as buffered log lines.
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized request body
+   * @param compress true if the body should be compressed by the transport
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status goSerialized(const std::string& uri,
+                             const std::string& body,
+                             bool compress,
+                             JSON& output) {
+    std::string uri_suffix;
+    if (FLAGS_tls_node_api) {
+      uri_suffix = "&node_key=" + getNodeKey("tls");
     }
 
-    it = output_doc.FindMember("error");
-    if (it != output_doc.MemberEnd()) {
-      std::string message =
-          "Request failed: " + std::string(it->value.IsString()
-                                               ? it->value.GetString()
-                                               : "<unknown>");
+    Request<TLSTransport, TSerializer> request(uri + uri_suffix);
+    request.setOption("hostname", FLAGS_tls_hostname);
+    if (compress) {
+      request.setOption("compress", compress);
+    }
 
-      return Status(1, message);
+    auto status = request.callSerialized(body);
+    if (!status.ok()) {
+      return status;
     }
 
-    return Status(0, "OK");
+    status = request.getResponse(output);
+    if (!status.ok()) {
+      return status;
+    }
+    return checkResponse(output);
   }
 
   /**
@@ -291,5 +299,51 @@ class TLSRequestHelper : private boost::noncopyable {
     params.add("_get", true);
     return TLSRequestHelper::go<TSerializer>(uri, params, output, attempts);
   }
+
+ private:
+  /**
+   * @brief Inspect a deserialized response for node key and error replies
+   *
+   * @param output is the deserialized response from the server
+   *
+   * @return a Status object indicating if the server accepted the request
+   */
+  static Status checkResponse(JSON& output) {
+    // Receive config or key rejection
+    auto& output_doc = output.doc();
+    auto it = output_doc.FindMember("node_invalid");
+    if (it != output_doc.MemberEnd()) {
+      assert(it->value.IsBool());
+
+      if (it->value.GetBool()) {
+        if (!FLAGS_disable_reenrollment) {
+          clearNodeKey();
+        }
+
+        std::string message = "Request failed: Invalid node key";
+
+        it = output_doc.FindMember("error");
+        if (it != output_doc.MemberEnd()) {
+          message +=
+              ": " + std::string(it->value.IsString() ? it->value.GetString()
+                                                      : "<unknown>");
+        }
+
+        return Status(1, message);
+      }
+    }
+
+    it = output_doc.FindMember("error");
+    if (it != output_doc.MemberEnd()) {
+      std::string message =
+          "Request failed: " + std::string(it->value.IsString()
+                                               ? it->value.GetString()
+                                               : "<unknown>");
+
+      return Status(1, message);
+    }
+
+    return Status(0, "OK");
+  }
 };
 }
@@ -15,6 +15,7 @@
 #include <osquery/sql.h>
 #include <osquery/tables.h>
 
+#include "osquery/sql/generator_stack.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
@@ -290,6 +291,59 @@ BENCHMARK(SQL_virtual_table_internal_wide_yield)
     ->ArgPair(0, 100)
     ->ArgPair(0, 1000);
 
+static void SQL_virtual_table_generator_filter(benchmark::State& state) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("wide_benchmark", std::make_shared<BenchmarkWideTablePlugin>());
+  tables->add("benchmark_yield", std::make_shared<BenchmarkTableYieldPlugin>());
+
+  PluginResponse res;
+  Registry::call("table", "wide_benchmark", {{"action", "columns"}}, res);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "wide_benchmark", columnDefinition(res, false, false), dbc, false);
+
+  res.clear();
+  Registry::call("table", "benchmark_yield", {{"action", "columns"}}, res);
+  attachTableInternal(
+      "benchmark_yield", columnDefinition(res, false, false), dbc, false);
+
+  // The generator table is filtered once for each row of the outer table.
+  kWideCount = state.range(0);
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal("select w.test_0, y.test_text from wide_benchmark w, "
+                  "benchmark_yield y",
+                  results,
+                  dbc);
+    dbc->clearAffectedTables();
+  }
+}
+
+BENCHMARK(SQL_virtual_table_generator_filter)->Arg(1)->Arg(100)->Arg(1000);
+
+static void emptyGenerator(RowYield& yield) {
+  Row r;
+  yield(r);
+}
+
+static void SQL_generator_stack_default(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    RowGenerator::pull_type generator(emptyGenerator);
+    benchmark::DoNotOptimize(generator.get());
+  }
+}
+
+BENCHMARK(SQL_generator_stack_default);
+
+static void SQL_generator_stack_pooled(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    RowGenerator::pull_type generator(PooledStackAllocator(), emptyGenerator);
+    benchmark::DoNotOptimize(generator.get());
+  }
+}
+
+BENCHMARK(SQL_generator_stack_pooled);
+
 static void SQL_select_metadata(benchmark::State& state) {
   auto dbc = SQLiteDBManager::getUnique();
   while (state.KeepRunning()) {
@@ -309,4 +363,50 @@ static void SQL_select_basic(benchmark::State& state) {
 }
 
 BENCHMARK(SQL_select_basic);
+
+static void createCmdlines(const SQLiteDBInstanceRef& dbc, int64_t count) {
+  QueryData results;
+  queryInternal(
+      "create table cmdlines as with recursive n(i) as "
+      "(select 1 union all select i + 1 from n where i < " +
+          std::to_string(count) +
+          ") select '/usr/bin/python3 -m http.server ' || i as cmdline "
+          "from n;",
+      results,
+      dbc);
+}
+
+static void SQL_regexp_cmdlines(benchmark::State& state) {
+  // Filter generated process command lines with a handful of IOC patterns.
+  auto dbc = SQLiteDBManager::getUnique();
+  createCmdlines(dbc, state.range(0));
+  QueryData results;
+
+  while (state.KeepRunning()) {
+    results.clear();
+    queryInternal(
+        "select count(*) from cmdlines where cmdline regexp "
+        "'nc(at)? -l|/tmp/\\.[a-z]+|python[23]? -m http\\.server 1000$';",
+        results,
+        dbc);
+  }
+}
+
+BENCHMARK(SQL_regexp_cmdlines)->Arg(1000)->Arg(100000);
+
+static void SQL_regex_extract_cmdlines(benchmark::State& state) {
+  auto dbc = SQLiteDBManager::getUnique();
+  createCmdlines(dbc, state.range(0));
+  QueryData results;
+
+  while (state.KeepRunning()) {
+    results.clear();
+    queryInternal(
+        "select regex_extract(cmdline, '\\d+$', 0) as port from cmdlines;",
+        results,
+        dbc);
+  }
+}
+
+BENCHMARK(SQL_regex_extract_cmdlines)->Arg(1000)->Arg(100000);
 } // namespace osquery
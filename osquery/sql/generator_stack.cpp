@@ -0,0 +1,71 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <osquery/flags.h>
+
+#include "osquery/sql/generator_stack.h"
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define OSQUERY_STACK_ASAN
+#endif
+#elif defined(__SANITIZE_ADDRESS__)
+#define OSQUERY_STACK_ASAN
+#endif
+
+#ifdef OSQUERY_STACK_ASAN
+#include <sanitizer/asan_interface.h>
+#endif
+
+namespace osquery {
+
+FLAG(uint64,
+     generator_stack_pool_size,
+     16,
+     "Coroutine stacks kept for reuse by generator tables");
+
+boost::context::stack_context GeneratorStackPool::allocate() {
+  WriteLock lock(mutex_);
+  if (stacks_.empty()) {
+    return allocator_.allocate();
+  }
+
+  auto sctx = stacks_.back();
+  stacks_.pop_back();
+#ifdef OSQUERY_STACK_ASAN
+  // Frames of the previous coroutine left poisoned redzones on the stack.
+  auto bottom = static_cast<char*>(sctx.sp) - sctx.size;
+  ASAN_UNPOISON_MEMORY_REGION(bottom, sctx.size);
+#endif
+  return sctx;
+}
+
+void GeneratorStackPool::deallocate(boost::context::stack_context& sctx) {
+  WriteLock lock(mutex_);
+  if (stacks_.size() < FLAGS_generator_stack_pool_size) {
+    stacks_.push_back(sctx);
+    return;
+  }
+  allocator_.deallocate(sctx);
+}
+
+size_t GeneratorStackPool::size() const {
+  ReadLock lock(mutex_);
+  return stacks_.size();
+}
+
+void GeneratorStackPool::clear() {
+  WriteLock lock(mutex_);
+  for (auto& sctx : stacks_) {
+    allocator_.deallocate(sctx);
+  }
+  stacks_.clear();
+}
+} // namespace osquery
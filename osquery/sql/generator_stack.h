@@ -0,0 +1,71 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <boost/context/protected_fixedsize_stack.hpp>
+#include <boost/context/stack_context.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief Reusable coroutine stacks for generator-based tables.
+ *
+ * Each scan of a generator table runs the generator in a coroutine with its
+ * own stack. Stacks are fixed-size with a guard page and are returned to the
+ * pool when the coroutine completes, so scans within JOINs reuse the same
+ * few stacks instead of mapping a new one for each xFilter.
+ */
+class GeneratorStackPool : private boost::noncopyable {
+ public:
+  static GeneratorStackPool& get() {
+    static GeneratorStackPool instance;
+    return instance;
+  }
+
+  /// Take a stack from the pool, or allocate a new one.
+  boost::context::stack_context allocate();
+
+  /// Return a stack to the pool, or free it if the pool is full.
+  void deallocate(boost::context::stack_context& sctx);
+
+  /// The number of stacks waiting for reuse.
+  size_t size() const;
+
+  /// Free the stacks waiting for reuse.
+  void clear();
+
+ private:
+  GeneratorStackPool() = default;
+
+ private:
+  boost::context::protected_fixedsize_stack allocator_;
+
+  std::vector<boost::context::stack_context> stacks_;
+
+  mutable Mutex mutex_;
+};
+
+/// A Boost.Context StackAllocator backed by the GeneratorStackPool.
+struct PooledStackAllocator {
+  boost::context::stack_context allocate() {
+    return GeneratorStackPool::get().allocate();
+  }
+
+  void deallocate(boost::context::stack_context& sctx) {
+    GeneratorStackPool::get().deallocate(sctx);
+  }
+};
+} // namespace osquery
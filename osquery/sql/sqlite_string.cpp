@@ -17,12 +17,18 @@
 #endif
 
 #include <functional>
+#include <memory>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/algorithm/string/regex.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/regex.hpp>
 
+#include <osquery/mutex.h>
+
 #include "osquery/core/conversions.h"
 
 #include <sqlite3.h>
@@ -33,6 +39,93 @@ using SplitResult = std::vector<std::string>;
 using StringSplitFunction = std::function<SplitResult(
     const std::string& input, const std::string& tokens)>;
 
+using RegexRef = std::shared_ptr<const boost::regex>;
+
+/// The number of compiled patterns kept for each connection.
+const size_t kRegexCacheSize = 64;
+
+/**
+ * @brief Compiled regex patterns of one database connection.
+ *
+ * SQLite keeps a compiled pattern as auxiliary data while the pattern
+ * argument is constant for a statement. This cache covers patterns that are
+ * not constant, such as patterns selected from a table, and statements that
+ * are prepared again for each query.
+ */
+class RegexCache : private boost::noncopyable {
+ public:
+  /// Get the compiled pattern, this throws boost::regex_error if invalid.
+  RegexRef get(const std::string& pattern) {
+    {
+      ReadLock lock(mutex_);
+      auto it = patterns_.find(pattern);
+      if (it != patterns_.end()) {
+        return it->second;
+      }
+    }
+
+    auto regex = std::make_shared<const boost::regex>(pattern);
+    WriteLock lock(mutex_);
+    if (patterns_.size() >= kRegexCacheSize) {
+      patterns_.clear();
+    }
+    patterns_[pattern] = regex;
+    return regex;
+  }
+
+ private:
+  std::unordered_map<std::string, RegexRef> patterns_;
+  Mutex mutex_;
+};
+
+using RegexCacheRef = std::shared_ptr<RegexCache>;
+
+static void deleteRegexCache(void* cache) {
+  delete static_cast<RegexCacheRef*>(cache);
+}
+
+static void deleteRegex(void* regex) {
+  delete static_cast<RegexRef*>(regex);
+}
+
+static inline std::string getText(sqlite3_value* value) {
+  auto text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+  return std::string(text, static_cast<size_t>(sqlite3_value_bytes(value)));
+}
+
+/**
+ * @brief Get the compiled pattern of a (non-NULL) function argument.
+ *
+ * On failure the context has an error result and nullptr is returned.
+ */
+static RegexRef getRegex(sqlite3_context* context,
+                         sqlite3_value** argv,
+                         int argument) {
+  auto cached = static_cast<RegexRef*>(sqlite3_get_auxdata(context, argument));
+  if (cached != nullptr) {
+    return *cached;
+  }
+
+  auto pattern = getText(argv[argument]);
+  RegexRef regex;
+  try {
+    auto cache = static_cast<RegexCacheRef*>(sqlite3_user_data(context));
+    if (cache != nullptr) {
+      regex = (*cache)->get(pattern);
+    } else {
+      regex = std::make_shared<const boost::regex>(pattern);
+    }
+  } catch (const boost::regex_error& e) {
+    auto error = "Invalid regex pattern: " + std::string(e.what());
+    sqlite3_result_error(context, error.c_str(), -1);
+    return nullptr;
+  }
+
+  // SQLite drops the data when the argument changes for the next row.
+  sqlite3_set_auxdata(context, argument, new RegexRef(regex), deleteRegex);
+  return regex;
+}
+
 /**
  * @brief A simple SQLite column string split implementation.
  *
@@ -68,10 +161,10 @@ static SplitResult tokenSplit(const std::string& input,
  *      192.168
  */
 static SplitResult regexSplit(const std::string& input,
-                              const std::string& token) {
+                              const boost::regex& token) {
   // Split using the token as a regex to support multi-character tokens.
   std::vector<std::string> result;
-  boost::algorithm::split_regex(result, input, boost::regex(token));
+  boost::algorithm::split_regex(result, input, token);
   return result;
 }
 
@@ -121,7 +214,150 @@ static void tokenStringSplitFunc(sqlite3_context* context,
 static void regexStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
-  callStringSplitFunc(context, argc, argv, regexSplit);
+  assert(argc == 3);
+  RegexRef regex;
+  if (SQLITE_NULL != sqlite3_value_type(argv[1]) &&
+      sqlite3_value_bytes(argv[1]) > 0) {
+    regex = getRegex(context, argv, 1);
+    if (regex == nullptr) {
+      return;
+    }
+  }
+
+  callStringSplitFunc(
+      context,
+      argc,
+      argv,
+      [&regex](const std::string& input, const std::string& token) {
+        return regexSplit(input, *regex);
+      });
+}
+
+/**
+ * @brief Match a column value with a regex, the REGEXP operator.
+ *
+ * SQLite calls the function with the pattern first, the value matches if the
+ * pattern is found anywhere in it.
+ *
+ * Example:
+ *   1. SELECT * FROM processes WHERE cmdline REGEXP 'nc(at)? -l';
+ */
+static void regexpFunc(sqlite3_context* context,
+                       int argc,
+                       sqlite3_value** argv) {
+  assert(argc == 2);
+  if (SQLITE_NULL == sqlite3_value_type(argv[0]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[1])) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  auto regex = getRegex(context, argv, 0);
+  if (regex == nullptr) {
+    return;
+  }
+
+  auto input = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+  auto end = input + sqlite3_value_bytes(argv[1]);
+  try {
+    sqlite3_result_int(context, boost::regex_search(input, end, *regex));
+  } catch (const std::runtime_error& e) {
+    // The pattern was too complex to match against the input.
+    sqlite3_result_error(context, e.what(), -1);
+  }
+}
+
+/**
+ * @brief Select a capture group of the first regex match in a column value.
+ *
+ * The group 0 is the complete match. If there is no match, or the group did
+ * not participate in the match, the result is NULL.
+ *
+ * Example:
+ *   1. SELECT REGEX_MATCH('hello 1.2.3', '(\d+)\.(\d+)', 2);
+ *      2
+ */
+static void regexMatchFunc(sqlite3_context* context,
+                           int argc,
+                           sqlite3_value** argv) {
+  assert(argc == 3);
+  if (SQLITE_NULL == sqlite3_value_type(argv[0]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[1]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[2])) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  auto regex = getRegex(context, argv, 1);
+  if (regex == nullptr) {
+    return;
+  }
+
+  auto input = getText(argv[0]);
+  auto index = sqlite3_value_int64(argv[2]);
+  boost::smatch match;
+  try {
+    if (index < 0 || !boost::regex_search(input, match, *regex) ||
+        static_cast<size_t>(index) >= match.size() ||
+        !match[static_cast<size_t>(index)].matched) {
+      sqlite3_result_null(context);
+      return;
+    }
+  } catch (const std::runtime_error& e) {
+    sqlite3_result_error(context, e.what(), -1);
+    return;
+  }
+
+  auto selected = match[static_cast<size_t>(index)].str();
+  sqlite3_result_text(context,
+                      selected.c_str(),
+                      static_cast<int>(selected.size()),
+                      SQLITE_TRANSIENT);
+}
+
+/**
+ * @brief Select one of the non-overlapping regex matches in a column value.
+ *
+ * Example:
+ *   1. SELECT REGEX_EXTRACT('a=1, b=22', '\d+', 1);
+ *      22
+ */
+static void regexExtractFunc(sqlite3_context* context,
+                             int argc,
+                             sqlite3_value** argv) {
+  assert(argc == 3);
+  if (SQLITE_NULL == sqlite3_value_type(argv[0]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[1]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[2])) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  auto regex = getRegex(context, argv, 1);
+  if (regex == nullptr) {
+    return;
+  }
+
+  auto input = getText(argv[0]);
+  auto index = sqlite3_value_int64(argv[2]);
+  try {
+    boost::sregex_iterator it(input.begin(), input.end(), *regex);
+    for (; index > 0 && it != boost::sregex_iterator(); --index) {
+      ++it;
+    }
+    if (index < 0 || it == boost::sregex_iterator()) {
+      sqlite3_result_null(context);
+      return;
+    }
+
+    auto selected = it->str();
+    sqlite3_result_text(context,
+                        selected.c_str(),
+                        static_cast<int>(selected.size()),
+                        SQLITE_TRANSIENT);
+  } catch (const std::runtime_error& e) {
+    sqlite3_result_error(context, e.what(), -1);
+  }
 }
 
 /**
@@ -161,14 +397,28 @@ void registerStringExtensions(sqlite3* db) {
                           tokenStringSplitFunc,
                           nullptr,
                           nullptr);
-  sqlite3_create_function(db,
-                          "regex_split",
-                          3,
-                          SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-                          nullptr,
-                          regexStringSplitFunc,
-                          nullptr,
-                          nullptr);
+
+  // The regex functions share the connection's compiled patterns.
+  auto cache = std::make_shared<RegexCache>();
+  const std::vector<std::tuple<const char*, int, decltype(regexpFunc)*>>
+      regex_functions = {
+          std::make_tuple("regex_split", 3, regexStringSplitFunc),
+          std::make_tuple("regexp", 2, regexpFunc),
+          std::make_tuple("regex_match", 3, regexMatchFunc),
+          std::make_tuple("regex_extract", 3, regexExtractFunc),
+      };
+  for (const auto& function : regex_functions) {
+    sqlite3_create_function_v2(db,
+                               std::get<0>(function),
+                               std::get<1>(function),
+                               SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                               new RegexCacheRef(cache),
+                               std::get<2>(function),
+                               nullptr,
+                               nullptr,
+                               deleteRegexCache);
+  }
+
   sqlite3_create_function(db,
                           "inet_aton",
                           1,
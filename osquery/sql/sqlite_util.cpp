@@ -8,12 +8,18 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <cctype>
+#include <set>
+
+#include "osquery/core/query_budget.h"
 #include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/table_statistics.h"
 #include "osquery/sql/virtual_table.h"
 
 #include <osquery/core.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
+#include <osquery/numeric_monitoring.h>
 #include <osquery/registry_factory.h>
 #include <osquery/sql.h>
 
@@ -28,8 +34,30 @@ FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     sql_pool_size,
+     4,
+     "Transient SQLite connections kept for concurrent queries");
+
+FLAG(uint64,
+     sql_statement_cache_size,
+     32,
+     "Prepared statements kept for reuse by each SQLite connection");
+
 using OpReg = QueryPlanner::Opcode::Register;
 
+/// SQLite virtual machine instructions between checks of a query budget.
+const int kQueryBudgetInstructions{1000};
+
+/// The longest a query waits for a pooled connection before opening another.
+const std::chrono::milliseconds kPoolWait{250};
+
+/// Pooled connections are kept for the most concurrent use in this window.
+const std::chrono::seconds kPoolWindow{60};
+
+/// Pooled connections checked out by the calling thread.
+thread_local size_t kPoolConnections{0};
+
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
 
 /**
@@ -203,7 +231,11 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   auto dbc = SQLiteDBManager::getConnection(true);
 
   // Attach as an extension, allowing read/write tables
-  return attachTableInternal(name, statement, dbc, is_extension);
+  status = attachTableInternal(name, statement, dbc, is_extension);
+
+  // Transient connections opened later will attach the table.
+  SQLiteDBManager::resetPool();
+  return status;
 }
 
 void SQLiteSQLPlugin::detach(const std::string& name) {
@@ -212,6 +244,49 @@ void SQLiteSQLPlugin::detach(const std::string& name) {
     return;
   }
   detachTableInternal(name, dbc);
+  SQLiteDBManager::resetPool();
+}
+
+SQLiteStatementCache::Statement* SQLiteStatementCache::find(
+    const std::string& query) {
+  auto statement = index_.find(query);
+  if (statement == index_.end()) {
+    return nullptr;
+  }
+
+  statements_.splice(statements_.begin(), statements_, statement->second);
+  return &statements_.front();
+}
+
+SQLiteStatementCache::Statement* SQLiteStatementCache::insert(
+    Statement statement) {
+  while (!statements_.empty() &&
+         statements_.size() >= FLAGS_sql_statement_cache_size) {
+    sqlite3_finalize(statements_.back().stmt);
+    index_.erase(statements_.back().query);
+    statements_.pop_back();
+  }
+
+  statements_.push_front(std::move(statement));
+  index_[statements_.front().query] = statements_.begin();
+  return &statements_.front();
+}
+
+bool SQLiteStatementCache::usesPlan(size_t index) const {
+  for (const auto& statement : statements_) {
+    if (index >= statement.first_plan && index < statement.last_plan) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SQLiteStatementCache::clear() {
+  for (const auto& statement : statements_) {
+    sqlite3_finalize(statement.stmt);
+  }
+  statements_.clear();
+  index_.clear();
 }
 
 SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
@@ -219,9 +294,8 @@ SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
   if (lock_.owns_lock()) {
     primary_ = true;
   } else {
+    // The manager provides a transient database instead.
     db_ = nullptr;
-    VLOG(1) << "DBManager contention: opening transient SQLite database";
-    init();
   }
 }
 
@@ -276,6 +350,64 @@ bool SQLiteDBInstance::tableCalled(VirtualTableContent* table) {
   return (affected_tables_.count(table->name) > 0);
 }
 
+std::shared_ptr<const QueryData> SQLiteDBInstance::findScan(
+    const std::string& table, const TableScan& scan) const {
+  auto table_scans = scans_.find(table);
+  if (table_scans == scans_.end()) {
+    return nullptr;
+  }
+
+  for (const auto& previous : table_scans->second) {
+    // The previous scan must have generated every requested column.
+    if (previous.columns) {
+      if (!scan.columns) {
+        continue;
+      }
+
+      bool columns = true;
+      for (const auto& column : *scan.columns) {
+        if (previous.columns->count(column) == 0) {
+          columns = false;
+          break;
+        }
+      }
+      if (!columns) {
+        continue;
+      }
+    }
+
+    // Each previous constraint must be requested, and the requested
+    // constraints not in the previous scan may only filter the rows.
+    bool terms = true;
+    auto it = previous.terms.begin();
+    for (const auto& term : scan.terms) {
+      if (it != previous.terms.end() && !(term < *it) && !(*it < term)) {
+        ++it;
+      } else if (term.index) {
+        terms = false;
+        break;
+      }
+    }
+
+    if (terms && it == previous.terms.end()) {
+      return previous.rows;
+    }
+  }
+  return nullptr;
+}
+
+bool SQLiteDBInstance::addScan(const std::string& table,
+                               TableScan scan,
+                               size_t limit) {
+  if (scan.rows == nullptr || scan_bytes_ + scan.bytes > limit) {
+    return false;
+  }
+
+  scan_bytes_ += scan.bytes;
+  scans_[table].push_back(std::move(scan));
+  return true;
+}
+
 TableAttributes SQLiteDBInstance::getAttributes() const {
   const SQLiteDBInstance* rdbc = this;
   if (isPrimary() && !managed_) {
@@ -290,6 +422,18 @@ TableAttributes SQLiteDBInstance::getAttributes() const {
   return attributes;
 }
 
+template <typename T>
+static void eraseUnusedPlans(std::unordered_map<size_t, T>& plans,
+                             const SQLiteStatementCache& statements) {
+  for (auto it = plans.begin(); it != plans.end();) {
+    if (statements.usesPlan(it->first)) {
+      ++it;
+    } else {
+      it = plans.erase(it);
+    }
+  }
+}
+
 void SQLiteDBInstance::clearAffectedTables() {
   if (isPrimary() && !managed_) {
     // A primary instance must forward clear requests to the DB manager's
@@ -299,18 +443,26 @@ void SQLiteDBInstance::clearAffectedTables() {
   }
 
   for (const auto& table : affected_tables_) {
-    table.second->constraints.clear();
+    // Plans of kept statements are used again by later queries.
+    eraseUnusedPlans(table.second->constraints, *statements_);
+    eraseUnusedPlans(table.second->colsUsed, *statements_);
     table.second->cache.clear();
-    table.second->colsUsed.clear();
   }
+  scans_.clear();
+  scan_bytes_ = 0;
+
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
   affected_tables_.clear();
   use_cache_ = false;
+
+  // Scans recorded statistics, these are occasionally persisted.
+  TableStatistics::get().persist();
 }
 
 SQLiteDBInstance::~SQLiteDBInstance() {
   if (!isPrimary() && db_ != nullptr) {
+    statements_->clear();
     sqlite3_close(db_);
   } else {
     db_ = nullptr;
@@ -331,6 +483,9 @@ void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
 
   WriteLock connection_lock(self.mutex_);
+  if (self.connection_ != nullptr) {
+    self.connection_->statements().clear();
+  }
   self.connection_.reset();
 
   {
@@ -338,6 +493,9 @@ void SQLiteDBManager::resetPrimary() {
     sqlite3_close(self.db_);
     self.db_ = nullptr;
   }
+
+  // Release the memory of idle transient connections too.
+  resetPool();
 }
 
 void SQLiteDBManager::setDisabledTables(const std::string& list) {
@@ -354,29 +512,152 @@ SQLiteDBInstanceRef SQLiteDBManager::getUnique() {
 
 SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
   auto& self = instance();
-  WriteLock lock(self.create_mutex_);
+  {
+    WriteLock lock(self.create_mutex_);
+
+    if (self.db_ == nullptr) {
+      // Create primary SQLite DB instance.
+      openOptimized(self.db_);
+      self.connection_ = SQLiteDBInstanceRef(new SQLiteDBInstance(self.db_));
+      attachVirtualTables(self.connection_);
+    }
+
+    // Internal usage may request the primary connection explicitly.
+    if (primary) {
+      return self.connection_;
+    }
 
-  if (self.db_ == nullptr) {
-    // Create primary SQLite DB instance.
-    openOptimized(self.db_);
-    self.connection_ = SQLiteDBInstanceRef(new SQLiteDBInstance(self.db_));
-    attachVirtualTables(self.connection_);
+    // Create a 'database connection' for the managed database instance.
+    auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
+    if (instance->isPrimary()) {
+      // Statements prepared for the primary database are shared.
+      instance->statements_ = self.connection_->statements_;
+      return instance;
+    }
   }
 
-  // Internal usage may request the primary connection explicitly.
-  if (primary) {
-    return self.connection_;
+  // The primary database is in use, check out a transient connection.
+  return self.checkout();
+}
+
+SQLiteDBInstanceRef SQLiteDBManager::checkout() {
+  std::unique_ptr<SQLiteDBInstance> instance;
+  std::vector<std::unique_ptr<SQLiteDBInstance>> stale;
+  auto generation = pool_generation_.load();
+  {
+    WriteLock lock(pool_mutex_);
+    auto limit = static_cast<size_t>(FLAGS_sql_pool_size);
+    if (pool_.empty() && limit > 0 && pool_busy_ >= limit &&
+        kPoolConnections == 0) {
+      // Nested queries do not wait, their thread holds a connection.
+      auto start = std::chrono::steady_clock::now();
+      pool_returned_.wait_for(lock, kPoolWait, [this, limit]() {
+        return !pool_.empty() || pool_busy_ < limit;
+      });
+      auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+      pool_metrics_.waits++;
+      pool_metrics_.wait_micros += static_cast<size_t>(waited);
+      monitoring::record("osquery.sql.pool.wait_micros",
+                         waited,
+                         monitoring::PreAggregationType::Avg);
+    }
+
+    while (!pool_.empty() && instance == nullptr) {
+      auto pooled = std::move(pool_.back());
+      pool_.pop_back();
+      if (pooled->generation_ == generation) {
+        instance = std::move(pooled);
+      } else {
+        stale.push_back(std::move(pooled));
+      }
+    }
+
+    if (instance != nullptr) {
+      pool_metrics_.reused++;
+    } else {
+      pool_metrics_.opened++;
+    }
+    pool_busy_++;
+    pool_peak_ = std::max(pool_peak_, pool_busy_);
+  }
+  kPoolConnections++;
+
+  // Connections are returned to the pool when the last reference is dropped.
+  auto deleter = [](SQLiteDBInstance* released) {
+    SQLiteDBManager::instance().release(released);
+  };
+  if (instance != nullptr) {
+    return SQLiteDBInstanceRef(instance.release(), deleter);
   }
 
-  // Create a 'database connection' for the managed database instance.
-  auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
-  if (!instance->isPrimary()) {
-    attachVirtualTables(instance);
+  VLOG(1) << "DBManager contention: opening transient SQLite database";
+  auto opened = SQLiteDBInstanceRef(new SQLiteDBInstance(), deleter);
+  opened->generation_ = generation;
+  attachVirtualTables(opened);
+  return opened;
+}
+
+void SQLiteDBManager::release(SQLiteDBInstance* instance) {
+  std::unique_ptr<SQLiteDBInstance> released(instance);
+  std::vector<std::unique_ptr<SQLiteDBInstance>> closed;
+  if (kPoolConnections > 0) {
+    kPoolConnections--;
+  }
+
+  // The next query must not see the tables used by the previous.
+  released->clearAffectedTables();
+
+  {
+    WriteLock lock(pool_mutex_);
+    pool_busy_--;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - pool_window_ > kPoolWindow) {
+      pool_last_peak_ = pool_peak_;
+      pool_peak_ = pool_busy_;
+      pool_window_ = now;
+    }
+
+    // Keep enough connections for the recent concurrency.
+    auto keep = std::min(static_cast<size_t>(FLAGS_sql_pool_size),
+                         std::max(pool_peak_, pool_last_peak_));
+    if (released->generation_ == pool_generation_ &&
+        pool_.size() + pool_busy_ < keep) {
+      pool_.push_back(std::move(released));
+    }
+    while (!pool_.empty() && pool_.size() + pool_busy_ > keep) {
+      closed.push_back(std::move(pool_.front()));
+      pool_.erase(pool_.begin());
+    }
+  }
+  pool_returned_.notify_one();
+}
+
+SQLiteDBManager::PoolMetrics SQLiteDBManager::poolMetrics() {
+  auto& self = instance();
+  WriteLock lock(self.pool_mutex_);
+  auto metrics = self.pool_metrics_;
+  metrics.idle = self.pool_.size();
+  return metrics;
+}
+
+void SQLiteDBManager::resetPool() {
+  auto& self = instance();
+  std::vector<std::unique_ptr<SQLiteDBInstance>> idle;
+  {
+    WriteLock lock(self.pool_mutex_);
+    self.pool_generation_++;
+    idle.swap(self.pool_);
   }
-  return instance;
 }
 
 SQLiteDBManager::~SQLiteDBManager() {
+  pool_.clear();
+  if (connection_ != nullptr) {
+    connection_->statements().clear();
+  }
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -398,6 +679,42 @@ QueryPlanner::QueryPlanner(const std::string& query,
   }
 }
 
+/**
+ * @brief Opcodes of programs that select and filter rows of a table scan.
+ *
+ * Expressions over the columns of the current row, constants, and jumps are
+ * allowed. Opcodes for ephemeral tables, sorters, aggregates, coroutines, and
+ * LIMIT counters are not.
+ */
+const std::set<std::string> kRowProjectionOpcodes = {
+    "Add", "Affinity", "And", "BitAnd", "BitNot", "BitOr", "Blob", "Cast",
+    "CollSeq", "Concat", "Copy", "Divide", "Eq", "Function", "Function0", "Ge",
+    "Goto", "Gt", "Halt", "If", "IfNot", "Init", "Int64", "IntCopy", "Integer",
+    "IsNull", "IsTrue", "Le", "Lt", "Move", "Multiply", "Ne", "Noop", "Not",
+    "NotNull", "Null", "Or", "PureFunc", "PureFunc0", "Real", "RealAffinity",
+    "Remainder", "ResultRow", "SCopy", "ShiftLeft", "ShiftRight", "SoftNull",
+    "String", "String8", "Subtract", "Transaction", "VColumn", "VFilter",
+    "VNext", "VOpen", "VRowid", "ZeroOrNull",
+};
+
+bool QueryPlanner::isRowProjection() const {
+  if (tables_.size() != 1) {
+    return false;
+  }
+
+  size_t opens = 0;
+  for (const auto& row : program_) {
+    const auto& opcode = row.at("opcode");
+    if (kRowProjectionOpcodes.count(opcode) == 0) {
+      return false;
+    }
+    if (opcode == "VOpen") {
+      opens++;
+    }
+  }
+  return opens == 1;
+}
+
 Status QueryPlanner::applyTypes(TableColumns& columns) {
   std::map<size_t, ColumnType> column_types;
   for (const auto& row : program_) {
@@ -477,21 +794,191 @@ int queryDataCallback(void* argument, int argc, char* argv[], char* column[]) {
       r[column[i]] = (argv[i] != nullptr) ? argv[i] : FLAGS_nullvalue;
     }
   }
+  auto tracker = QueryBudgetTracker::current();
+  if (tracker != nullptr) {
+    size_t bytes = 0;
+    for (const auto& column : r) {
+      bytes += column.first.size() + column.second.size();
+    }
+    tracker->addResults(1, bytes);
+  }
+
   (*qData).push_back(std::move(r));
+  if (tracker != nullptr && tracker->exceeded()) {
+    // Abort the query, the remaining results would exceed the budget.
+    return 1;
+  }
   return 0;
 }
 
+/**
+ * @brief The heap memory used by a connection.
+ *
+ * The process-wide sqlite3_memory_used includes the allocations of queries
+ * executing on other threads, only the connection's own use is charged.
+ */
+static sqlite3_int64 connectionMemory(sqlite3* db) {
+  sqlite3_int64 memory = 0;
+  for (auto op : {SQLITE_DBSTATUS_CACHE_USED,
+                  SQLITE_DBSTATUS_SCHEMA_USED,
+                  SQLITE_DBSTATUS_STMT_USED}) {
+    int current = 0;
+    int highwater = 0;
+    if (sqlite3_db_status(db, op, &current, &highwater, 0) == SQLITE_OK) {
+      memory += current;
+    }
+  }
+  return memory;
+}
+
+/// The budget of a query and the connection memory used when it started.
+struct BudgetProgress {
+  QueryBudgetTracker* tracker{nullptr};
+  sqlite3* db{nullptr};
+  sqlite3_int64 memory{0};
+};
+
+static int budgetProgressHandler(void* argument) {
+  auto progress = static_cast<BudgetProgress*>(argument);
+  auto memory = connectionMemory(progress->db) - progress->memory;
+  progress->tracker->setSQLiteMemory(
+      (memory > 0) ? static_cast<size_t>(memory) : 0);
+  // A non-zero return interrupts the query.
+  return progress->tracker->exceeded() ? 1 : 0;
+}
+
+/**
+ * @brief Find or prepare a statement kept for reuse by the connection.
+ *
+ * Only single, read-only statements are kept. Others return nullptr and are
+ * executed with sqlite3_exec, which also reports any errors preparing them.
+ */
+static SQLiteStatementCache::Statement* getStatement(
+    const std::string& q, const SQLiteDBInstanceRef& instance) {
+  if (FLAGS_sql_statement_cache_size == 0) {
+    return nullptr;
+  }
+
+  auto& statements = instance->statements();
+  auto statement = statements.find(q);
+  if (statement != nullptr) {
+    return statement;
+  }
+
+  SQLiteStatementCache::Statement prepared;
+  prepared.query = q;
+  prepared.first_plan = nextConstraintIndex();
+  const char* tail = nullptr;
+  auto rc = sqlite3_prepare_v2(instance->db(),
+                               q.c_str(),
+                               static_cast<int>(q.length() + 1),
+                               &prepared.stmt,
+                               &tail);
+  prepared.last_plan = nextConstraintIndex();
+  if (rc != SQLITE_OK || prepared.stmt == nullptr) {
+    sqlite3_finalize(prepared.stmt);
+    return nullptr;
+  }
+
+  while (tail != nullptr && std::isspace(static_cast<unsigned char>(*tail))) {
+    tail++;
+  }
+  if ((tail != nullptr && *tail != 0) ||
+      sqlite3_stmt_readonly(prepared.stmt) == 0) {
+    sqlite3_finalize(prepared.stmt);
+    return nullptr;
+  }
+
+  prepared.reprepares =
+      sqlite3_stmt_status(prepared.stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+  return statements.insert(std::move(prepared));
+}
+
+/// Step through a kept statement, see queryDataCallback.
+static Status stepStatement(SQLiteStatementCache::Statement& statement,
+                            QueryData& results,
+                            sqlite3* db) {
+  auto stmt = statement.stmt;
+  auto first_plan = nextConstraintIndex();
+
+  std::vector<char*> values;
+  std::vector<char*> names;
+  int rc = SQLITE_OK;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto columns = sqlite3_column_count(stmt);
+    values.resize(static_cast<size_t>(columns));
+    names.resize(static_cast<size_t>(columns));
+    for (int i = 0; i < columns; i++) {
+      values[i] = (char*)sqlite3_column_text(stmt, i);
+      names[i] = (char*)sqlite3_column_name(stmt, i);
+    }
+    if (queryDataCallback(&results, columns, values.data(), names.data()) !=
+        0) {
+      rc = SQLITE_ABORT;
+      break;
+    }
+  }
+
+  auto error = (rc == SQLITE_ABORT) ? std::string("query aborted")
+                                    : std::string(sqlite3_errmsg(db));
+  sqlite3_reset(stmt);
+
+  // SQLite prepares the statement again when the schema changes, this plans
+  // the virtual tables again.
+  auto reprepares = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 0);
+  if (reprepares != statement.reprepares) {
+    statement.reprepares = reprepares;
+    statement.first_plan = first_plan;
+    statement.last_plan = nextConstraintIndex();
+  }
+
+  if (rc != SQLITE_DONE) {
+    return Status(1, error);
+  }
+  return Status(0);
+}
+
 Status queryInternal(const std::string& q,
                      QueryData& results,
                      const SQLiteDBInstanceRef& instance) {
-  char* err = nullptr;
   auto lock = instance->attachLock();
-  sqlite3_exec(instance->db(), q.c_str(), queryDataCallback, &results, &err);
+  BudgetProgress progress;
+  progress.tracker = QueryBudgetTracker::current();
+  if (progress.tracker != nullptr) {
+    progress.db = instance->db();
+    progress.memory = connectionMemory(progress.db);
+    sqlite3_progress_handler(instance->db(),
+                             kQueryBudgetInstructions,
+                             budgetProgressHandler,
+                             &progress);
+  }
+
+  Status status;
+  auto statement = getStatement(q, instance);
+  if (statement != nullptr) {
+    status = stepStatement(*statement, results, instance->db());
+  } else {
+    char* err = nullptr;
+    sqlite3_exec(instance->db(), q.c_str(), queryDataCallback, &results, &err);
+    if (err != nullptr) {
+      status = Status(1, err);
+      sqlite3_free(err);
+    }
+  }
+
+  if (progress.tracker != nullptr) {
+    sqlite3_progress_handler(instance->db(), 0, nullptr, nullptr);
+  }
   sqlite3_db_release_memory(instance->db());
-  if (err != nullptr) {
-    auto error_string = std::string(err);
-    sqlite3_free(err);
-    return Status(1, "Error running query: " + error_string);
+
+  if (progress.tracker != nullptr && !progress.tracker->reason().empty()) {
+    // The query was interrupted, or aborted, by its budget.
+    return Status(1,
+                  "Query exceeded its budget: " + progress.tracker->reason());
+  }
+
+  if (!status.ok()) {
+    return Status(1, "Error running query: " + status.getMessage());
   }
   return Status(0, "OK");
 }
@@ -11,8 +11,14 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <sqlite3.h>
@@ -28,6 +34,100 @@ namespace osquery {
 
 class SQLiteDBManager;
 
+/**
+ * @brief A virtual table scan, kept for reuse within a query.
+ *
+ * When a virtual table is the inner side of a JOIN, SQLite filters (scans)
+ * the table once for each outer row. Scans with the same constraints, or with
+ * additional constraints that only filter rows, reuse the generated rows.
+ */
+struct TableScan {
+  /// A scan constraint: the column, operator, and expression.
+  struct Term {
+    std::string column;
+    unsigned char op;
+    std::string expr;
+
+    /// The table uses this constraint to select what it generates.
+    bool index{false};
+
+    bool operator<(const Term& other) const {
+      return std::tie(column, op, expr) <
+             std::tie(other.column, other.op, other.expr);
+    }
+  };
+
+  /// Sorted and unique constraints used to generate the rows.
+  std::vector<Term> terms;
+
+  /// The columns requested from the table, unset if all were requested.
+  boost::optional<UsedColumns> columns;
+
+  /// Rows generated by the table.
+  std::shared_ptr<const QueryData> rows;
+
+  /// The estimated size of the rows.
+  size_t bytes{0};
+};
+
+/**
+ * @brief Prepared statements kept for reuse by a SQLite connection.
+ *
+ * Preparing a statement parses the query and asks each virtual table for a
+ * plan (xBestIndex). Queries that run repeatedly, such as scheduled queries,
+ * reuse the statement and its plans. Each statement remembers the range of
+ * plan indexes assigned while it was prepared, the virtual tables keep the
+ * constraints for those plans between queries.
+ *
+ * Access is serialized by the owning connection.
+ */
+class SQLiteStatementCache : private boost::noncopyable {
+ public:
+  /// A prepared statement and the virtual table plans it uses.
+  struct Statement {
+    std::string query;
+
+    sqlite3_stmt* stmt{nullptr};
+
+    /// The first plan index assigned while preparing the statement.
+    size_t first_plan{0};
+
+    /// The plan index following the last assigned while preparing.
+    size_t last_plan{0};
+
+    /// SQLite's count of times the statement was prepared again.
+    int reprepares{0};
+  };
+
+  ~SQLiteStatementCache() {
+    clear();
+  }
+
+  /// Find the statement for a query and mark it most recently used.
+  Statement* find(const std::string& query);
+
+  /// Keep a statement, finalizing the least recently used if full.
+  Statement* insert(Statement statement);
+
+  /// Check if a virtual table plan is used by a kept statement.
+  bool usesPlan(size_t index) const;
+
+  /// The number of kept statements.
+  size_t size() const {
+    return statements_.size();
+  }
+
+  /// Finalize all kept statements.
+  void clear();
+
+ private:
+  /// Statements ordered from most to least recently used.
+  std::list<Statement> statements_;
+
+  /// Index of statements by query.
+  std::unordered_map<std::string, std::list<Statement>::iterator> index_;
+};
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -37,7 +137,7 @@ class SQLiteDBManager;
  *
  * If there is resource contention (multiple threads want access to the SQLite
  * abstraction layer), then the SQLiteDBManager will provide a transient
- * SQLiteDBInstance.
+ * SQLiteDBInstance. Transient instances are returned to a pool for reuse.
  */
 class SQLiteDBInstance : private boost::noncopyable {
  public:
@@ -78,9 +178,39 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Check if the query requested use of the warm query cache.
   bool useCache() const;
 
+  /**
+   * @brief Find the rows of an earlier scan within this query.
+   *
+   * An earlier scan of the table is reused if its constraints are a subset of
+   * the requested constraints, the additional constraints are not used by the
+   * table (SQLite applies them to the returned rows), and it included all of
+   * the requested columns.
+   *
+   * @param table the virtual table name.
+   * @param scan the requested constraints and columns.
+   * @return the rows, or nullptr if no earlier scan can be used.
+   */
+  std::shared_ptr<const QueryData> findScan(const std::string& table,
+                                            const TableScan& scan) const;
+
+  /**
+   * @brief Keep the rows of a scan for the rest of the query.
+   *
+   * @param table the virtual table name.
+   * @param scan the constraints, columns, and rows of the scan.
+   * @param limit the maximum bytes of scans kept for the query.
+   * @return false if the rows do not fit within the limit.
+   */
+  bool addScan(const std::string& table, TableScan scan, size_t limit);
+
   /// Lock the database for attaching virtual tables.
   RecursiveLock attachLock() const;
 
+  /// Prepared statements kept for the database.
+  SQLiteStatementCache& statements() const {
+    return *statements_;
+  }
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -103,6 +233,13 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Either the managed primary database or an ephemeral instance.
   sqlite3* db_{nullptr};
 
+  /// Statements prepared for db_, shared by all primary instances.
+  std::shared_ptr<SQLiteStatementCache> statements_{
+      std::make_shared<SQLiteStatementCache>()};
+
+  /// The SQLiteDBManager pool generation when tables were attached.
+  size_t generation_{0};
+
   /**
    * @brief An attempted unique lock on the manager's primary database mutex.
    *
@@ -126,6 +263,12 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, VirtualTableContent*> affected_tables_;
 
+  /// Table scans kept until the affected tables are cleared.
+  std::map<std::string, std::vector<TableScan>> scans_;
+
+  /// The estimated size of all kept table scans.
+  size_t scan_bytes_{0};
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
@@ -194,6 +337,35 @@ class SQLiteDBManager : private boost::noncopyable {
    */
   static bool isDisabled(const std::string& table_name);
 
+  /// Counters for the pool of transient connections.
+  struct PoolMetrics {
+    /// Connections opened, with all virtual tables attached.
+    size_t opened{0};
+
+    /// Connections reused from the pool.
+    size_t reused{0};
+
+    /// Requests that waited for a connection to be returned.
+    size_t waits{0};
+
+    /// Total microseconds spent waiting.
+    size_t wait_micros{0};
+
+    /// Connections idle in the pool.
+    size_t idle{0};
+  };
+
+  /// Inspect the transient connection pool.
+  static PoolMetrics poolMetrics();
+
+  /**
+   * @brief Close the pooled connections when virtual tables change.
+   *
+   * Pooled connections have every table attached when they are opened, they
+   * are replaced when tables are attached or detached from the primary.
+   */
+  static void resetPool();
+
  protected:
   SQLiteDBManager();
   virtual ~SQLiteDBManager();
@@ -224,6 +396,39 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Check out a transient connection, waiting if the pool is exhausted.
+  SQLiteDBInstanceRef checkout();
+
+  /// Return a transient connection to the pool, or close it.
+  void release(SQLiteDBInstance* instance);
+
+ private:
+  /// Idle transient connections with all virtual tables attached.
+  std::vector<std::unique_ptr<SQLiteDBInstance>> pool_;
+
+  /// Transient connections checked out of the pool.
+  size_t pool_busy_{0};
+
+  /// The most connections checked out during the current window.
+  size_t pool_peak_{0};
+
+  /// The most connections checked out during the previous window.
+  size_t pool_last_peak_{0};
+
+  /// The start of the current window of pool use.
+  std::chrono::steady_clock::time_point pool_window_;
+
+  /// Incremented when pooled connections no longer match the tables.
+  std::atomic<size_t> pool_generation_{0};
+
+  PoolMetrics pool_metrics_;
+
+  /// Protects the pool and its counters.
+  Mutex pool_mutex_;
+
+  /// Signaled when a connection is returned.
+  std::condition_variable_any pool_returned_;
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
@@ -264,6 +469,15 @@ class QueryPlanner : private boost::noncopyable {
     return tables_;
   }
 
+  /**
+   * @brief Check if the query only selects and filters rows of one table.
+   *
+   * The program may only scan one virtual table once, and may not sort,
+   * aggregate, deduplicate, limit, or evaluate subqueries. Each result row
+   * then depends on exactly one row of the table.
+   */
+  bool isRowProjection() const;
+
   /**
    * @brief A helper structure to represent an opcode's result and type.
    *
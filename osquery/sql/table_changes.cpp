@@ -0,0 +1,60 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <osquery/registry_factory.h>
+
+#include "osquery/sql/table_changes.h"
+
+namespace osquery {
+
+namespace {
+thread_local TableChangeFeed* kCurrentFeed{nullptr};
+} // namespace
+
+TableChangeFeed::Scope::Scope(TableChangeFeed* feed)
+    : previous_(kCurrentFeed) {
+  kCurrentFeed = feed;
+}
+
+TableChangeFeed::Scope::~Scope() {
+  kCurrentFeed = previous_;
+}
+
+TableChangeFeed::TableChangeFeed(std::string table, std::string cursor)
+    : table_(std::move(table)), since_(std::move(cursor)) {}
+
+TableChangeFeed* TableChangeFeed::current() {
+  return kCurrentFeed;
+}
+
+Status TableChangeFeed::scan(QueryContext& context, QueryData& results) {
+  if (!requested_) {
+    requested_ = true;
+    if (!Registry::get().exists("table", table_, true)) {
+      status_ = Status(1, "Table is not local: " + table_);
+    } else {
+      auto plugin = Registry::get().plugin("table", table_);
+      auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
+      if (table == nullptr || !table->providesChanges()) {
+        status_ = Status(1, "Table does not provide changes: " + table_);
+      } else {
+        status_ = table->changes(context, since_, changes_);
+      }
+    }
+  }
+
+  if (!status_.ok()) {
+    return status_;
+  }
+
+  results = (rows_ == ADDED) ? changes_.added : changes_.removed;
+  return Status(0, "OK");
+}
+} // namespace osquery
@@ -0,0 +1,100 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief Replace scans of a table with the rows it changed since a cursor.
+ *
+ * A query that selects and filters columns of a single table produces, for
+ * any subset of the table's rows, the matching subset of its results. Running
+ * the query once over the added rows and once over the removed rows yields
+ * the differential of its results without a full scan.
+ *
+ * The table's changes are requested once, by the first scan within a Scope.
+ * Each scan yields the selected ADDED or REMOVED rows.
+ */
+class TableChangeFeed : private boost::noncopyable {
+ public:
+  /// The changed rows yielded to scans of the table.
+  enum Rows {
+    ADDED,
+    REMOVED,
+  };
+
+  /// Install a feed on the calling thread for the lifetime of the scope.
+  class Scope : private boost::noncopyable {
+   public:
+    explicit Scope(TableChangeFeed* feed);
+    ~Scope();
+
+   private:
+    /// The feed this replaced on the thread.
+    TableChangeFeed* previous_{nullptr};
+  };
+
+ public:
+  TableChangeFeed(std::string table, std::string cursor);
+
+  /// The feed installed on the calling thread, or nullptr.
+  static TableChangeFeed* current();
+
+  /// Select the rows yielded by the following scans.
+  void select(Rows rows) {
+    rows_ = rows;
+  }
+
+  /**
+   * @brief Fill results with the selected rows of the table's changes.
+   *
+   * @param context the query context of the scan.
+   * @param results [output] the selected changed rows.
+   * @return failure if the table did not provide changes.
+   */
+  Status scan(QueryContext& context, QueryData& results);
+
+  /// The table this feed replaces scans of.
+  const std::string& table() const {
+    return table_;
+  }
+
+  /// The cursor to request the next changes with, empty until scanned.
+  const std::string& cursor() const {
+    return changes_.cursor;
+  }
+
+  /// True if a scan requested the table's changes and they were provided.
+  bool ok() const {
+    return requested_ && status_.ok();
+  }
+
+ private:
+  std::string table_;
+
+  /// The cursor the changes are requested since.
+  std::string since_;
+
+  Rows rows_{ADDED};
+
+  bool requested_{false};
+
+  Status status_;
+
+  TableChanges changes_;
+};
+} // namespace osquery
@@ -0,0 +1,237 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+
+#include <osquery/database.h>
+#include <osquery/logger.h>
+#include <osquery/system.h>
+
+#include "osquery/core/json.h"
+#include "osquery/sql/table_statistics.h"
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+/// Statistics are stored in the settings domain with this key prefix.
+const std::string kTableStatisticsPrefix{"table_statistics."};
+
+/// Seconds between writes of changed statistics.
+const size_t kTableStatisticsInterval{300};
+
+/// Scans observed before an estimate is used.
+const size_t kTableStatisticsMinScans{3};
+
+/// The planner cost of a scan without index constraints.
+const double kTableStatisticsScanCost{200};
+
+/// Observed microseconds of a scan costing half of kTableStatisticsScanCost.
+const double kTableStatisticsScanMicros{10000};
+
+/// Past this many scans the totals are halved, favoring recent scans.
+const size_t kTableStatisticsMaxScans{1024};
+
+/// The assumed fraction of rows selected by an unobserved index column.
+const double kTableStatisticsIndexSelectivity{0.1};
+
+static void addScans(TableStatistics::Scans& scans,
+                     size_t rows,
+                     size_t micros) {
+  if (scans.count >= kTableStatisticsMaxScans) {
+    scans.count /= 2;
+    scans.rows /= 2;
+    scans.micros /= 2;
+  }
+
+  scans.count++;
+  scans.rows += rows;
+  scans.micros += micros;
+}
+
+static size_t getMember(const rj::Value& obj, const char* name) {
+  auto it = obj.FindMember(name);
+  if (it == obj.MemberEnd()) {
+    return 0;
+  }
+  return JSON::valueToSize(it->value);
+}
+
+static void readScans(const rj::Value& obj, TableStatistics::Scans& scans) {
+  if (!obj.IsObject()) {
+    return;
+  }
+
+  scans.count = getMember(obj, "count");
+  scans.rows = getMember(obj, "rows");
+  scans.micros = getMember(obj, "micros");
+}
+
+static void writeScans(JSON& doc,
+                       const TableStatistics::Scans& scans,
+                       rj::Value& obj) {
+  doc.add("count", scans.count, obj);
+  doc.add("rows", scans.rows, obj);
+  doc.add("micros", scans.micros, obj);
+}
+
+TableStatistics::Table& TableStatistics::load(const std::string& table) {
+  auto& stats = tables_[table];
+  if (stats.loaded) {
+    return stats;
+  }
+
+  stats.loaded = true;
+  if (!DatabasePlugin::kDBInitialized) {
+    return stats;
+  }
+
+  std::string content;
+  auto key = kTableStatisticsPrefix + table;
+  if (!getDatabaseValue(kPersistentSettings, key, content).ok() ||
+      content.empty()) {
+    return stats;
+  }
+
+  auto doc = JSON::newObject();
+  if (!doc.fromString(content).ok() || !doc.doc().IsObject()) {
+    VLOG(1) << "Cannot parse statistics for table: " << table;
+    return stats;
+  }
+
+  auto full = doc.doc().FindMember("full");
+  if (full != doc.doc().MemberEnd()) {
+    readScans(full->value, stats.full);
+  }
+
+  auto index = doc.doc().FindMember("index");
+  if (index != doc.doc().MemberEnd() && index->value.IsObject()) {
+    for (const auto& column : index->value.GetObject()) {
+      readScans(column.value, stats.index[column.name.GetString()]);
+    }
+  }
+  return stats;
+}
+
+void TableStatistics::record(const std::string& table,
+                             const std::set<std::string>& columns,
+                             size_t rows,
+                             size_t micros) {
+  WriteLock lock(mutex_);
+  auto& stats = load(table);
+  if (columns.empty()) {
+    addScans(stats.full, rows, micros);
+  }
+
+  for (const auto& column : columns) {
+    addScans(stats.index[column], rows, micros);
+  }
+  stats.dirty = true;
+}
+
+double TableStatistics::Estimate::planCost() const {
+  auto scaled = cost / (cost + kTableStatisticsScanMicros);
+  return 1 + kTableStatisticsScanCost * scaled;
+}
+
+TableStatistics::Estimate TableStatistics::estimate(
+    const std::string& table, const std::set<std::string>& columns) {
+  WriteLock lock(mutex_);
+  const auto& stats = load(table);
+
+  Estimate estimate;
+  auto use = [&estimate](const Scans& scans) {
+    auto rows = static_cast<double>(scans.rows) / scans.count;
+    if (estimate.known && estimate.rows <= rows) {
+      return;
+    }
+
+    estimate.known = true;
+    estimate.rows = rows;
+    estimate.cost = static_cast<double>(scans.micros) / scans.count;
+  };
+
+  if (columns.empty()) {
+    if (stats.full.count >= kTableStatisticsMinScans) {
+      use(stats.full);
+    }
+  } else {
+    // Use the most selective of the observed index columns.
+    for (const auto& column : columns) {
+      auto scans = stats.index.find(column);
+      if (scans != stats.index.end() &&
+          scans->second.count >= kTableStatisticsMinScans) {
+        use(scans->second);
+      }
+    }
+
+    if (!estimate.known && stats.full.count >= kTableStatisticsMinScans) {
+      // Assume the index selects a fraction of the rows of a full scan.
+      const auto& full = stats.full;
+      auto row_cost = static_cast<double>(full.micros) /
+                      std::max(full.rows, static_cast<size_t>(1));
+      estimate.known = true;
+      estimate.rows = std::max(1.0,
+                               kTableStatisticsIndexSelectivity *
+                                   static_cast<double>(full.rows) / full.count);
+      estimate.cost = row_cost * estimate.rows;
+    }
+  }
+
+  // SQLite expects a non-zero cost.
+  estimate.cost = std::max(estimate.cost, 1.0);
+  return estimate;
+}
+
+void TableStatistics::persist(bool force) {
+  WriteLock lock(mutex_);
+  auto now = getUnixTime();
+  if (!force && now < persisted_ + kTableStatisticsInterval) {
+    return;
+  }
+
+  persisted_ = now;
+  if (!DatabasePlugin::kDBInitialized) {
+    return;
+  }
+
+  for (auto& table : tables_) {
+    auto& stats = table.second;
+    if (!stats.dirty) {
+      continue;
+    }
+
+    auto doc = JSON::newObject();
+    auto full = doc.getObject();
+    writeScans(doc, stats.full, full);
+    doc.add("full", full);
+
+    auto index = doc.getObject();
+    for (const auto& column : stats.index) {
+      auto scans = doc.getObject();
+      writeScans(doc, column.second, scans);
+      doc.add(column.first, scans, index);
+    }
+    doc.add("index", index);
+
+    std::string content;
+    doc.toString(content);
+    setDatabaseValue(
+        kPersistentSettings, kTableStatisticsPrefix + table.first, content);
+    stats.dirty = false;
+  }
+}
+
+void TableStatistics::clear() {
+  WriteLock lock(mutex_);
+  tables_.clear();
+  persisted_ = 0;
+}
+} // namespace osquery
@@ -0,0 +1,135 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief Observed costs of virtual table scans, used to plan queries.
+ *
+ * Each scan of a virtual table records the number of rows and the time spent
+ * generating them. Scans without index constraints are recorded as full
+ * scans, scans with equality constraints on INDEX or REQUIRED columns are
+ * recorded for each constrained column.
+ *
+ * Statistics are persisted in the database and loaded when a table is first
+ * planned, so a restarted daemon keeps its estimates.
+ */
+class TableStatistics : private boost::noncopyable {
+ public:
+  /// Accumulated scans of one kind.
+  struct Scans {
+    /// Number of scans.
+    size_t count{0};
+
+    /// Total rows generated by the scans.
+    size_t rows{0};
+
+    /// Total microseconds spent generating rows.
+    size_t micros{0};
+  };
+
+  /// The observed statistics of a table.
+  struct Table {
+    /// Scans without index constraints.
+    Scans full;
+
+    /// Scans with an equality constraint on an index column.
+    std::map<std::string, Scans> index;
+
+    /// Loaded from, or attempted to load from, the database.
+    bool loaded{false};
+
+    /// Changed since it was persisted.
+    bool dirty{false};
+  };
+
+  /// An estimate of a scan for the SQLite planner.
+  struct Estimate {
+    /// False if there are not enough observations for an estimate.
+    bool known{false};
+
+    /// Rows the scan is expected to generate.
+    double rows{0};
+
+    /// Microseconds the scan is expected to take.
+    double cost{0};
+
+    /**
+     * @brief The cost of the scan in the units of the planner's constants.
+     *
+     * xBestIndex scores a scan with a base cost of 1 and adds 200 when index
+     * columns are not constrained. The observed microseconds are scaled into
+     * that range, so the penalties for unusable and required constraints
+     * still dominate an observed cost.
+     */
+    double planCost() const;
+  };
+
+ public:
+  static TableStatistics& get() {
+    static TableStatistics instance;
+    return instance;
+  }
+
+  /**
+   * @brief Record a completed scan of a table.
+   *
+   * @param table the virtual table name.
+   * @param columns index columns with equality constraints, empty for a full
+   * scan.
+   * @param rows the number of generated rows.
+   * @param micros the time spent generating rows.
+   */
+  void record(const std::string& table,
+              const std::set<std::string>& columns,
+              size_t rows,
+              size_t micros);
+
+  /**
+   * @brief Estimate the rows and cost of a scan of a table.
+   *
+   * @param table the virtual table name.
+   * @param columns index columns with equality constraints, empty for a full
+   * scan.
+   */
+  Estimate estimate(const std::string& table,
+                    const std::set<std::string>& columns);
+
+  /// Write changed statistics to the database, at most once an interval.
+  void persist(bool force = false);
+
+  /// Remove statistics from memory, they are reloaded from the database.
+  void clear();
+
+ private:
+  TableStatistics() = default;
+
+  /// Get the statistics for a table, loading them if needed.
+  Table& load(const std::string& table);
+
+ private:
+  std::map<std::string, Table> tables_;
+
+  /// The time statistics were last persisted.
+  size_t persisted_{0};
+
+  Mutex mutex_;
+};
+} // namespace osquery
@@ -156,6 +156,63 @@ TEST_F(SQLTests, test_sql_sha256) {
             "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08");
 }
 
+TEST_F(SQLTests, test_sql_regex_split) {
+  QueryData d;
+  query("select regex_split('a1b22c', '\\d+', 2) as test;", d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["test"], "c");
+}
+
+TEST_F(SQLTests, test_sql_regexp) {
+  QueryData d;
+  query(
+      "select 'nc -l 4444' regexp 'nc(at)? -l' as matched, "
+      "'ncat -k' regexp 'nc(at)? -l' as unmatched;",
+      d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["matched"], "1");
+  EXPECT_EQ(d[0]["unmatched"], "0");
+
+  // Patterns may change for each row.
+  QueryData d2;
+  query(
+      "with patterns(p) as (values('^a'), ('b$'), ('^a')) "
+      "select count(*) as test from patterns where 'ab' regexp p;",
+      d2);
+  ASSERT_EQ(d2.size(), 1U);
+  EXPECT_EQ(d2[0]["test"], "3");
+}
+
+TEST_F(SQLTests, test_sql_regex_match) {
+  QueryData d;
+  query(
+      "select regex_match('version 1.22', '(\\d+)\\.(\\d+)', 2) as minor, "
+      "regex_match('version', '(\\d+)', 1) as missing, "
+      "regex_match('version 1', '(\\d+)', 2) as out_of_range;",
+      d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["minor"], "22");
+  EXPECT_EQ(d[0]["missing"], "");
+  EXPECT_EQ(d[0]["out_of_range"], "");
+}
+
+TEST_F(SQLTests, test_sql_regex_extract) {
+  QueryData d;
+  query(
+      "select regex_extract('a=1, b=22, c=333', '\\d+', 1) as second, "
+      "regex_extract('a=1', '\\d+', 1) as missing;",
+      d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["second"], "22");
+  EXPECT_EQ(d[0]["missing"], "");
+}
+
+TEST_F(SQLTests, test_sql_regex_invalid) {
+  QueryData d;
+  auto status = query("select regex_match('a', '(', 0) as test;", d);
+  EXPECT_FALSE(status.ok());
+}
+
 #ifdef OSQUERY_POSIX
 TEST_F(SQLTests, test_sql_ssdeep_compare) {
   QueryData d;
@@ -15,6 +15,7 @@
 #include <osquery/core.h>
 #include <osquery/sql.h>
 
+#include "osquery/core/query_budget.h"
 #include "osquery/sql/sqlite_util.h"
 #include "osquery/tests/test_util.h"
 
@@ -64,6 +65,51 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   EXPECT_EQ(internal_db, SQLiteDBManager::get()->db());
 }
 
+TEST_F(SQLiteUtilTests, test_connection_pool) {
+  // Hold the primary so the following requests use transient connections.
+  auto primary = SQLiteDBManager::get();
+  ASSERT_TRUE(primary->isPrimary());
+
+  sqlite3* transient_db = nullptr;
+  {
+    auto dbc = SQLiteDBManager::get();
+    EXPECT_FALSE(dbc->isPrimary());
+    transient_db = dbc->db();
+  }
+
+  // The returned connection is reused, with its virtual tables attached.
+  auto reused = SQLiteDBManager::poolMetrics().reused;
+  auto dbc = SQLiteDBManager::get();
+  EXPECT_EQ(transient_db, dbc->db());
+  EXPECT_EQ(reused + 1, SQLiteDBManager::poolMetrics().reused);
+
+  QueryData results;
+  EXPECT_TRUE(queryInternal("select * from time", results, dbc).ok());
+  EXPECT_EQ(results.size(), 1U);
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto dbc = SQLiteDBManager::getUnique();
+  std::string query =
+      "select * from osquery_flags where name = 'logger_plugin'";
+
+  QueryData first;
+  EXPECT_TRUE(queryInternal(query, first, dbc).ok());
+  EXPECT_EQ(dbc->statements().size(), 1U);
+
+  // The kept statement uses its virtual table plan again.
+  QueryData second;
+  EXPECT_TRUE(queryInternal(query, second, dbc).ok());
+  EXPECT_EQ(dbc->statements().size(), 1U);
+  EXPECT_EQ(first.size(), 1U);
+  EXPECT_EQ(first, second);
+
+  // Statements that write are not kept.
+  QueryData results;
+  queryInternal("create table test_cache (a int)", results, dbc);
+  EXPECT_EQ(dbc->statements().size(), 1U);
+}
+
 TEST_F(SQLiteUtilTests, test_reset) {
   auto internal_db = SQLiteDBManager::get()->db();
   ASSERT_NE(nullptr, internal_db);
@@ -110,6 +156,59 @@ TEST_F(SQLiteUtilTests, test_aggregate_query) {
   EXPECT_EQ(results, getTestDBExpectedResults());
 }
 
+TEST_F(SQLiteUtilTests, test_query_budget) {
+  auto dbc = SQLiteDBManager::getUnique();
+  std::string query =
+      "WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM c "
+      "WHERE i < 1000) SELECT i FROM c";
+
+  QueryData results;
+  {
+    QueryBudget budget;
+    budget.rows = 10;
+    QueryBudgetTracker tracker(budget);
+    auto status = queryInternal(query, results, dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_NE(status.getMessage().find("rows"), std::string::npos);
+    // The query is aborted by the row exceeding the budget.
+    EXPECT_EQ(results.size(), 11U);
+  }
+
+  // Without a budget the same connection completes the query.
+  EXPECT_TRUE(QueryBudgetTracker::current() == nullptr);
+  results.clear();
+  EXPECT_TRUE(queryInternal(query, results, dbc).ok());
+  EXPECT_EQ(results.size(), 1000U);
+
+  // Rows generated by tables count towards the memory budget.
+  results.clear();
+  {
+    QueryBudget budget;
+    budget.memory = 1;
+    QueryBudgetTracker tracker(budget);
+    auto status = queryInternal("SELECT * FROM time", results, dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_NE(status.getMessage().find("memory"), std::string::npos);
+    EXPECT_TRUE(queryBudgetExceeded());
+  }
+  EXPECT_FALSE(queryBudgetExceeded());
+
+  // Memory released by a scan no longer counts towards the budget.
+  {
+    QueryBudget budget;
+    budget.memory = 100;
+    QueryBudgetTracker tracker(budget);
+    for (size_t i = 0; i < 10; i++) {
+      tracker.addMemory(80);
+      tracker.releaseMemory(80);
+    }
+    EXPECT_FALSE(tracker.exceeded());
+    tracker.releaseMemory(80);
+    tracker.addMemory(101);
+    EXPECT_TRUE(tracker.exceeded());
+  }
+}
+
 TEST_F(SQLiteUtilTests, test_get_test_db_result_stream) {
   auto dbc = getTestDBC();
   auto results = getTestDBResultStream();
@@ -281,4 +380,31 @@ TEST_F(SQLiteUtilTests, test_query_planner) {
   getQueryColumnsInternal(query, columns, dbc);
   EXPECT_EQ(getTypes(columns), TypeList({BLOB_TYPE}));
 }
+
+TEST_F(SQLiteUtilTests, test_query_planner_row_projection) {
+  auto dbc = getTestDBC();
+
+  // Columns and expressions of the rows of one table, filtered.
+  std::vector<std::string> queries = {
+      "select hour, minutes from time",
+      "select upper(weekday) || 'x' as w from time where seconds > 1",
+      "select * from time where hour > 1 and minutes is not null",
+  };
+  for (const auto& query : queries) {
+    EXPECT_TRUE(QueryPlanner(query, dbc).isRowProjection()) << query;
+  }
+
+  // Results that depend on other rows or tables.
+  queries = {
+      "select count(*) from time",
+      "select distinct hour from time",
+      "select hour from time order by minutes",
+      "select hour from time limit 1",
+      "select seconds from time, osquery_info",
+      "select hour from time where hour in (select minutes from time)",
+  };
+  for (const auto& query : queries) {
+    EXPECT_FALSE(QueryPlanner(query, dbc).isRowProjection()) << query;
+  }
+}
 }
@@ -11,14 +11,20 @@
 #include <gtest/gtest.h>
 
 #include <osquery/core.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/registry.h>
 #include <osquery/sql.h>
 
+#include "osquery/sql/generator_stack.h"
+#include "osquery/sql/table_changes.h"
+#include "osquery/sql/table_statistics.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
 
+DECLARE_uint64(table_scan_cache_size);
+
 class VirtualTableTests : public testing::Test {};
 
 // sample plugin used on tests
@@ -586,6 +592,27 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+TEST_F(VirtualTableTests, test_yield_generator_stacks) {
+  auto table = std::make_shared<yieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("yield_stacks", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal(
+      "yield_stacks", table->columnDefinition(false), dbc, false);
+
+  GeneratorStackPool::get().clear();
+  QueryData results;
+  // The inner generator is scanned once for each row of the outer generator.
+  queryInternal("SELECT * from yield_stacks a, yield_stacks b", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 100U);
+
+  // At most two coroutines were running, each scan reused their stacks.
+  EXPECT_GE(GeneratorStackPool::get().size(), 1U);
+  EXPECT_LE(GeneratorStackPool::get().size(), 2U);
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -833,4 +860,275 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, i->scans);
   EXPECT_EQ(10U, j->scans);
 }
+
+class scanCountTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("text", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  QueryData generate(QueryContext& context) override {
+    scans++;
+
+    QueryData results;
+    auto indexes = context.constraints["i"].getAll<int>(EQUALS);
+    for (const auto& i : indexes) {
+      results.push_back({{"i", INTEGER(i)}, {"text", "one"}});
+    }
+    if (indexes.empty()) {
+      for (size_t i = 0; i < 10; i++) {
+        results.push_back({{"i", INTEGER(i)}, {"text", (i < 5) ? "a" : "b"}});
+      }
+    }
+    return results;
+  }
+
+  size_t scans{0};
+};
+
+TEST_F(VirtualTableTests, test_table_scan_cache) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto outer = std::make_shared<scanCountTablePlugin>();
+  table_registry->add("scan_outer", outer);
+  attachTableInternal("scan_outer", outer->columnDefinition(false), dbc, false);
+
+  auto inner = std::make_shared<scanCountTablePlugin>();
+  table_registry->add("scan_inner", inner);
+  attachTableInternal("scan_inner", inner->columnDefinition(false), dbc, false);
+
+  // Without a scan cache the inner table is scanned for each outer row.
+  auto cache_size = FLAGS_table_scan_cache_size;
+  FLAGS_table_scan_cache_size = 0;
+  QueryData results;
+  queryInternal(
+      "SELECT o.i FROM scan_outer o CROSS JOIN scan_inner n", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(100U, results.size());
+  EXPECT_EQ(1U, outer->scans);
+  EXPECT_EQ(10U, inner->scans);
+
+  // Identical scans are reused.
+  FLAGS_table_scan_cache_size = 1024 * 1024;
+  outer->scans = 0;
+  inner->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT o.i FROM scan_outer o CROSS JOIN scan_inner n", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(100U, results.size());
+  EXPECT_EQ(1U, outer->scans);
+  EXPECT_EQ(1U, inner->scans);
+
+  // Scans are only kept for the query.
+  queryInternal("SELECT * FROM scan_inner", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(2U, inner->scans);
+
+  // A constraint on a non-index column reuses a scan without it.
+  inner->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT (SELECT group_concat(text) FROM scan_inner) AS t, (SELECT "
+      "count(*) FROM scan_inner WHERE text = 'a') AS c",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(1U, results.size());
+  EXPECT_EQ("5", results[0]["c"]);
+  EXPECT_EQ(1U, inner->scans);
+
+  // Each distinct non-index constraint is still generated once.
+  inner->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT o.i FROM scan_outer o CROSS JOIN scan_inner n WHERE "
+      "n.text = o.text",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(50U, results.size());
+  EXPECT_EQ(2U, inner->scans);
+
+  // Index constraints select the generated rows, distinct values are scanned.
+  inner->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT o.i FROM scan_outer o CROSS JOIN scan_inner n WHERE n.i = o.i",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(10U, results.size());
+  EXPECT_EQ(10U, inner->scans);
+
+  // Scans larger than the limit are not kept.
+  FLAGS_table_scan_cache_size = 1;
+  inner->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT o.i FROM scan_outer o CROSS JOIN scan_inner n", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(100U, results.size());
+  EXPECT_EQ(10U, inner->scans);
+
+  FLAGS_table_scan_cache_size = cache_size;
+}
+
+TEST_F(VirtualTableTests, test_table_statistics) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto table = std::make_shared<scanCountTablePlugin>();
+  table_registry->add("stats_scan", table);
+  attachTableInternal("stats_scan", table->columnDefinition(false), dbc, false);
+
+  // Without observed scans there is no estimate.
+  auto& stats = TableStatistics::get();
+  EXPECT_FALSE(stats.estimate("stats_scan", {}).known);
+
+  QueryData results;
+  for (size_t i = 0; i < 3; i++) {
+    queryInternal("SELECT * FROM stats_scan", results, dbc);
+    dbc->clearAffectedTables();
+  }
+
+  auto estimate = stats.estimate("stats_scan", {});
+  EXPECT_TRUE(estimate.known);
+  EXPECT_EQ(10, estimate.rows);
+
+  // Observed costs are scaled within the planner's constant scan costs.
+  EXPECT_GE(estimate.planCost(), 1);
+  EXPECT_LT(estimate.planCost(), 201);
+  TableStatistics::Estimate slow;
+  slow.cost = 1e9;
+  EXPECT_GT(slow.planCost(), estimate.planCost());
+  EXPECT_LT(slow.planCost(), 201);
+
+  // An unobserved index column assumes it selects a fraction of the rows.
+  estimate = stats.estimate("stats_scan", {"i"});
+  EXPECT_TRUE(estimate.known);
+  EXPECT_EQ(1, estimate.rows);
+
+  // Index scans are recorded for each constrained index column.
+  for (size_t i = 0; i < 10; i++) {
+    queryInternal("SELECT * FROM stats_scan WHERE i = 1", results, dbc);
+    dbc->clearAffectedTables();
+  }
+
+  estimate = stats.estimate("stats_scan", {"i"});
+  EXPECT_TRUE(estimate.known);
+  EXPECT_EQ(1, estimate.rows);
+
+  // Statistics are persisted and reloaded.
+  stats.persist(true);
+  stats.clear();
+  estimate = stats.estimate("stats_scan", {"i"});
+  EXPECT_TRUE(estimate.known);
+  EXPECT_EQ(1, estimate.rows);
+  EXPECT_EQ(10, stats.estimate("stats_scan", {}).rows);
+}
+
+class changesTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("text", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  QueryData generate(QueryContext& context) override {
+    scans++;
+    return {{{"i", "1"}, {"text", "a"}}, {{"i", "2"}, {"text", "b"}}};
+  }
+
+  bool providesChanges() const override {
+    return true;
+  }
+
+  Status changes(QueryContext& context,
+                 const std::string& cursor,
+                 TableChanges& changes) override {
+    requests++;
+    if (cursor.empty()) {
+      changes.added = generate(context);
+    } else if (cursor == "1") {
+      changes.added = {{{"i", "3"}, {"text", "c"}}};
+      changes.removed = {{{"i", "1"}, {"text", "a"}}};
+    } else {
+      return Status(1, "Unknown cursor");
+    }
+    changes.cursor = std::to_string(requests);
+    return Status(0, "OK");
+  }
+
+  size_t scans{0};
+  size_t requests{0};
+};
+
+TEST_F(VirtualTableTests, test_table_change_feed) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto table = std::make_shared<changesTablePlugin>();
+  table_registry->add("change_feed", table);
+  attachTableInternal(
+      "change_feed", table->columnDefinition(false), dbc, false);
+
+  // An empty cursor yields all rows as added.
+  TableChangeFeed feed("change_feed", "");
+  QueryData results;
+  {
+    TableChangeFeed::Scope scope(&feed);
+    queryInternal("SELECT text FROM change_feed WHERE i > 0", results, dbc);
+    dbc->clearAffectedTables();
+  }
+  EXPECT_TRUE(feed.ok());
+  EXPECT_EQ("1", feed.cursor());
+  EXPECT_EQ(2U, results.size());
+  EXPECT_EQ(1U, table->scans);
+
+  // The changes are requested once, each selection is queried.
+  TableChangeFeed next("change_feed", feed.cursor());
+  {
+    TableChangeFeed::Scope scope(&next);
+    results.clear();
+    queryInternal("SELECT text FROM change_feed WHERE i > 0", results, dbc);
+    dbc->clearAffectedTables();
+    QueryData expected = {{{"text", "c"}}};
+    EXPECT_EQ(expected, results);
+
+    next.select(TableChangeFeed::REMOVED);
+    results.clear();
+    queryInternal("SELECT text FROM change_feed WHERE i > 0", results, dbc);
+    dbc->clearAffectedTables();
+    expected = {{{"text", "a"}}};
+    EXPECT_EQ(expected, results);
+  }
+  EXPECT_TRUE(next.ok());
+  EXPECT_EQ("2", next.cursor());
+  EXPECT_EQ(2U, table->requests);
+  EXPECT_EQ(1U, table->scans);
+
+  // Without a scope the table is scanned.
+  queryInternal("SELECT text FROM change_feed", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(2U, table->scans);
+
+  // Unknown changes fail the query.
+  TableChangeFeed unknown("change_feed", "unknown");
+  {
+    TableChangeFeed::Scope scope(&unknown);
+    auto status = queryInternal("SELECT * FROM change_feed", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_FALSE(status.ok());
+  }
+  EXPECT_FALSE(unknown.ok());
+}
 } // namespace osquery
@@ -8,7 +8,10 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
 #include <unordered_set>
 
 #include <osquery/core.h>
@@ -18,6 +21,10 @@
 #include <osquery/system.h>
 
 #include "osquery/core/process.h"
+#include "osquery/core/query_budget.h"
+#include "osquery/sql/generator_stack.h"
+#include "osquery/sql/table_changes.h"
+#include "osquery/sql/table_statistics.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
@@ -29,6 +36,11 @@ FLAG(uint64,
      0,
      "Add an optional microsecond delay between table scans");
 
+FLAG(uint64,
+     table_scan_cache_size,
+     0,
+     "Bytes of table scan rows reused within a query (default 0, disabled)");
+
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
 DECLARE_bool(disable_events);
@@ -48,6 +60,29 @@ static std::atomic<size_t> kPlannerCursorID{0};
  */
 static std::atomic<size_t> kConstraintIndexID{0};
 
+/// Approximate bytes for each kept scan row column beyond the string content.
+const size_t kScanColumnOverhead = 64;
+
+static inline size_t estimateBytes(const Row& row) {
+  size_t bytes = 0;
+  for (const auto& column : row) {
+    bytes += column.first.size() + column.second.size() + kScanColumnOverhead;
+  }
+  return bytes;
+}
+
+/// Columns whose constraints select the rows a table generates.
+const ColumnOptions kIndexColumnOptions =
+    ColumnOptions::REQUIRED | ColumnOptions::INDEX | ColumnOptions::ADDITIONAL;
+
+using Clock = std::chrono::steady_clock;
+
+static inline size_t elapsedMicros(const Clock::time_point& start) {
+  auto elapsed = Clock::now() - start;
+  return static_cast<size_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
 static inline std::string opString(unsigned char op) {
   switch (op) {
   case EQUALS:
@@ -295,9 +330,18 @@ int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
   return SQLITE_OK;
 }
 
+static void releaseBudget(BaseCursor* pCur) {
+  auto tracker = QueryBudgetTracker::current();
+  if (tracker != nullptr) {
+    tracker->releaseMemory(pCur->budget_bytes);
+  }
+  pCur->budget_bytes = 0;
+}
+
 int xClose(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   plan("Closing cursor (" + std::to_string(pCur->id) + ")");
+  releaseBudget(pCur);
   delete pCur;
   return SQLITE_OK;
 }
@@ -309,6 +353,26 @@ int xEof(sqlite3_vtab_cursor* cur) {
       return false;
     }
     pCur->generator = nullptr;
+    if (pCur->record_stats) {
+      // The generator completed, each yielded row advanced the cursor.
+      auto* pVtab = (VirtualTable*)cur->pVtab;
+      TableStatistics::get().record(pVtab->content->name,
+                                    pCur->stats_columns,
+                                    pCur->row,
+                                    pCur->micros);
+      pCur->record_stats = false;
+    }
+    if (pCur->keep_scan) {
+      // The generator completed, keep the yielded rows for later scans.
+      auto* pVtab = (VirtualTable*)cur->pVtab;
+      pCur->scan.rows =
+          std::make_shared<const QueryData>(std::move(pCur->yielded));
+      pVtab->instance->addScan(pVtab->content->name,
+                               std::move(pCur->scan),
+                               FLAGS_table_scan_cache_size);
+      pCur->yielded.clear();
+      pCur->keep_scan = false;
+    }
     return true;
   }
 
@@ -327,12 +391,31 @@ int xDestroy(sqlite3_vtab* p) {
   return SQLITE_OK;
 }
 
+static void keepYielded(BaseCursor* pCur) {
+  if (!pCur->keep_scan) {
+    return;
+  }
+
+  pCur->scan.bytes += estimateBytes(pCur->current);
+  if (pCur->scan.bytes > FLAGS_table_scan_cache_size) {
+    // The scan is too large to keep, stop copying rows.
+    pCur->keep_scan = false;
+    pCur->yielded.clear();
+    return;
+  }
+  pCur->yielded.push_back(pCur->current);
+}
+
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   if (pCur->uses_generator) {
+    auto start = Clock::now();
     pCur->generator->operator()();
+    pCur->micros += elapsedMicros(start);
     if (*pCur->generator) {
-      pCur->current = pCur->generator->get();
+      // The generator does not use a row after yielding it.
+      pCur->current = std::move(pCur->generator->get());
+      keepYielded(pCur);
     }
   }
   pCur->row++;
@@ -343,8 +426,12 @@ int xRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
   *pRowid = 0;
 
   const BaseCursor* pCur = (BaseCursor*)cur;
-  auto data_it = std::next(pCur->data.begin(), pCur->row);
-  if (data_it >= pCur->data.end()) {
+  if (pCur->data == nullptr) {
+    return SQLITE_ERROR;
+  }
+
+  auto data_it = std::next(pCur->data->begin(), pCur->row);
+  if (data_it >= pCur->data->end()) {
     return SQLITE_ERROR;
   }
 
@@ -683,7 +770,8 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
     // Requested column index greater than column set size.
     return SQLITE_ERROR;
   }
-  if (!pCur->uses_generator && pCur->row >= pCur->data.size()) {
+  if (!pCur->uses_generator &&
+      (pCur->data == nullptr || pCur->row >= pCur->data->size())) {
     // Request row index greater than row set size.
     return SQLITE_ERROR;
   }
@@ -698,20 +786,24 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
         pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
   }
 
-  Row* row = nullptr;
+  const Row* row = nullptr;
   if (pCur->uses_generator) {
     row = &pCur->current;
   } else {
-    row = &pCur->data[pCur->row];
+    row = &(*pCur->data)[pCur->row];
   }
 
   // Attempt to cast each xFilter-populated row/column to the SQLite type.
-  const auto& value = (*row)[column_name];
-  if (row->count(column_name) == 0) {
+  auto column = row->find(column_name);
+  if (column == row->end()) {
     // Missing content.
     VLOG(1) << "Error " << column_name << " is empty";
     sqlite3_result_null(ctx);
-  } else if (type == TEXT_TYPE || type == BLOB_TYPE) {
+    return SQLITE_OK;
+  }
+
+  const auto& value = column->second;
+  if (type == TEXT_TYPE || type == BLOB_TYPE) {
     sqlite3_result_text(
         ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
   } else if (type == INTEGER_TYPE) {
@@ -774,6 +866,10 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   bool required_satisfied = false;
   bool index_used = false;
 
+  // Index columns with equality constraints, used to estimate the scan.
+  std::set<std::string> index_columns;
+  bool index_ranged = false;
+
   // Expressions operating on the same virtual table are loosely identified by
   // the consecutive sets of terms each of the constraint sets are applied onto.
   // Subsequent attempts from failed (unusable) constraints replace the set,
@@ -818,6 +914,14 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
         index_used = true;
       }
 
+      if (options & kIndexColumnOptions) {
+        if (constraint_info.op == EQUALS) {
+          index_columns.insert(name);
+        } else {
+          index_ranged = true;
+        }
+      }
+
       // Save a pair of the name and the constraint operator.
       // Use this constraint during xFilter by performing a scan and column
       // name lookup through out all cursor constraint lists.
@@ -842,7 +946,24 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
     }
   }
 
-  if (!index_used) {
+  // Estimate the scan using observed table statistics, if available.
+  TableStatistics::Estimate estimate;
+  if (!index_ranged) {
+    estimate = TableStatistics::get().estimate(pVtab->content->name,
+                                               index_columns);
+  }
+
+  if (estimate.known) {
+    // The observed cost replaces the constant scan cost. Observed rows are
+    // only an estimate, the scan is never declared unique to SQLite.
+    cost += estimate.planCost() - 1;
+    pIdxInfo->estimatedRows =
+        static_cast<sqlite3_int64>(std::ceil(std::max(estimate.rows, 1.0)));
+    plan("Estimated scan of table: " + pVtab->content->name +
+         " [rows=" + std::to_string(pIdxInfo->estimatedRows) +
+         " micros=" + std::to_string(static_cast<size_t>(estimate.cost)) +
+         " cost=" + std::to_string(estimate.planCost()) + "]");
+  } else if (!index_used) {
     // A column is marked index, but no index constraint was provided.
     cost += 200;
   }
@@ -895,8 +1016,14 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   pCur->row = 0;
   pCur->n = 0;
+  pCur->scan = TableScan();
+  pCur->stats_columns.clear();
+  pCur->micros = 0;
   QueryContext context(content);
 
+  // Scans with index constraints other than equality are not recorded.
+  bool record_stats = true;
+
   // The SQLite instance communicates to the TablePlugin via the context.
   context.useCache(pVtab->instance->useCache());
 
@@ -957,7 +1084,31 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
              "): " + constraint.first + " " + opString(constraint.second.op) +
              " " + constraint.second.expr);
         // Add the constraint to the column-sorted query request map.
-        context.constraints[constraint.first].add(constraint.second);
+        auto& list = context.constraints[constraint.first];
+        if (sqlite3_value_type(argv[i]) == SQLITE_INTEGER) {
+          // Keep the integer value to avoid parsing the expression.
+          list.add(constraint.second, sqlite3_value_int64(argv[i]));
+        } else {
+          list.add(constraint.second);
+        }
+
+        // Constraints on indexes select the generated rows, others may not.
+        TableScan::Term term;
+        term.column = constraint.first;
+        term.op = constraint.second.op;
+        term.expr = constraint.second.expr;
+        term.index = (options[constraint.first] & kIndexColumnOptions) ||
+                     ((content->attributes & TableAttributes::USER_BASED) &&
+                      (term.column == "uid" || term.column == "username"));
+        pCur->scan.terms.push_back(std::move(term));
+
+        if (options[constraint.first] & kIndexColumnOptions) {
+          if (constraint.second.op == EQUALS) {
+            pCur->stats_columns.insert(constraint.first);
+          } else {
+            record_stats = false;
+          }
+        }
       }
     } else if (constraints.size() > 0) {
       // Constraints failed.
@@ -1004,35 +1155,118 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   }
 
   // Reset the virtual table contents.
-  pCur->data.clear();
+  pCur->data = nullptr;
+  releaseBudget(pCur);
+  pCur->generator = nullptr;
+  pCur->uses_generator = false;
+  pCur->keep_scan = false;
+  pCur->yielded.clear();
+  pCur->record_stats = false;
   options.clear();
 
+  auto feed = TableChangeFeed::current();
+  if (feed != nullptr && feed->table() == content->name) {
+    // Yield the rows the table changed instead of scanning it.
+    plan("Scanning changes for cursor (" + std::to_string(pCur->id) +
+         "): " + content->name);
+    QueryData results;
+    if (!feed->scan(context, results).ok()) {
+      return SQLITE_ERROR;
+    }
+    pCur->data = std::make_shared<const QueryData>(std::move(results));
+    pCur->n = pCur->data->size();
+    return SQLITE_OK;
+  }
+
+  if (FLAGS_table_scan_cache_size > 0) {
+    // Reuse the rows of an equivalent scan earlier in the query.
+    auto& terms = pCur->scan.terms;
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(),
+                            terms.end(),
+                            [](const TableScan::Term& a,
+                               const TableScan::Term& b) {
+                              return !(a < b) && !(b < a);
+                            }),
+                terms.end());
+    pCur->scan.columns = context.colsUsed;
+
+    auto rows = pVtab->instance->findScan(content->name, pCur->scan);
+    if (rows != nullptr) {
+      plan("Scan cache hit for cursor (" + std::to_string(pCur->id) +
+           "): " + content->name);
+      pCur->data = std::move(rows);
+      pCur->n = pCur->data->size();
+      return SQLITE_OK;
+    }
+    plan("Scan cache miss for cursor (" + std::to_string(pCur->id) +
+         "): " + content->name);
+    pCur->keep_scan = true;
+  }
+
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
+  QueryData results;
+  auto start = Clock::now();
   if (Registry::get().exists("table", pVtab->content->name, true)) {
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
     if (table->usesGenerator()) {
       pCur->uses_generator = true;
       pCur->generator = std::make_unique<RowGenerator::pull_type>(
+          PooledStackAllocator(),
           std::bind(&TablePlugin::generator,
                     table,
                     std::placeholders::_1,
                     std::move(context)));
       if (*pCur->generator) {
-        pCur->current = pCur->generator->get();
+        pCur->current = std::move(pCur->generator->get());
+        keepYielded(pCur);
       }
+      pCur->micros = elapsedMicros(start);
+      pCur->record_stats = record_stats;
       return SQLITE_OK;
     }
-    pCur->data = table->generate(context);
+    results = table->generate(context);
   } else {
     PluginRequest request = {{"action", "generate"}};
     TablePlugin::setRequestFromContext(context, request);
-    Registry::call("table", pVtab->content->name, request, pCur->data);
+    Registry::call("table", pVtab->content->name, request, results);
+  }
+
+  auto tracker = QueryBudgetTracker::current();
+  if (tracker != nullptr) {
+    // The generated rows are held until the cursor scans again or closes.
+    for (const auto& row : results) {
+      pCur->budget_bytes += estimateBytes(row);
+    }
+    tracker->addMemory(pCur->budget_bytes);
+
+    if (tracker->exceeded()) {
+      // Stop the query before SQLite visits the rows.
+      return SQLITE_ERROR;
+    }
+  }
+
+  if (record_stats) {
+    TableStatistics::get().record(content->name,
+                                  pCur->stats_columns,
+                                  results.size(),
+                                  elapsedMicros(start));
   }
 
   // Set the number of rows.
-  pCur->n = pCur->data.size();
+  pCur->data = std::make_shared<const QueryData>(std::move(results));
+  pCur->n = pCur->data->size();
+  if (pCur->keep_scan) {
+    for (const auto& row : *pCur->data) {
+      pCur->scan.bytes += estimateBytes(row);
+    }
+    pCur->scan.rows = pCur->data;
+    pVtab->instance->addScan(
+        content->name, std::move(pCur->scan), FLAGS_table_scan_cache_size);
+    pCur->keep_scan = false;
+  }
   return SQLITE_OK;
 }
 
@@ -1143,6 +1377,10 @@ Status attachFunctionInternal(
   return Status(rc);
 }
 
+size_t nextConstraintIndex() {
+  return tables::sqlite::kConstraintIndexID;
+}
+
 void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
   if (FLAGS_enable_foreign) {
 #if !defined(OSQUERY_EXTERNAL)
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <set>
+#include <string>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/tables.h>
@@ -42,8 +45,8 @@ struct BaseCursor : private boost::noncopyable {
   /// Track cursors for optional planner output.
   size_t id{0};
 
-  /// Table data generated from last access.
-  QueryData data;
+  /// Table data generated from last access, may be shared with later scans.
+  std::shared_ptr<const QueryData> data;
 
   /// Callable generator.
   std::unique_ptr<RowGenerator::pull_type> generator{nullptr};
@@ -59,6 +62,27 @@ struct BaseCursor : private boost::noncopyable {
 
   /// Total number of rows.
   size_t n{0};
+
+  /// The constraints and columns of the current scan.
+  TableScan scan;
+
+  /// Generated rows are kept for reuse by later scans.
+  bool keep_scan{false};
+
+  /// Rows from a generator, kept once the generator completes.
+  QueryData yielded;
+
+  /// The scan is recorded in the table statistics when it completes.
+  bool record_stats{false};
+
+  /// Index columns with equality constraints used by the scan.
+  std::set<std::string> stats_columns;
+
+  /// Microseconds spent generating rows for the scan.
+  size_t micros{0};
+
+  /// Bytes of data charged to the query budget, released with the data.
+  size_t budget_bytes{0};
 };
 
 /**
@@ -96,6 +120,9 @@ Status attachFunctionInternal(
 /// Attach all table plugins to an in-memory SQLite database.
 void attachVirtualTables(const SQLiteDBInstanceRef& instance);
 
+/// The index xBestIndex will assign to the next virtual table plan.
+size_t nextConstraintIndex();
+
 #if !defined(OSQUERY_EXTERNAL)
 /**
  * A generated foreign amalgamation file includes schema for all tables.
@@ -15,6 +15,7 @@
 #include <osquery/sql.h>
 
 #include "osquery/tables/events/linux/process_events.h"
+#include "osquery/tables/system/linux/process_cache.h"
 
 namespace osquery {
 
@@ -48,6 +49,13 @@ Status AuditProcessEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
     return status;
   }
 
+  if (FLAGS_process_cache) {
+    // The processes table must read the new binary and arguments.
+    for (const auto& row : emitted_row_list) {
+      tables::ProcessCache::get().invalidate(row.at("pid"));
+    }
+  }
+
   addBatch(emitted_row_list);
   return Status(0, "Ok");
 }
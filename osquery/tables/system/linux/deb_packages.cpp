@@ -18,6 +18,8 @@ extern "C" {
 #include <dpkg/parsedump.h>
 }
 
+#include <sys/stat.h>
+
 #include <boost/algorithm/string.hpp>
 
 #include <osquery/filesystem.h>
@@ -30,6 +32,11 @@ namespace tables {
 
 static const std::string kDPKGPath{"/var/lib/dpkg"};
 
+/// Files dpkg replaces or appends to when the installed packages change.
+static const std::vector<std::string> kDPKGStatePaths = {
+    "/var/lib/dpkg/status", "/var/lib/dpkg/updates",
+};
+
 /// A comparator used to sort the packages array.
 int pkg_sorter(const void *a, const void *b) {
   const struct pkginfo *pa = *(const struct pkginfo **)a;
@@ -183,5 +190,44 @@ QueryData genDebPackages(QueryContext &context) {
   dpkg_teardown(&packages);
   return results;
 }
+
+/**
+ * @brief Describe the state of the DPKG database.
+ *
+ * dpkg journals package operations in the updates directory and replaces the
+ * status file when folding them in, either changes the state.
+ */
+std::string getDebPackageState() {
+  std::string state;
+  for (const auto &path : kDPKGStatePaths) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      return "";
+    }
+    state += std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) +
+             ":" + std::to_string(st.st_mtim.tv_sec) + "." +
+             std::to_string(st.st_mtim.tv_nsec) + ";";
+  }
+  return state;
+}
+
+Status genDebPackageChanges(QueryContext &context,
+                            const std::string &cursor,
+                            TableChanges &changes) {
+  auto state = getDebPackageState();
+  if (state.empty()) {
+    return Status(1, "Cannot find DPKG database: " + kDPKGPath);
+  }
+
+  if (cursor.empty()) {
+    // The state is read first, a change while generating is seen again.
+    changes.added = genDebPackages(context);
+  } else if (cursor != state) {
+    // The previous packages are not kept, a full scan finds the changes.
+    return Status(1, "DPKG database changed");
+  }
+  changes.cursor = std::move(state);
+  return Status(0, "OK");
+}
 }
 }
@@ -0,0 +1,87 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include "osquery/tables/system/linux/process_cache.h"
+
+namespace osquery {
+
+FLAG(bool,
+     process_cache,
+     false,
+     "Keep process arguments in memory between processes scans");
+
+FLAG(uint64,
+     process_cache_ttl,
+     60,
+     "Seconds before cached process arguments are read again");
+
+namespace tables {
+
+bool ProcessCache::find(const std::string& pid,
+                        const std::string& start,
+                        const std::string& exe,
+                        Row& r) const {
+  ReadLock lock(mutex_);
+  auto entry = entries_.find(pid);
+  if (entry == entries_.end() || entry->second.start != start ||
+      entry->second.exe != exe) {
+    return false;
+  }
+
+  auto age = std::chrono::steady_clock::now() - entry->second.updated;
+  if (age >= std::chrono::seconds(FLAGS_process_cache_ttl)) {
+    return false;
+  }
+
+  for (const auto& column : entry->second.columns) {
+    r[column.first] = column.second;
+  }
+  return true;
+}
+
+void ProcessCache::update(const std::string& pid,
+                          const std::string& start,
+                          const std::string& exe,
+                          Row columns) {
+  WriteLock lock(mutex_);
+  auto& entry = entries_[pid];
+  entry.start = start;
+  entry.exe = exe;
+  entry.updated = std::chrono::steady_clock::now();
+  entry.columns = std::move(columns);
+}
+
+void ProcessCache::invalidate(const std::string& pid) {
+  WriteLock lock(mutex_);
+  entries_.erase(pid);
+}
+
+void ProcessCache::reconcile(const std::set<std::string>& pids) {
+  WriteLock lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (pids.count(it->first) == 0) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t ProcessCache::size() const {
+  ReadLock lock(mutex_);
+  return entries_.size();
+}
+
+void ProcessCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+}
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,98 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/flags.h>
+#include <osquery/mutex.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+
+DECLARE_bool(process_cache);
+
+namespace tables {
+
+/**
+ * @brief Process arguments kept between scans of the processes table.
+ *
+ * Reading the arguments of every process is a large part of the cost of
+ * scanning the processes table. When enabled with --process_cache the
+ * cmdline column is kept between scans.
+ *
+ * Entries are keyed by pid, the process start time from /proc/<pid>/stat,
+ * and the /proc/<pid>/exe link, which is read on every scan. A reused pid, an
+ * exec, or a replaced or deleted binary therefore reads the arguments again.
+ * A process may also rewrite its arguments, so entries are dropped when they
+ * are older than --process_cache_ttl seconds. Entries are also dropped when
+ * the audit process_events subscriber sees an exec and when a full scan no
+ * longer finds the pid.
+ */
+class ProcessCache : private boost::noncopyable {
+ public:
+  static ProcessCache& get() {
+    static ProcessCache instance;
+    return instance;
+  }
+
+  /// Copy the cached columns of a process into a row.
+  bool find(const std::string& pid,
+            const std::string& start,
+            const std::string& exe,
+            Row& r) const;
+
+  /// Keep the columns of a process.
+  void update(const std::string& pid,
+              const std::string& start,
+              const std::string& exe,
+              Row columns);
+
+  /// Drop a process that executed a new binary.
+  void invalidate(const std::string& pid);
+
+  /// Drop processes that were not found by a scan of all processes.
+  void reconcile(const std::set<std::string>& pids);
+
+  /// The number of cached processes.
+  size_t size() const;
+
+  /// Drop all processes.
+  void clear();
+
+ private:
+  ProcessCache() = default;
+
+ private:
+  struct Entry {
+    /// The process start time, in clock ticks since boot.
+    std::string start;
+
+    /// The target of the exe link when the columns were read.
+    std::string exe;
+
+    /// When the columns were read.
+    std::chrono::steady_clock::time_point updated;
+
+    Row columns;
+  };
+
+  std::unordered_map<std::string, Entry> entries_;
+
+  mutable Mutex mutex_;
+};
+} // namespace tables
+} // namespace osquery
@@ -8,6 +8,7 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <map>
 #include <string>
 
@@ -17,7 +18,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/noncopyable.hpp>
+#include <boost/utility/string_view.hpp>
 #include <boost/regex.hpp>
 
 #include <osquery/core.h>
@@ -26,8 +27,10 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/core/query_budget.h"
 #include "osquery/core/utils.h"
 #include "osquery/filesystem/linux/proc.h"
+#include "osquery/tables/system/linux/process_cache.h"
 
 namespace osquery {
 namespace tables {
@@ -39,53 +42,6 @@ inline std::string getProcAttr(const std::string& attr,
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
-
-  std::string content;
-  readFile(attr, content);
-  // Remove \0 delimiters.
-  std::replace_if(content.begin(),
-                  content.end(),
-                  [](const char& c) { return c == 0; },
-                  ' ');
-  // Remove trailing delimiter.
-  boost::algorithm::trim(content);
-  return content;
-}
-
-inline std::string readProcLink(const std::string& attr,
-                                const std::string& pid) {
-  // The exe is a symlink to the binary on-disk.
-  auto attr_path = getProcAttr(attr, pid);
-
-  std::string result = "";
-  struct stat sb;
-  if (lstat(attr_path.c_str(), &sb) != -1) {
-    // Some symlinks may report 'st_size' as zero
-    // Use PATH_MAX as best guess
-    // For cases when 'st_size' is not zero but smaller than
-    // PATH_MAX we will still use PATH_MAX to minimize chance
-    // of output trucation during race condition
-    ssize_t buf_size = sb.st_size < PATH_MAX ? PATH_MAX : sb.st_size;
-    // +1 for \0, since readlink does not append a null
-    char* linkname = static_cast<char*>(malloc(buf_size + 1));
-    ssize_t r = readlink(attr_path.c_str(), linkname, buf_size);
-
-    if (r > 0) { // Success check
-      // r may not be equal to buf_size
-      // if r == buf_size there was race condition
-      // and link is longer than buf_size and because of this
-      // truncated
-      linkname[r] = '\0';
-      result = std::string(linkname);
-    }
-    free(linkname);
-  }
-
-  return result;
-}
-
 // In the case where the linked binary path ends in " (deleted)", and a file
 // actually exists at that path, check whether the inode of that file matches
 // the inode of the mapped file in /proc/%pid/maps
@@ -199,144 +155,140 @@ void genProcessMap(const std::string& pid, QueryData& results) {
   }
 }
 
-/**
- *  Output from string parsing /proc/<pid>/status.
- */
-struct SimpleProcStat : private boost::noncopyable {
- public:
-  std::string name;
-  std::string real_uid;
-  std::string real_gid;
-  std::string effective_uid;
-  std::string effective_gid;
-  std::string saved_uid;
-  std::string saved_gid;
-  std::string resident_size;
-  std::string total_size;
-  std::string state;
-  std::string parent;
-  std::string group;
-  std::string nice;
-  std::string threads;
-  std::string user_time;
-  std::string system_time;
-  std::string start_time;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcStat(const std::string& pid);
+/// The /proc/<pid> files read for the columns used by a query.
+struct ProcessColumns {
+  bool stat;
+  bool status;
+  bool io;
+  bool exe;
+  bool cmdline;
+  bool cwd;
+  bool root;
+
+  explicit ProcessColumns(const QueryContext& context)
+      : stat(context.isAnyColumnUsed({"parent",
+                                      "pgroup",
+                                      "state",
+                                      "nice",
+                                      "threads",
+                                      "user_time",
+                                      "system_time",
+                                      "start_time"})),
+        status(context.isAnyColumnUsed({"name",
+                                        "uid",
+                                        "euid",
+                                        "suid",
+                                        "gid",
+                                        "egid",
+                                        "sgid",
+                                        "resident_size",
+                                        "total_size"})),
+        io(context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})),
+        exe(context.isAnyColumnUsed({"path", "on_disk"})),
+        cmdline(context.isColumnUsed("cmdline")),
+        cwd(context.isColumnUsed("cwd")),
+        root(context.isColumnUsed("root")) {}
+
+  /// Check if columns from the process binary and arguments are used.
+  bool image() const {
+    return exe || cmdline || root;
+  }
 };
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
-  std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
-    auto start = content.find_last_of(")");
-    // Start parsing stats from ") <MODE>..."
-    if (start == std::string::npos || content.size() <= start + 2) {
-      status = Status(1, "Invalid /proc/stat header");
-      return;
-    }
+inline std::string toString(boost::string_view value) {
+  return std::string(value.data(), value.size());
+}
 
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
-      status = Status(1, "Invalid /proc/stat content");
-      return;
-    }
+/// Set the columns read from /proc/<pid>/stat, and the start time in ticks.
+Status genProcessStat(ProcProcessReader& proc, Row& r, std::string& start) {
+  boost::string_view content;
+  if (!proc.read("stat", content).ok()) {
+    // Without a stat file the columns are left empty.
+    return Status(0);
+  }
 
-    this->state = details.at(0);
-    this->parent = details.at(1);
-    this->group = details.at(2);
-    this->user_time = details.at(11);
-    this->system_time = details.at(12);
-    this->nice = details.at(16);
-    this->threads = details.at(17);
-    auto st = tryTo<long>(details.at(19));
-    this->start_time = INTEGER((st) ? st.take() / 100 : -1);
+  ProcStat stat;
+  auto status = procParseStat(content, stat);
+  if (!status.ok()) {
+    return status;
   }
 
+  r["parent"] = toString(stat.parent);
+  r["pgroup"] = toString(stat.group);
+  r["state"] = toString(stat.state);
+  r["nice"] = toString(stat.nice);
+  r["threads"] = toString(stat.threads);
+
+  // Times are reported in clock ticks.
+  auto usr_time = std::strtoull(toString(stat.user_time).c_str(), nullptr, 10);
+  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
+  auto sys_time =
+      std::strtoull(toString(stat.system_time).c_str(), nullptr, 10);
+  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
+  start = toString(stat.start_time);
+  auto start_time = tryTo<long>(start);
+  r["start_time"] = INTEGER((start_time) ? start_time.take() / 100 : -1);
+  return Status(0);
+}
+
+/// Set the columns read from /proc/<pid>/status.
+Status genProcessStatus(ProcProcessReader& proc, Row& r) {
   // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
-    status = Status(1, "Cannot read /proc/status");
-    return;
+  boost::string_view content;
+  if (!proc.read("status", content).ok()) {
+    return Status(1, "Cannot read /proc/status");
   }
 
-  for (const auto& line : osquery::split(content, "\n")) {
-    // Status lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
-      continue;
-    }
-
-    // There are specific fields from each detail.
-    if (detail.at(0) == "Name") {
-      this->name = detail.at(1);
-    } else if (detail.at(0) == "VmRSS") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB.
-      this->resident_size = detail.at(1) + "000";
-    } else if (detail.at(0) == "VmSize") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
+  procParseFields(content, [&r](boost::string_view key,
+                                boost::string_view value) {
+    if (key == "Name") {
+      r["name"] = toString(value);
+    } else if (key == "VmRSS") {
       // Memory is reported in kB.
-      this->total_size = detail.at(1) + "000";
-    } else if (detail.at(0) == "Gid") {
-      // Format is: R E - -
-      auto gid_detail = osquery::split(detail.at(1), "\t");
-      if (gid_detail.size() == 4) {
-        this->real_gid = gid_detail.at(0);
-        this->effective_gid = gid_detail.at(1);
-        this->saved_gid = gid_detail.at(2);
+      r["resident_size"] = toString(procNextToken(value)) + "000";
+    } else if (key == "VmSize") {
+      r["total_size"] = toString(procNextToken(value)) + "000";
+    } else if (key == "Uid" || key == "Gid") {
+      // Format is: R E S F
+      boost::string_view ids[4];
+      for (auto& id : ids) {
+        id = procNextToken(value);
       }
-    } else if (detail.at(0) == "Uid") {
-      auto uid_detail = osquery::split(detail.at(1), "\t");
-      if (uid_detail.size() == 4) {
-        this->real_uid = uid_detail.at(0);
-        this->effective_uid = uid_detail.at(1);
-        this->saved_uid = uid_detail.at(2);
+      if (!ids[3].empty() && procNextToken(value).empty()) {
+        auto uid = (key == "Uid");
+        r[uid ? "uid" : "gid"] = toString(ids[0]);
+        r[uid ? "euid" : "egid"] = toString(ids[1]);
+        r[uid ? "suid" : "sgid"] = toString(ids[2]);
       }
     }
-  }
+  });
+  return Status(0);
 }
 
-/**
- * Output from string parsing /proc/<pid>/io.
- */
-struct SimpleProcIo : private boost::noncopyable {
- public:
-  std::string read_bytes;
-  std::string write_bytes;
-  std::string cancelled_write_bytes;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcIo(const std::string& pid);
-};
-
-SimpleProcIo::SimpleProcIo(const std::string& pid) {
-  std::string content;
-  if (!readFile(getProcAttr("io", pid), content).ok()) {
-    status = Status(
-        1, "Cannot read /proc/" + pid + "/io (is osquery running as root?)");
-    return;
+/// Set the columns read from /proc/<pid>/io.
+Status genProcessIo(ProcProcessReader& proc, Row& r) {
+  boost::string_view content;
+  if (!proc.read("io", content).ok()) {
+    return Status(1, "Cannot read /proc/io (is osquery running as root?)");
   }
 
-  for (const auto& line : osquery::split(content, "\n")) {
-    // IO lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
-      continue;
-    }
-
+  long long write_bytes = 0;
+  long long cancelled_write_bytes = 0;
+  procParseFields(content, [&](boost::string_view key,
+                               boost::string_view value) {
     // There are specific fields from each detail
-    if (detail.at(0) == "read_bytes") {
-      this->read_bytes = detail.at(1);
-    } else if (detail.at(0) == "write_bytes") {
-      this->write_bytes = detail.at(1);
-    } else if (detail.at(0) == "cancelled_write_bytes") {
-      this->cancelled_write_bytes = detail.at(1);
+    if (key == "read_bytes") {
+      r["disk_bytes_read"] = toString(value);
+    } else if (key == "write_bytes") {
+      write_bytes = tryTo<long long>(toString(value)).takeOr(0ll);
+    } else if (key == "cancelled_write_bytes") {
+      cancelled_write_bytes = tryTo<long long>(toString(value)).takeOr(0ll);
     }
-  }
+  });
+
+  r["disk_bytes_written"] =
+      std::to_string(write_bytes - cancelled_write_bytes);
+  return Status(0);
 }
 
 /**
@@ -391,65 +343,126 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
-void genProcess(const std::string& pid, QueryData& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
+/// Set the path and on_disk columns from the process exe link.
+void genProcessPath(const std::string& pid, std::string path, Row& r) {
+  r["on_disk"] = INTEGER(getOnDisk(pid, path));
+  r["path"] = std::move(path);
+}
+
+/// Set the cmdline column from the process arguments.
+void genProcessCmdline(ProcProcessReader& proc, Row& r) {
+  // Read/parse cmdline arguments.
+  boost::string_view content;
+  proc.read("cmdline", content);
+  auto& cmdline = r["cmdline"];
+  cmdline = toString(content);
+  // Remove \0 delimiters.
+  std::replace(cmdline.begin(), cmdline.end(), '\0', ' ');
+  // Remove trailing delimiter.
+  boost::algorithm::trim(cmdline);
+}
+
+/// Set the columns read from the process binary, arguments, and root.
+void genProcessImage(const std::string& pid,
+                     const ProcessColumns& columns,
+                     ProcProcessReader& proc,
+                     Row& r) {
+  if (columns.exe) {
+    std::string path;
+    proc.readLink("exe", path);
+    genProcessPath(pid, std::move(path), r);
+  }
+
+  if (columns.cmdline) {
+    genProcessCmdline(proc, r);
+  }
+
+  if (columns.root) {
+    proc.readLink("root", r["root"]);
+  }
+}
 
-  if (!proc_stat.status.ok()) {
-    VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
+void genProcess(const std::string& pid,
+                const ProcessColumns& columns,
+                ProcProcessReader& proc,
+                QueryData& results) {
+  if (!proc.open(pid).ok()) {
+    // The process exited.
     return;
   }
 
+  // Only the files needed for the used columns are read.
   Row r;
   r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
-  // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
-
-  // size/memory information
-  r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
-
-  // time information
-  auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
-  r["user_time"] = std::to_string(usr_time * kMSIn1CLKTCK);
-  auto sys_time = std::strtoull(proc_stat.system_time.data(), nullptr, 10);
-  r["system_time"] = std::to_string(sys_time * kMSIn1CLKTCK);
-  r["start_time"] = proc_stat.start_time;
-
-  if (!proc_io.status.ok()) {
-    // /proc/<pid>/io can require root to access, so don't fail if we can't
-    VLOG(1) << proc_io.status.getMessage();
+  // A process without a readable status is skipped whichever columns are
+  // used, the status is only parsed if its columns are used.
+  if (columns.status) {
+    auto status = genProcessStatus(proc, r);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
   } else {
-    r["disk_bytes_read"] = proc_io.read_bytes;
-    long long write_bytes = tryTo<long long>(proc_io.write_bytes).takeOr(0ll);
-    long long cancelled_write_bytes =
-        tryTo<long long>(proc_io.cancelled_write_bytes).takeOr(0ll);
+    boost::string_view content;
+    if (!proc.read("status", content).ok()) {
+      VLOG(1) << "Cannot read /proc/status for pid " << pid;
+      return;
+    }
+  }
 
-    r["disk_bytes_written"] =
-        std::to_string(write_bytes - cancelled_write_bytes);
+  // The start time identifies the process in the process cache.
+  auto cached = FLAGS_process_cache && columns.cmdline;
+  std::string start;
+  if (columns.stat || cached) {
+    auto status = genProcessStat(proc, r, start);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
   }
 
-  results.push_back(r);
+  if (cached && !start.empty()) {
+    // The exe link is read on every scan, it changes when the process
+    // executes and when its binary is replaced or deleted. Cached arguments
+    // are only used while the link is unchanged.
+    std::string exe;
+    proc.readLink("exe", exe);
+    auto& cache = ProcessCache::get();
+    if (!cache.find(pid, start, exe, r)) {
+      Row arguments;
+      genProcessCmdline(proc, arguments);
+      r["cmdline"] = arguments["cmdline"];
+      cache.update(pid, start, exe, std::move(arguments));
+    }
+
+    if (columns.exe) {
+      genProcessPath(pid, std::move(exe), r);
+    }
+
+    // The root changes without an exec, after a chroot.
+    if (columns.root) {
+      proc.readLink("root", r["root"]);
+    }
+  } else if (columns.image()) {
+    genProcessImage(pid, columns, proc, r);
+  }
+
+  if (columns.cwd) {
+    proc.readLink("cwd", r["cwd"]);
+  }
+
+  // No support for unpagable counters in linux.
+  r["wired_size"] = "0";
+
+  if (columns.io) {
+    auto status = genProcessIo(proc, r);
+    if (!status.ok()) {
+      // /proc/<pid>/io can require root to access, so don't fail if we can't
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+    }
+  }
+
+  results.push_back(std::move(r));
 }
 
 void genNamespaces(const std::string& pid, QueryData& results) {
@@ -474,8 +487,19 @@ QueryData genProcesses(QueryContext& context) {
   QueryData results;
 
   auto pidlist = getProcList(context);
+  ProcessColumns columns(context);
+  ProcProcessReader proc;
   for (const auto& pid : pidlist) {
-    genProcess(pid, results);
+    if (queryBudgetExceeded()) {
+      // The query is stopping, skip the remaining processes.
+      break;
+    }
+    genProcess(pid, columns, proc, results);
+  }
+
+  if (FLAGS_process_cache && !context.hasConstraint("pid", EQUALS)) {
+    // The scan found every process, forget those that exited.
+    ProcessCache::get().reconcile(pidlist);
   }
 
   return results;
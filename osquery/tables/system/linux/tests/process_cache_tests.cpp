@@ -0,0 +1,90 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/flags.h>
+
+#include "osquery/tables/system/linux/process_cache.h"
+
+namespace osquery {
+
+DECLARE_uint64(process_cache_ttl);
+
+namespace tables {
+
+class ProcessCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    ProcessCache::get().clear();
+  }
+
+  void TearDown() override {
+    ProcessCache::get().clear();
+    FLAGS_process_cache_ttl = ttl_;
+  }
+
+ private:
+  uint64_t ttl_{FLAGS_process_cache_ttl};
+};
+
+TEST_F(ProcessCacheTests, test_find) {
+  auto& cache = ProcessCache::get();
+  cache.update("10", "500", "/bin/sh", {{"cmdline", "sh -c"}});
+
+  Row r = {{"pid", "10"}};
+  ASSERT_TRUE(cache.find("10", "500", "/bin/sh", r));
+  EXPECT_EQ(r["pid"], "10");
+  EXPECT_EQ(r["cmdline"], "sh -c");
+
+  // A reused pid has a different start time.
+  Row reused;
+  EXPECT_FALSE(cache.find("10", "900", "/bin/sh", reused));
+  EXPECT_TRUE(reused.empty());
+  EXPECT_FALSE(cache.find("11", "500", "/bin/sh", reused));
+
+  // The binary was deleted or replaced, which changes the exe link.
+  EXPECT_FALSE(cache.find("10", "500", "/bin/sh (deleted)", reused));
+  EXPECT_TRUE(reused.empty());
+
+  // The process executed a new binary.
+  cache.invalidate("10");
+  EXPECT_FALSE(cache.find("10", "500", "/bin/sh", reused));
+}
+
+TEST_F(ProcessCacheTests, test_reconcile) {
+  auto& cache = ProcessCache::get();
+  cache.update("10", "500", "/bin/sh", {{"cmdline", "sh"}});
+  cache.update("11", "600", "/bin/ls", {{"cmdline", "ls"}});
+  EXPECT_EQ(cache.size(), 2U);
+
+  // Process 11 exited.
+  cache.reconcile({"1", "10"});
+  EXPECT_EQ(cache.size(), 1U);
+
+  Row r;
+  EXPECT_TRUE(cache.find("10", "500", "/bin/sh", r));
+  EXPECT_FALSE(cache.find("11", "600", "/bin/ls", r));
+}
+
+TEST_F(ProcessCacheTests, test_ttl) {
+  auto& cache = ProcessCache::get();
+  cache.update("10", "500", "/bin/sh", {{"cmdline", "sh"}});
+
+  // Without a TTL the columns are always read again.
+  FLAGS_process_cache_ttl = 0;
+  Row r;
+  EXPECT_FALSE(cache.find("10", "500", "/bin/sh", r));
+
+  FLAGS_process_cache_ttl = 60;
+  EXPECT_TRUE(cache.find("10", "500", "/bin/sh", r));
+}
+} // namespace tables
+} // namespace osquery
@@ -10,12 +10,18 @@
 
 #include <augeas.h>
 
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <set>
 #include <sstream>
 #include <unordered_set>
+#include <vector>
 
 #include <boost/algorithm/string/join.hpp>
 
 #include <osquery/logger.h>
+#include <osquery/mutex.h>
 #include <osquery/tables.h>
 
 namespace osquery {
@@ -111,11 +117,64 @@ void matchAugeasPattern(augeas* aug,
   free(matches);
 }
 
+/// The number of components in an absolute path or glob.
+static size_t countComponents(const std::string& path) {
+  return std::count(path.begin(), path.end(), '/');
+}
+
+/// The leading components of an absolute path or glob.
+static std::string leadingComponents(const std::string& path, size_t count) {
+  size_t end = 0;
+  for (size_t i = 0; i < count && end != std::string::npos; i++) {
+    end = path.find('/', end + 1);
+  }
+  return path.substr(0, end);
+}
+
+/**
+ * @brief The filesystem path a node expression is limited to.
+ *
+ * Returns an empty path if the expression may match nodes of any file.
+ */
+static std::string getNodeScope(const std::string& node) {
+  if (node.compare(0, 7, "/files/") != 0) {
+    return "";
+  }
+
+  // Use the path components before the first expression character.
+  auto path = node.substr(6);
+  auto special = path.find_first_of("*[]()|$=\\'\" ");
+  if (special != std::string::npos) {
+    path = path.substr(0, path.rfind('/', special));
+  }
+  // An empty component is a descendant-or-self step.
+  auto descendant = path.find("//");
+  if (descendant != std::string::npos) {
+    path = path.substr(0, descendant);
+  }
+  while (path.size() > 1 && path.back() == '/') {
+    path.pop_back();
+  }
+  return (path.size() > 1) ? path : "";
+}
+
+/// A lens transform and the files it includes.
+struct AugeasTransform {
+  /// The transform node, such as /augeas/load/Hosts.
+  std::string node;
+
+  /// The configured include globs.
+  std::vector<std::string> incl;
+};
+
 class AugeasHandle {
  public:
   augeas* aug{nullptr};
   bool error{false};
 
+  /// Augeas handles are not thread safe, hold while loading and matching.
+  Mutex mutex;
+
   void initialize() {
     std::call_once(initialized, [this]() {
       this->aug = aug_init(
@@ -132,16 +191,129 @@ class AugeasHandle {
             << "An error has occurred while trying to initialize augeas: "
             << aug_error_message(this->aug);
         aug_close(this->aug);
+      } else {
+        readTransforms();
       }
     });
   }
 
+  /**
+   * @brief Load the files within the paths, or all files if there are none.
+   *
+   * Files loaded by previous queries stay loaded. Augeas only parses a file
+   * again if it was modified since it was loaded.
+   */
+  void load(const std::set<std::string>& paths) {
+    bool changed = false;
+    if (paths.empty()) {
+      changed = !loaded_all_;
+      loaded_all_ = true;
+    } else if (!loaded_all_) {
+      for (const auto& path : paths) {
+        if (!isLoaded(path)) {
+          loaded_.insert(path);
+          changed = true;
+        }
+      }
+    }
+
+    if (changed) {
+      for (const auto& transform : transforms_) {
+        setIncludes(transform);
+      }
+    }
+    aug_load(aug);
+  }
+
   ~AugeasHandle() {
     aug_close(aug);
   }
 
+ private:
+  /// Read the lens transforms, and include no files until a query loads.
+  void readTransforms() {
+    char** nodes = nullptr;
+    int len = aug_match(aug, "/augeas/load/*", &nodes);
+    for (int i = 0; i < len; i++) {
+      AugeasTransform transform;
+      transform.node = nodes[i];
+      free(nodes[i]);
+
+      char** incl = nullptr;
+      auto incl_path = transform.node + "/incl";
+      int incl_len = aug_match(aug, incl_path.c_str(), &incl);
+      for (int j = 0; j < incl_len; j++) {
+        const char* glob = nullptr;
+        if (aug_get(aug, incl[j], &glob) == 1 && glob != nullptr) {
+          transform.incl.push_back(glob);
+        }
+        free(incl[j]);
+      }
+      free(incl);
+
+      aug_rm(aug, incl_path.c_str());
+      transforms_.push_back(std::move(transform));
+    }
+    free(nodes);
+  }
+
+  /// Check if a path is within the loaded paths.
+  bool isLoaded(const std::string& path) const {
+    for (const auto& loaded : loaded_) {
+      if (path == loaded || (path.compare(0, loaded.size(), loaded) == 0 &&
+                             path[loaded.size()] == '/')) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Replace the transform's includes with the globs of the loaded paths.
+  void setIncludes(const AugeasTransform& transform) {
+    std::set<std::string> includes;
+    for (const auto& glob : transform.incl) {
+      if (loaded_all_) {
+        includes.insert(glob);
+        continue;
+      }
+
+      auto glob_components = countComponents(glob);
+      for (const auto& path : loaded_) {
+        auto path_components = countComponents(path);
+        if (path_components < glob_components) {
+          // The path is a directory that may contain matching files.
+          auto parent = leadingComponents(glob, path_components);
+          if (fnmatch(parent.c_str(), path.c_str(), FNM_PATHNAME) == 0) {
+            includes.insert(glob);
+          }
+        } else {
+          // Only include the requested file, the path may be a node within.
+          auto file = leadingComponents(path, glob_components);
+          if (fnmatch(glob.c_str(), file.c_str(), FNM_PATHNAME) == 0) {
+            includes.insert(file);
+          }
+        }
+      }
+    }
+
+    auto incl_path = transform.node + "/incl";
+    aug_rm(aug, incl_path.c_str());
+    incl_path += "[last()+1]";
+    for (const auto& glob : includes) {
+      aug_set(aug, incl_path.c_str(), glob.c_str());
+    }
+  }
+
  private:
   std::once_flag initialized;
+
+  std::vector<AugeasTransform> transforms_;
+
+  /// Paths included by previous queries.
+  std::set<std::string> loaded_;
+
+  /// All files were included by a previous query.
+  bool loaded_all_{false};
 };
 
 static AugeasHandle kAugeasHandle;
@@ -153,14 +325,18 @@ QueryData genAugeas(QueryContext& context) {
     return {};
   }
 
-  augeas* aug = kAugeasHandle.aug;
-  aug_load(aug);
-
-  QueryData results;
   std::unordered_set<std::string> patterns;
+  // Filesystem paths to load, unless a pattern may match any file.
+  std::set<std::string> scope;
+  bool unscoped = false;
 
   if (context.hasConstraint("node", EQUALS)) {
     auto nodes = context.constraints["node"].getAll(EQUALS);
+    for (const auto& node : nodes) {
+      auto path = getNodeScope(node);
+      unscoped = unscoped || path.empty();
+      scope.insert(path);
+    }
     patterns.insert(nodes.begin(), nodes.end());
   }
 
@@ -173,6 +349,10 @@ QueryData genAugeas(QueryContext& context) {
       pattern << "/files" << path;
       patterns.insert(pattern.str());
 
+      auto scoped = getNodeScope(pattern.str());
+      unscoped = unscoped || scoped.empty();
+      scope.insert(scoped);
+
       pattern.clear();
       pattern.str(std::string());
 
@@ -184,6 +364,15 @@ QueryData genAugeas(QueryContext& context) {
     }
   }
 
+  if (patterns.empty() || unscoped) {
+    scope.clear();
+  }
+
+  QueryData results;
+  WriteLock lock(kAugeasHandle.mutex);
+  kAugeasHandle.load(scope);
+
+  augeas* aug = kAugeasHandle.aug;
   if (patterns.empty()) {
     matchAugeasPattern(aug, "/files//*", results, context);
   } else {
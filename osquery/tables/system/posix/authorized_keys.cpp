@@ -18,6 +18,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
 #include "osquery/tables/system/system_utils.h"
 
 namespace osquery {
@@ -40,20 +41,24 @@ void genSSHkeysForUser(const std::string& uid,
     boost::filesystem::path keys_file = directory;
     keys_file /= kfile;
 
-    std::string keys_content;
-    if (!forensicReadFile(keys_file, keys_content).ok()) {
-      // Cannot read a specific keys file.
-      continue;
-    }
-    // Protocol 1 public key consist of: options, bits, exponent, modulus,
-    // comment; Protocol 2 public key consist of: options, keytype,
-    // base64-encoded key, comment.
-    for (const auto& line : split(keys_content, "\n")) {
-      if (!line.empty() && line[0] != '#') {
-        Row r = {{"uid", uid}, {"key", line}, {"key_file", keys_file.string()}};
-        results.push_back(r);
+    auto parser = ([&uid, &keys_file](const std::string& keys_content,
+                                      std::string& /* state */,
+                                      QueryData& rows) {
+      // Protocol 1 public key consist of: options, bits, exponent, modulus,
+      // comment; Protocol 2 public key consist of: options, keytype,
+      // base64-encoded key, comment.
+      for (const auto& line : split(keys_content, "\n")) {
+        if (!line.empty() && line[0] != '#') {
+          Row r = {
+              {"uid", uid}, {"key", line}, {"key_file", keys_file.string()}};
+          rows.push_back(r);
+        }
       }
-    }
+    });
+
+    // Keys files that cannot be read are skipped.
+    ParsedFileCache::get().read(
+        "authorized_keys:" + uid, keys_file, parser, results);
   }
 }
 
@@ -18,6 +18,7 @@
 #include <osquery/logger.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
 
 namespace osquery {
 namespace tables {
@@ -31,17 +32,8 @@ const std::vector<std::string> kCronSearchDirs = {
     "/var/spool/cron/crontabs/", // user linux:debian
 };
 
-std::vector<std::string> cronFromFile(const std::string& path) {
-  std::string content;
+std::vector<std::string> cronFromContent(const std::string& content) {
   std::vector<std::string> cron_lines;
-  if (!isReadable(path).ok()) {
-    return cron_lines;
-  }
-
-  if (!forensicReadFile(path, content).ok()) {
-    return cron_lines;
-  }
-
   auto lines = split(content, "\n");
 
   // Only populate the lines that are not comments or blank.
@@ -111,10 +103,20 @@ QueryData genCronTab(QueryContext& context) {
   }
 
   for (const auto& file_path : file_list) {
-    auto lines = cronFromFile(file_path);
-    for (const auto& line : lines) {
-      genCronLine(file_path, line, results);
+    if (!isReadable(file_path).ok()) {
+      continue;
     }
+
+    auto parser = ([&file_path](const std::string& content,
+                                std::string& /* state */,
+                                QueryData& rows) {
+      for (const auto& line : cronFromContent(content)) {
+        genCronLine(file_path, line, rows);
+      }
+    });
+
+    // Crontabs that cannot be read are skipped.
+    ParsedFileCache::get().read("crontab", file_path, parser, results);
   }
 
   return results;
@@ -0,0 +1,191 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include <osquery/filesystem.h>
+#include <osquery/flags.h>
+
+#include "osquery/tables/system/posix/file_cache.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+FLAG(uint64,
+     table_file_cache_size,
+     0,
+     "Bytes of parsed file rows tables may cache (default 0, disabled)");
+
+namespace tables {
+
+/// Bytes of parsed content kept to check that a file was only appended to.
+const size_t kFileCacheTailSize = 64;
+
+/// Approximate bytes for each cached row column beyond the string content.
+const size_t kFileCacheColumnOverhead = 64;
+
+static size_t estimateBytes(const QueryData& rows) {
+  size_t bytes = 0;
+  for (const auto& row : rows) {
+    for (const auto& column : row) {
+      bytes += column.first.size() + column.second.size() +
+               kFileCacheColumnOverhead;
+    }
+  }
+  return bytes;
+}
+
+static inline uint64_t toNanoseconds(const struct timespec& time) {
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(time.tv_nsec);
+}
+
+Status ParsedFileCache::read(const std::string& table,
+                             const fs::path& path,
+                             const FileParser& parser,
+                             QueryData& results,
+                             bool append) {
+  auto limit = static_cast<size_t>(FLAGS_table_file_cache_size);
+  if (limit == 0) {
+    std::string content;
+    auto s = forensicReadFile(path, content);
+    if (s.ok()) {
+      std::string state;
+      parser(content, state, results);
+    }
+    return s;
+  }
+
+  struct stat file_stat;
+  if (::stat(path.string().c_str(), &file_stat) != 0) {
+    return Status(1, "Cannot stat file: " + path.string());
+  }
+
+  FileIdentity identity;
+  identity.device = static_cast<uint64_t>(file_stat.st_dev);
+  identity.inode = static_cast<uint64_t>(file_stat.st_ino);
+  identity.size = static_cast<uint64_t>(file_stat.st_size);
+#if defined(__linux__)
+  identity.mtime = toNanoseconds(file_stat.st_mtim);
+  identity.ctime = toNanoseconds(file_stat.st_ctim);
+#else
+  identity.mtime = toNanoseconds(file_stat.st_mtimespec);
+  identity.ctime = toNanoseconds(file_stat.st_ctimespec);
+#endif
+
+  auto key = table + '\0' + path.string();
+  Entry previous;
+  bool resume = false;
+  {
+    WriteLock lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      if (it->second.identity == identity) {
+        // The file has not changed since it was parsed.
+        it->second.used = ++uses_;
+        results.insert(
+            results.end(), it->second.rows.begin(), it->second.rows.end());
+        return Status(0, "OK");
+      }
+
+      resume = append && it->second.offset > 0 &&
+               it->second.identity.device == identity.device &&
+               it->second.identity.inode == identity.inode &&
+               it->second.offset < identity.size;
+      if (resume) {
+        previous = it->second;
+      }
+    }
+  }
+
+  std::string content;
+  auto s = forensicReadFile(path, content);
+  if (!s.ok()) {
+    WriteLock lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      bytes_ -= it->second.bytes;
+      entries_.erase(it);
+    }
+    return s;
+  }
+
+  // Resume only if the previously parsed content is unchanged.
+  if (resume) {
+    const auto& tail = previous.tail;
+    auto start = previous.offset - tail.size();
+    resume = content.size() > previous.offset &&
+             content.compare(start, tail.size(), tail) == 0;
+  }
+
+  Entry entry;
+  entry.identity = identity;
+  if (resume) {
+    entry.rows = std::move(previous.rows);
+    entry.state = std::move(previous.state);
+    parser(content.substr(previous.offset), entry.state, entry.rows);
+  } else {
+    parser(content, entry.state, entry.rows);
+  }
+  results.insert(results.end(), entry.rows.begin(), entry.rows.end());
+
+  // Only content ending on a line boundary can be resumed.
+  if (!content.empty() && content.back() == '\n') {
+    entry.offset = content.size();
+    auto tail_size = std::min(content.size(), kFileCacheTailSize);
+    entry.tail = content.substr(content.size() - tail_size);
+  }
+  entry.bytes = estimateBytes(entry.rows) + entry.tail.size() +
+                entry.state.size() + key.size();
+
+  WriteLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+  }
+
+  if (entry.bytes <= limit) {
+    evict(limit - entry.bytes);
+    entry.used = ++uses_;
+    bytes_ += entry.bytes;
+    entries_[key] = std::move(entry);
+  }
+  return Status(0, "OK");
+}
+
+void ParsedFileCache::evict(size_t limit) {
+  while (bytes_ > limit && !entries_.empty()) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.used < oldest->second.used) {
+        oldest = it;
+      }
+    }
+    bytes_ -= oldest->second.bytes;
+    entries_.erase(oldest);
+  }
+}
+
+void ParsedFileCache::clear() {
+  WriteLock lock(mutex_);
+  entries_.clear();
+  bytes_ = 0;
+}
+
+size_t ParsedFileCache::bytes() const {
+  ReadLock lock(mutex_);
+  return bytes_;
+}
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,129 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Parse file content into rows.
+ *
+ * The state is carried between calls when appended content is parsed, for
+ * example a timestamp line seen at the end of the previous content.
+ */
+using FileParser = std::function<void(
+    const std::string& content, std::string& state, QueryData& rows)>;
+
+/**
+ * @brief A cache of rows parsed from files, for config-file-backed tables.
+ *
+ * Rows are reused while a file's device, inode, size, and modify and change
+ * times stay the same. Files read as append-only resume parsing from the end
+ * of the previously parsed content when they grow.
+ *
+ * The cache is limited to `table_file_cache_size` bytes of rows, the least
+ * recently used files are evicted first. A size of 0 disables caching and
+ * each read parses the complete file.
+ */
+class ParsedFileCache : private boost::noncopyable {
+ public:
+  static ParsedFileCache& get() {
+    static ParsedFileCache instance;
+    return instance;
+  }
+
+  /**
+   * @brief Append the rows parsed from a file to results.
+   *
+   * The file is read using forensicReadFile, with the caller's privileges.
+   *
+   * @param table a namespace for rows, the table name and any row constants.
+   * @param path the file to read.
+   * @param parser called with new (or all) file content.
+   * @param results output rows.
+   * @param append the file is only appended to, such as a history file.
+   * @return failure if the file cannot be read.
+   */
+  Status read(const std::string& table,
+              const boost::filesystem::path& path,
+              const FileParser& parser,
+              QueryData& results,
+              bool append = false);
+
+  /// Remove all cached rows.
+  void clear();
+
+  /// The estimated bytes of cached rows.
+  size_t bytes() const;
+
+ private:
+  ParsedFileCache() = default;
+
+  struct FileIdentity {
+    uint64_t device{0};
+    uint64_t inode{0};
+    uint64_t size{0};
+    uint64_t mtime{0};
+    uint64_t ctime{0};
+
+    bool operator==(const FileIdentity& other) const {
+      return device == other.device && inode == other.inode &&
+             size == other.size && mtime == other.mtime &&
+             ctime == other.ctime;
+    }
+  };
+
+  struct Entry {
+    FileIdentity identity;
+
+    /// Parsed rows, and their estimated size.
+    QueryData rows;
+    size_t bytes{0};
+
+    /// The parser state after the parsed content.
+    std::string state;
+
+    /// End of the parsed content, only set if resuming is possible.
+    size_t offset{0};
+
+    /// The content immediately before the offset, to detect rewrites.
+    std::string tail;
+
+    /// Access order for eviction.
+    size_t used{0};
+  };
+
+  /// Evict the least recently used entries until within the limit.
+  void evict(size_t limit);
+
+ private:
+  std::map<std::string, Entry> entries_;
+
+  /// Estimated bytes of all cached rows.
+  size_t bytes_{0};
+
+  /// An increasing access count.
+  size_t uses_{0};
+
+  mutable Mutex mutex_;
+};
+} // namespace tables
+} // namespace osquery
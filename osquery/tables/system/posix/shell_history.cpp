@@ -20,6 +20,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
 #include "osquery/tables/system/posix/shell_history.h"
 #include "osquery/tables/system/system_utils.h"
 
@@ -35,14 +36,16 @@ const std::vector<std::string> kShellHistoryFiles = {
 void genShellHistoryFromFile(const std::string& uid,
                              const boost::filesystem::path& history_file,
                              QueryData& results) {
-  std::string history_content;
-  if (forensicReadFile(history_file, history_content).ok()) {
-    auto bash_timestamp_rx = xp::sregex::compile("^#(?P<timestamp>[0-9]+)$");
-    auto zsh_timestamp_rx = xp::sregex::compile(
+  // History files are appended to, only new lines are parsed when cached.
+  auto parser = ([&uid, &history_file](const std::string& content,
+                                        std::string& prev_bash_timestamp,
+                                        QueryData& rows) {
+    static const auto bash_timestamp_rx =
+        xp::sregex::compile("^#(?P<timestamp>[0-9]+)$");
+    static const auto zsh_timestamp_rx = xp::sregex::compile(
         "^: {0,10}(?P<timestamp>[0-9]{1,11}):[0-9]+;(?P<command>.*)$");
 
-    std::string prev_bash_timestamp;
-    for (const auto& line : split(history_content, "\n")) {
+    for (const auto& line : split(content, "\n")) {
       xp::smatch bash_timestamp_matches;
       xp::smatch zsh_timestamp_matches;
 
@@ -70,9 +73,12 @@ void genShellHistoryFromFile(const std::string& uid,
 
       r["uid"] = uid;
       r["history_file"] = history_file.string();
-      results.push_back(r);
+      rows.push_back(r);
     }
-  }
+  });
+
+  ParsedFileCache::get().read(
+      "shell_history:" + uid, history_file, parser, results, true);
 }
 
 void genShellHistoryForUser(const std::string& uid,
@@ -21,6 +21,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
 #include "osquery/tables/system/system_utils.h"
 
 namespace fs = boost::filesystem;
@@ -35,33 +36,38 @@ void genSshConfig(const std::string& uid,
                   const std::string& gid,
                   const fs::path& filepath,
                   QueryData& results) {
-  std::string ssh_config_content;
-  if (!forensicReadFile(filepath, ssh_config_content).ok()) {
-    VLOG(1) << "Cannot read ssh_config file " << filepath;
-    return;
-  }
-  // the ssh_config file consists of a number of host or match
-  // blocks containing newline-separated options for each
-  // block; a block is defined as everything following a
-  // host or match keyword, until the next host or match
-  // keyword, else EOF
-  std::string block;
-  for (auto& line : split(ssh_config_content, "\n")) {
-    boost::trim(line);
-    boost::to_lower(line);
-    if (line.empty() || line[0] == '#') {
-      continue;
-    }
-    if (boost::starts_with(line, "host ") ||
-        boost::starts_with(line, "match ")) {
-      block = line;
-    } else {
-      Row r = {{"uid", uid},
-               {"block", block},
-               {"option", line},
-               {"ssh_config_file", filepath.string()}};
-      results.push_back(r);
+  auto parser = ([&uid, &filepath](const std::string& ssh_config_content,
+                                    std::string& /* state */,
+                                    QueryData& rows) {
+    // the ssh_config file consists of a number of host or match
+    // blocks containing newline-separated options for each
+    // block; a block is defined as everything following a
+    // host or match keyword, until the next host or match
+    // keyword, else EOF
+    std::string block;
+    for (auto& line : split(ssh_config_content, "\n")) {
+      boost::trim(line);
+      boost::to_lower(line);
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      if (boost::starts_with(line, "host ") ||
+          boost::starts_with(line, "match ")) {
+        block = line;
+      } else {
+        Row r = {{"uid", uid},
+                 {"block", block},
+                 {"option", line},
+                 {"ssh_config_file", filepath.string()}};
+        rows.push_back(r);
+      }
     }
+  });
+
+  if (!ParsedFileCache::get()
+           .read("ssh_configs:" + uid, filepath, parser, results)
+           .ok()) {
+    VLOG(1) << "Cannot read ssh_config file " << filepath;
   }
 }
 void genSshConfigForUser(const std::string& uid,
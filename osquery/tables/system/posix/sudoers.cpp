@@ -17,6 +17,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
 
 namespace osquery {
 namespace tables {
@@ -34,34 +35,34 @@ QueryData genSudoers(QueryContext& context) {
     return results;
   }
 
-  std::string contents;
-  if (!forensicReadFile(kSudoFile, contents).ok()) {
-    return results;
-  }
-
-  auto lines = split(contents, "\n");
-  std::vector<std::string> valid_lines;
+  auto parser = ([](const std::string& contents,
+                     std::string& /* state */,
+                     QueryData& rows) {
+    auto lines = split(contents, "\n");
+    std::vector<std::string> valid_lines;
 
-  for (auto& line : lines) {
-    boost::trim(line);
+    for (auto& line : lines) {
+      boost::trim(line);
 
-    // Only add lines that are not comments or blank.
-    if (line.size() > 0 && line.at(0) != '#') {
-      valid_lines.push_back(line);
+      // Only add lines that are not comments or blank.
+      if (line.size() > 0 && line.at(0) != '#') {
+        valid_lines.push_back(line);
+      }
     }
-  }
 
-  for (const auto& line : valid_lines) {
-    Row r;
-    auto cols = split(line);
-    r["header"] = cols.at(0);
+    for (const auto& line : valid_lines) {
+      Row r;
+      auto cols = split(line);
+      r["header"] = cols.at(0);
 
-    cols.erase(cols.begin());
-    r["rule_details"] = join(cols, " ");
+      cols.erase(cols.begin());
+      r["rule_details"] = join(cols, " ");
 
-    results.push_back(r);
-  }
+      rows.push_back(r);
+    }
+  });
 
+  ParsedFileCache::get().read("sudoers", kSudoFile, parser, results);
   return results;
 }
 }
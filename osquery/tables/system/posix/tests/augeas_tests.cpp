@@ -71,5 +71,20 @@ TEST_F(AugeasTests, select_hosts_by_node) {
       << "Value is not empty. Got " << results.rows()[0].at("value")
       << "instead";
 }
+
+TEST_F(AugeasTests, select_node_within_file_after_other_path) {
+  // Each query loads the files it needs in addition to the loaded files.
+  auto resolv = SQL("select * from augeas where path = '/etc/resolv.conf'");
+  ASSERT_GE(resolv.rows().size(), 1U);
+
+  auto results =
+      SQL("select * from augeas where node = '/files/etc/hosts/1/ipaddr'");
+  ASSERT_EQ(results.rows().size(), 1U);
+  EXPECT_EQ(results.rows()[0].at("path"), "/etc/hosts");
+  EXPECT_EQ(results.rows()[0].at("label"), "ipaddr");
+
+  resolv = SQL("select * from augeas where path = '/etc/resolv.conf'");
+  EXPECT_GE(resolv.rows().size(), 1U);
+}
 } // namespace tables
 } // namespace osquery
@@ -0,0 +1,140 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/flags.h>
+
+#include "osquery/core/conversions.h"
+#include "osquery/tables/system/posix/file_cache.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_uint64(table_file_cache_size);
+
+namespace tables {
+
+class FileCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = fs::temp_directory_path() /
+                 fs::unique_path("osquery.file_cache_tests.%%%%-%%%%");
+    ASSERT_TRUE(fs::create_directory(directory_));
+    path_ = directory_ / "lines";
+
+    cache_size_ = FLAGS_table_file_cache_size;
+    FLAGS_table_file_cache_size = 1024 * 1024;
+    ParsedFileCache::get().clear();
+
+    parser_ = ([this](const std::string& content,
+                      std::string& state,
+                      QueryData& rows) {
+      parsed_.push_back(content);
+      for (const auto& line : split(content, "\n")) {
+        rows.push_back({{"line", line}, {"previous", state}});
+        state = line;
+      }
+    });
+  }
+
+  void TearDown() override {
+    ParsedFileCache::get().clear();
+    FLAGS_table_file_cache_size = cache_size_;
+    fs::remove_all(directory_);
+  }
+
+  void write(const std::string& content, bool append = false) {
+    auto mode = std::ios::out | std::ios::binary;
+    std::ofstream fout(path_.native(), append ? mode | std::ios::app : mode);
+    fout << content;
+  }
+
+  QueryData read(bool append = false) {
+    QueryData results;
+    EXPECT_TRUE(
+        ParsedFileCache::get().read("test", path_, parser_, results, append)
+            .ok());
+    return results;
+  }
+
+ protected:
+  fs::path directory_;
+  fs::path path_;
+  FileParser parser_;
+  std::vector<std::string> parsed_;
+  size_t cache_size_{0};
+};
+
+TEST_F(FileCacheTests, test_unchanged_file) {
+  write("first\nsecond\n");
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(parsed_.size(), 1U);
+  EXPECT_GT(ParsedFileCache::get().bytes(), 0U);
+
+  // A changed file is parsed again.
+  write("first\nsecond\nthird\n");
+  EXPECT_EQ(read().size(), 3U);
+  EXPECT_EQ(parsed_.size(), 2U);
+  EXPECT_EQ(parsed_.back(), "first\nsecond\nthird\n");
+
+  QueryData results;
+  auto status = ParsedFileCache::get().read(
+      "test", directory_ / "missing", parser_, results);
+  EXPECT_FALSE(status.ok());
+  EXPECT_TRUE(results.empty());
+}
+
+TEST_F(FileCacheTests, test_appended_file) {
+  write("first\nsecond\n");
+  EXPECT_EQ(read(true).size(), 2U);
+
+  // Only the appended content is parsed, with the previous state.
+  write("third\n", true);
+  auto results = read(true);
+  ASSERT_EQ(results.size(), 3U);
+  EXPECT_EQ(parsed_.back(), "third\n");
+  EXPECT_EQ(results[2]["line"], "third");
+  EXPECT_EQ(results[2]["previous"], "second");
+
+  // A rewritten file is parsed from the start.
+  write("other\nlines\nhere\nnow\n");
+  results = read(true);
+  ASSERT_EQ(results.size(), 4U);
+  EXPECT_EQ(parsed_.back(), "other\nlines\nhere\nnow\n");
+  EXPECT_EQ(results[0]["previous"], "");
+}
+
+TEST_F(FileCacheTests, test_disabled_cache) {
+  FLAGS_table_file_cache_size = 0;
+  write("first\nsecond\n");
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(parsed_.size(), 2U);
+  EXPECT_EQ(ParsedFileCache::get().bytes(), 0U);
+}
+
+TEST_F(FileCacheTests, test_cache_limit) {
+  // Rows larger than the cache limit are not cached.
+  FLAGS_table_file_cache_size = 16;
+  write("first\nsecond\n");
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(read().size(), 2U);
+  EXPECT_EQ(parsed_.size(), 2U);
+  EXPECT_EQ(ParsedFileCache::get().bytes(), 0U);
+}
+} // namespace tables
+} // namespace osquery
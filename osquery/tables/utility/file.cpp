@@ -16,6 +16,7 @@
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
+#include "osquery/core/query_budget.h"
 #include "osquery/filesystem/fileops.h"
 
 namespace fs = boost::filesystem;
@@ -156,6 +157,9 @@ QueryData genFile(QueryContext& context) {
 
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
+    if (queryBudgetExceeded()) {
+      return results;
+    }
     fs::path path = path_string;
     genFileInfo(path, path.parent_path(), "", results);
   }
@@ -188,6 +192,9 @@ QueryData genFile(QueryContext& context) {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
+        if (queryBudgetExceeded()) {
+          return results;
+        }
         genFileInfo(begin->path(), directory_string, "", results);
       }
     } catch (const fs::filesystem_error& /* e */) {
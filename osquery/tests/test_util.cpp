@@ -459,22 +459,22 @@ QueryData getEtcProtocolsExpectedResults() {
 QueryData genRows(EventSubscriberPlugin* sub) {
   auto vtc = new VirtualTableContent();
   QueryContext context(vtc);
+  auto results = genRows(sub, context);
+  delete vtc;
+  return results;
+}
+
+QueryData genRows(EventSubscriberPlugin* sub, QueryContext& context) {
   RowGenerator::pull_type generator(std::bind(&EventSubscriberPlugin::genTable,
                                               sub,
                                               std::placeholders::_1,
                                               std::move(context)));
 
   QueryData results;
-  if (!generator) {
-    delete vtc;
-    return results;
-  }
-
   while (generator) {
     results.push_back(generator.get());
     generator();
   }
-  delete vtc;
   return results;
 }
 
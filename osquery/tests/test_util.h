@@ -158,6 +158,9 @@ std::vector<SplitStringTestData> generateSplitStringTestData();
 // Helper function to generate all rows from a generator-based table.
 QueryData genRows(EventSubscriberPlugin* sub);
 
+// Generate rows using the query context, the context is moved into the table.
+QueryData genRows(EventSubscriberPlugin* sub, QueryContext& context);
+
 // generate a small directory structure for testing
 void createMockFileStructure();
 
@@ -75,13 +75,6 @@ COLUMN_OPTIONS = {
     "hidden": "HIDDEN",
 }
 
-# Column options that render tables uncacheable.
-NON_CACHEABLE = [
-    "REQUIRED",
-    "ADDITIONAL",
-    "OPTIMIZED",
-]
-
 TABLE_ATTRIBUTES = {
     "event_subscriber": "EVENT_BASED",
     "user_data": "USER_BASED",
@@ -206,6 +199,7 @@ class TableState(Singleton):
         self.has_options = False
         self.has_column_aliases = False
         self.generator = False
+        self.changes = ""
 
     def columns(self):
         return [i for i in self.schema if isinstance(i, Column)]
@@ -242,6 +236,15 @@ class TableState(Singleton):
                 print(lightred(
                     "Table cannot use a generator and be marked cacheable: %s" % (path)))
                 exit(1)
+        if "cache_ttl" in self.attributes:
+            if "cacheable" not in self.attributes:
+                print(lightred(
+                    "Table must be marked cacheable to use a cache_ttl: %s" % (path)))
+                exit(1)
+        if self.changes != "" and self.class_name != "":
+            print(lightred(
+                "Event subscriber tables cannot provide changes: %s" % (path)))
+            exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
@@ -287,6 +290,7 @@ class TableState(Singleton):
             has_options=self.has_options,
             has_column_aliases=self.has_column_aliases,
             generator=self.generator,
+            changes=self.changes,
             attribute_set=[TABLE_ATTRIBUTES[attr] for attr in self.attributes if attr in TABLE_ATTRIBUTES],
         )
 
@@ -393,7 +397,7 @@ def fuzz_paths(paths):
     table.fuzz_paths = paths
 
 
-def implementation(impl_string, generator=False):
+def implementation(impl_string, generator=False, changes=None):
     """
     define the path to the implementation file and the function which
     implements the virtual table. You should use the following format:
@@ -401,6 +405,11 @@ def implementation(impl_string, generator=False):
       # the path is "osquery/table/implementations/foo.cpp"
       # the function is "QueryData genFoo();"
       implementation("foo@genFoo")
+
+    A table may also name a function returning the rows changed since a
+    cursor, see TablePlugin::changes:
+
+      implementation("foo@genFoo", changes="genFooChanges")
     """
     logging.debug("- implementation")
     filename, function = impl_string.split("@")
@@ -415,6 +424,7 @@ def implementation(impl_string, generator=False):
     table.function = function
     table.class_name = class_name
     table.generator = generator
+    table.changes = changes if changes is not None else ""
 
     '''Check if the table has a subscriber attribute, if so, enforce time.'''
     if "event_subscriber" in table.attributes: